@@ -0,0 +1,736 @@
+/* FDCLabel_bench.c Fast Dynamic C Label Generator
+ *
+ * Copyright (C) Ivan Rolero
+ *
+ * This file is part of FDCLabel.
+ *
+ * FDCLabel is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FDCLabel is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Benchmarks: writes a synthetic CSV and one template per workload, times
+// the hot functions one by one, then renders every template end to end.
+// Results can be saved and compared with an earlier run, so a slowdown
+// shows up before a build reaches production.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#ifdef _WIN32
+#define PSAPI_VERSION 2
+#include <windows.h>
+#include <psapi.h>
+#include <direct.h>
+#include <io.h>
+#else
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+#include "cJSON.h"
+#include "hpdf.h"
+#include "barcodes.h"
+#include "utils.h"
+
+#define MAX_RESULTS         64
+#define MAX_BENCH_PATH      1024
+
+typedef struct {
+    int rows;
+    int columns;
+    int field_length;
+    int quoted_percent;
+    int utf8_percent;
+    int iterations;
+    int threads;
+    unsigned int seed;
+    const char *font_file;
+    const char *out_dir;
+    const char *save_file;
+    const char *compare_file;
+    double tolerance;
+    int generate_only;
+} BenchConfig;
+
+typedef struct {
+    char name[64];
+    double value;
+    const char *unit;
+    int higher_is_better;
+} BenchResult;
+
+static BenchResult results[MAX_RESULTS];
+static int result_count = 0;
+
+static void add_result(const char *name, double value, const char *unit, int higher_is_better) {
+    if (result_count >= MAX_RESULTS) return;
+    BenchResult *r = &results[result_count++];
+    safe_strncpy(r->name, name, sizeof(r->name));
+    r->value = value;
+    r->unit = unit;
+    r->higher_is_better = higher_is_better;
+}
+
+/* ---------- Platform ---------- */
+
+static double now_ms(void) {
+#ifdef _WIN32
+    LARGE_INTEGER freq, counter;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&counter);
+    return (double)counter.QuadPart * 1000.0 / (double)freq.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1000.0 + (double)ts.tv_nsec / 1000000.0;
+#endif
+}
+
+// Peak resident set of the process so far, in KB
+static double peak_rss_kb(void) {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return 0;
+    return (double)counters.PeakWorkingSetSize / 1024.0;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#ifdef __APPLE__
+    return (double)usage.ru_maxrss / 1024.0;
+#else
+    return (double)usage.ru_maxrss;
+#endif
+#endif
+}
+
+static void make_dir(const char *path) {
+#ifdef _WIN32
+    _mkdir(path);
+#else
+    mkdir(path, 0755);
+#endif
+}
+
+static long file_size(const char *path) {
+    FILE *f = fopen(path, "rb");
+    if (!f) return -1;
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fclose(f);
+    return size;
+}
+
+static void bench_path(char *dest, const BenchConfig *cfg, const char *name) {
+    snprintf(dest, MAX_BENCH_PATH, "%s/%s", cfg->out_dir, name);
+}
+
+/* ---------- Synthetic Data ---------- */
+
+// Own generator so the same seed gives the same data on every platform
+static unsigned int rng_state = 1;
+
+static unsigned int next_random(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+static int random_below(int n) {
+    return n > 0 ? (int)(next_random() % (unsigned int)n) : 0;
+}
+
+static const char *utf8_words[] = {
+    "Gr\xC3\xBC\xC3\x9F" "e", "caf\xC3\xA9", "na\xC3\xAFve", "\xC3\x98rsted",
+    "Stra\xC3\x9F" "e", "se\xC3\xB1or", "\xE2\x82\xAC" "uro", "K\xC3\xB8" "benhavn"
+};
+
+// One free text value of about `length` bytes: words of 2-10 letters, with
+// UTF-8 words mixed in, quoted (with commas and "" escapes) when asked
+static void write_text_value(FILE *f, const BenchConfig *cfg) {
+    int quoted = random_below(100) < cfg->quoted_percent;
+    int utf8 = random_below(100) < cfg->utf8_percent;
+    int target = cfg->field_length / 2 + random_below(cfg->field_length + 1);
+    int written = 0;
+
+    if (quoted) fputc('"', f);
+    while (written < target) {
+        if (written > 0) {
+            if (quoted && random_below(8) == 0) {
+                fputs(", ", f);
+                written += 2;
+            } else {
+                fputc(' ', f);
+                written++;
+            }
+        }
+        if (utf8 && random_below(4) == 0) {
+            const char *word = utf8_words[random_below((int)(sizeof(utf8_words) / sizeof(utf8_words[0])))];
+            fputs(word, f);
+            written += (int)strlen(word);
+        } else if (quoted && random_below(10) == 0) {
+            fputs("\"\"quoted\"\"", f);
+            written += 10;
+        } else {
+            int len = 2 + random_below(9);
+            for (int i = 0; i < len; i++) fputc('a' + random_below(26), f);
+            written += len;
+        }
+    }
+    if (quoted) fputc('"', f);
+}
+
+// EAN-13 with a valid check digit
+static void write_ean13(FILE *f) {
+    char digits[14];
+    int sum = 0;
+    for (int i = 0; i < 12; i++) {
+        int d = random_below(10);
+        digits[i] = (char)('0' + d);
+        sum += (i % 2) ? d * 3 : d;
+    }
+    digits[12] = (char)('0' + (10 - sum % 10) % 10);
+    digits[13] = '\0';
+    fputs(digits, f);
+}
+
+// Columns: sku (Code128), ean (EAN-13), then free text c2, c3, ...
+static int generate_csv(const BenchConfig *cfg, const char *path) {
+    FILE *f = fopen(path, "wb");
+    if (!f) {
+        fprintf(stderr, "Cannot write CSV file: %s\n", path);
+        return -1;
+    }
+
+    fputs("sku,ean", f);
+    for (int c = 2; c < cfg->columns; c++) fprintf(f, ",c%d", c);
+    fputc('\n', f);
+
+    for (int r = 0; r < cfg->rows; r++) {
+        fprintf(f, "SKU-%06d-%c%c,", r, 'A' + random_below(26), 'A' + random_below(26));
+        write_ean13(f);
+        for (int c = 2; c < cfg->columns; c++) {
+            fputc(',', f);
+            write_text_value(f, cfg);
+        }
+        fputc('\n', f);
+    }
+
+    if (fclose(f) != 0) {
+        fprintf(stderr, "Error writing CSV file: %s\n", path);
+        return -1;
+    }
+    return 0;
+}
+
+/* ---------- Synthetic Templates ---------- */
+
+static cJSON* template_base(const char *ttf_name, const char *ttf_file) {
+    cJSON *root = cJSON_CreateObject();
+    cJSON *page = cJSON_AddObjectToObject(root, "page");
+    cJSON_AddStringToObject(page, "size", "A5");
+    cJSON_AddStringToObject(page, "orientation", "portrait");
+    cJSON_AddNumberToObject(page, "line_width", 1.0);
+
+    cJSON *fonts = cJSON_AddObjectToObject(root, "fonts");
+    cJSON_AddStringToObject(fonts, "default", "Helvetica-Bold");
+    if (ttf_name) {
+        cJSON *custom = cJSON_AddArrayToObject(fonts, "custom_fonts");
+        cJSON *font = cJSON_CreateObject();
+        cJSON_AddStringToObject(font, "name", ttf_name);
+        cJSON_AddStringToObject(font, "file", ttf_file);
+        cJSON_AddItemToArray(custom, font);
+    }
+
+    cJSON_AddArrayToObject(root, "fields");
+    cJSON *lines = cJSON_AddArrayToObject(root, "lines");
+    for (int i = 0; i < 3; i++) {
+        cJSON *line = cJSON_CreateObject();
+        cJSON_AddStringToObject(line, "type", "horizontal_transform");
+        cJSON_AddNumberToObject(line, "x_start", 10);
+        cJSON_AddNumberToObject(line, "x_end", 410);
+        cJSON_AddNumberToObject(line, "y", 150 + i * 150);
+        cJSON_AddNumberToObject(line, "width", 1.0);
+        cJSON_AddItemToArray(lines, line);
+    }
+    return root;
+}
+
+static void add_field(cJSON *root, float x_start, float x_end, float y_start, float y_end,
+                      const char *text, float font_size, int wrap, const char *align,
+                      const char *font_name) {
+    cJSON *field = cJSON_CreateObject();
+    cJSON_AddNumberToObject(field, "x_start", x_start);
+    cJSON_AddNumberToObject(field, "x_end", x_end);
+    cJSON_AddNumberToObject(field, "y_start", y_start);
+    cJSON_AddNumberToObject(field, "y_end", y_end);
+    cJSON_AddStringToObject(field, "text", text);
+    cJSON_AddNumberToObject(field, "font_size", font_size);
+    cJSON_AddNumberToObject(field, "wrap", wrap);
+    cJSON_AddStringToObject(field, "align", align);
+    if (font_name) cJSON_AddStringToObject(field, "font_name", font_name);
+    cJSON_AddItemToArray(cJSON_GetObjectItem(root, "fields"), field);
+}
+
+// Eight wrapped boxes over the free text columns
+static void add_wrap_fields(cJSON *root, const BenchConfig *cfg, const char *font_name) {
+    static const char *aligns[] = { "left", "center", "right" };
+    char text[32];
+
+    for (int i = 0; i < 8; i++) {
+        int column = 2 + i % (cfg->columns - 2);
+        snprintf(text, sizeof(text), "$c%d", column);
+        float x = (i % 2) ? 215.0f : 15.0f;
+        float y = 20.0f + (float)(i / 2) * 140.0f;
+        add_field(root, x, x + 190.0f, y, y + 120.0f, text, 10.0f + (float)(i % 3) * 4.0f,
+                  1, aligns[i % 3], font_name);
+    }
+    add_field(root, 15, 405, 570, 590, "$sku", 14, 0, "left", font_name);
+}
+
+static int write_template(const char *path, cJSON *root) {
+    char *json = cJSON_Print(root);
+    cJSON_Delete(root);
+    if (!json) return -1;
+
+    FILE *f = fopen(path, "wb");
+    if (!f) {
+        fprintf(stderr, "Cannot write template file: %s\n", path);
+        cJSON_free(json);
+        return -1;
+    }
+    fputs(json, f);
+    cJSON_free(json);
+    return fclose(f) == 0 ? 0 : -1;
+}
+
+// Name Libharu gives the font in the file, which templates refer to
+static int ttf_font_name(const char *file, char *name, size_t name_size) {
+    HPDF_Doc pdf = HPDF_New(error_handler, NULL);
+    if (!pdf) return -1;
+    const char *loaded = HPDF_LoadTTFontFromFile(pdf, file, HPDF_TRUE);
+    if (loaded) safe_strncpy(name, loaded, name_size);
+    HPDF_Free(pdf);
+    return loaded ? 0 : -1;
+}
+
+static const char *workloads[] = { "wrap", "barcode", "qr", "ttf" };
+#define WORKLOAD_COUNT ((int)(sizeof(workloads) / sizeof(workloads[0])))
+
+// One template per workload; the TTF one only with --font
+static int generate_templates(const BenchConfig *cfg) {
+    char path[MAX_BENCH_PATH];
+
+    cJSON *root = template_base(NULL, NULL);
+    add_wrap_fields(root, cfg, NULL);
+    bench_path(path, cfg, "wrap.json");
+    if (write_template(path, root) != 0) return -1;
+
+    // Barcode heavy: three Code128 and three EAN-13 symbols per label
+    root = template_base(NULL, NULL);
+    add_field(root, 15, 405, 570, 590, "$sku", 14, 0, "left", NULL);
+    cJSON *barcodes = cJSON_AddArrayToObject(root, "barcodes");
+    for (int i = 0; i < 6; i++) {
+        cJSON *bc = cJSON_CreateObject();
+        cJSON_AddNumberToObject(bc, "x", (i % 2) ? 215 : 15);
+        cJSON_AddNumberToObject(bc, "y", 30 + (i / 2) * 180);
+        cJSON_AddNumberToObject(bc, "width", 190);
+        cJSON_AddNumberToObject(bc, "height", 100);
+        cJSON_AddStringToObject(bc, "type", i < 3 ? "code128" : "ean13");
+        cJSON_AddStringToObject(bc, "text", i < 3 ? "$sku" : "$ean");
+        cJSON_AddItemToArray(barcodes, bc);
+    }
+    bench_path(path, cfg, "barcode.json");
+    if (write_template(path, root) != 0) return -1;
+
+    // QR heavy: a large code of the longest text column on every label
+    root = template_base(NULL, NULL);
+    add_field(root, 15, 405, 570, 590, "$sku", 14, 0, "left", NULL);
+    cJSON *qr = cJSON_AddObjectToObject(root, "qr_code");
+    cJSON_AddNumberToObject(qr, "x", 60);
+    cJSON_AddNumberToObject(qr, "y", 150);
+    cJSON_AddNumberToObject(qr, "size", 300);
+    cJSON_AddStringToObject(qr, "text", "$c2");
+    cJSON_AddBoolToObject(qr, "enabled", 1);
+    bench_path(path, cfg, "qr.json");
+    if (write_template(path, root) != 0) return -1;
+
+    // A template left over from an earlier run must not be benchmarked
+    bench_path(path, cfg, "ttf.json");
+    remove(path);
+
+    if (cfg->font_file) {
+        char name[128];
+        if (ttf_font_name(cfg->font_file, name, sizeof(name)) != 0) {
+            fprintf(stderr, "Warning: Could not load font file: %s, skipping ttf workload\n", cfg->font_file);
+            return 0;
+        }
+        root = template_base(name, cfg->font_file);
+        add_wrap_fields(root, cfg, name);
+        bench_path(path, cfg, "ttf.json");
+        if (write_template(path, root) != 0) return -1;
+    }
+    return 0;
+}
+
+/* ---------- Micro Benchmarks ---------- */
+
+static void bench_parse_csv(const BenchConfig *cfg, const char *csv_path) {
+    int runs = cfg->iterations / 100 > 0 ? cfg->iterations / 100 : 1;
+    long size = file_size(csv_path);
+
+    double start = now_ms();
+    for (int i = 0; i < runs; i++) {
+        CSVData *csv = parse_csv(csv_path, NULL, 0, NULL);
+        if (!csv) return;
+        free_csv_data(csv);
+    }
+    double ms = (now_ms() - start) / runs;
+
+    add_result("parse_csv", ms, "ms", 0);
+    if (ms > 0) add_result("parse_csv_throughput", (double)size / 1048576.0 / (ms / 1000.0), "MB/s", 1);
+}
+
+// New page every 100 draws, so content streams stay label sized
+static HPDF_Page bench_page(HPDF_Doc pdf, HPDF_Page page, int i) {
+    if (page && i % 100 != 0) return page;
+    page = HPDF_AddPage(pdf);
+    HPDF_Page_SetSize(page, HPDF_PAGE_SIZE_A5, HPDF_PAGE_PORTRAIT);
+    return page;
+}
+
+static void bench_drawing(const BenchConfig *cfg, const CSVData *csv) {
+    HPDF_Doc pdf = HPDF_New(error_handler, NULL);
+    if (!pdf) return;
+    HPDF_UseUTFEncodings(pdf);
+    HPDF_Font font = HPDF_GetFont(pdf, "Helvetica-Bold", "WinAnsiEncoding");
+    int n = cfg->iterations;
+    HPDF_Page page = NULL;
+
+    double start = now_ms();
+    for (int i = 0; i < n; i++) {
+        page = bench_page(pdf, page, i);
+        const CSVRow *row = &csv->rows[i % csv->row_count];
+        draw_text_in_box(page, font, 15, 205, 20, 140, row->fields[2 + i % (csv->field_count - 2)], 14, i % 3);
+    }
+    add_result("draw_text_in_box", (now_ms() - start) * 1000.0 / n, "us/op", 0);
+
+    page = NULL;
+    start = now_ms();
+    for (int i = 0; i < n; i++) {
+        page = bench_page(pdf, page, i);
+        draw_qr_code(page, 60, 150, 300, csv->rows[i % csv->row_count].fields[2]);
+    }
+    add_result("draw_qr_code", (now_ms() - start) * 1000.0 / n, "us/op", 0);
+
+    page = NULL;
+    start = now_ms();
+    for (int i = 0; i < n; i++) {
+        page = bench_page(pdf, page, i);
+        const CSVRow *row = &csv->rows[i % csv->row_count];
+        if (i % 2) {
+            draw_barcode(page, 15, 30, 190, 100, BARCODE_EAN13, row->fields[1]);
+        } else {
+            draw_barcode(page, 15, 30, 190, 100, BARCODE_CODE128, row->fields[0]);
+        }
+    }
+    add_result("draw_barcode", (now_ms() - start) * 1000.0 / n, "us/op", 0);
+
+    HPDF_Free(pdf);
+}
+
+// Render the wrap workload untimed, then time only the save
+static void bench_save(const BenchConfig *cfg, const CSVData *csv) {
+    char template_path[MAX_BENCH_PATH];
+    char pdf_path[MAX_BENCH_PATH];
+    bench_path(template_path, cfg, "wrap.json");
+    bench_path(pdf_path, cfg, "save.pdf");
+
+    cJSON *root = load_json_config(template_path);
+    if (!root) return;
+
+    FontConfig font_config;
+    memset(&font_config, 0, sizeof(font_config));
+    HPDF_Doc pdf = create_label_doc(root, &font_config, NULL);
+    LabelTemplate tpl;
+    RenderContext ctx;
+    if (pdf && compile_template(root, csv, &font_config, &tpl) == 0) {
+        if (render_context_init(&ctx, pdf, &tpl) == 0) {
+            ctx.hex_state = hex_code_seed(cfg->seed);
+            render_rows(&ctx, csv, 0, csv->row_count - 1, 1);
+
+            double start = now_ms();
+            if (HPDF_SaveToFile(pdf, pdf_path) == HPDF_OK) {
+                double ms = now_ms() - start;
+                add_result("HPDF_SaveToFile", ms, "ms", 0);
+                if (ms > 0) {
+                    add_result("HPDF_SaveToFile_throughput",
+                               (double)file_size(pdf_path) / 1048576.0 / (ms / 1000.0), "MB/s", 1);
+                }
+            }
+            render_context_free(&ctx);
+        }
+        free_template(&tpl);
+    }
+
+    if (pdf) HPDF_Free(pdf);
+    free_font_config(&font_config);
+    cJSON_Delete(root);
+}
+
+/* ---------- End to End ---------- */
+
+// The same steps as FDCLabel.exe: config, CSV, document, render, save
+static void bench_end_to_end(const BenchConfig *cfg, const char *workload, const char *csv_path) {
+    char template_path[MAX_BENCH_PATH];
+    char pdf_path[MAX_BENCH_PATH];
+    char name[64];
+    char file[64];
+
+    snprintf(file, sizeof(file), "%s.json", workload);
+    bench_path(template_path, cfg, file);
+    snprintf(file, sizeof(file), "%s.pdf", workload);
+    bench_path(pdf_path, cfg, file);
+    if (file_size(template_path) < 0) return;
+
+    double start = now_ms();
+    int generated = -1;
+
+    cJSON *root = load_json_config(template_path);
+    CSVData *csv = root ? parse_csv(csv_path, NULL, 0, NULL) : NULL;
+    FontConfig font_config;
+    memset(&font_config, 0, sizeof(font_config));
+    HPDF_Doc pdf = csv ? create_label_doc(root, &font_config, NULL) : NULL;
+    LabelTemplate tpl;
+    if (pdf && compile_template(root, csv, &font_config, &tpl) == 0) {
+        RenderContext ctx;
+        if (render_context_init(&ctx, pdf, &tpl) == 0) {
+            ctx.hex_state = hex_code_seed(cfg->seed);
+            generated = render_rows(&ctx, csv, 0, csv->row_count - 1, cfg->threads);
+            if (HPDF_SaveToFile(pdf, pdf_path) != HPDF_OK) generated = -1;
+            render_context_free(&ctx);
+        }
+        free_template(&tpl);
+    }
+    if (pdf) HPDF_Free(pdf);
+
+    double ms = now_ms() - start;
+
+    free_font_config(&font_config);
+    free_csv_data(csv);
+    cJSON_Delete(root);
+
+    if (generated <= 0) {
+        fprintf(stderr, "Warning: End to end run '%s' failed\n", workload);
+        return;
+    }
+
+    snprintf(name, sizeof(name), "%s_labels_per_sec", workload);
+    add_result(name, generated / (ms / 1000.0), "labels/s", 1);
+    snprintf(name, sizeof(name), "%s_bytes_per_label", workload);
+    add_result(name, (double)file_size(pdf_path) / generated, "bytes", 0);
+    snprintf(name, sizeof(name), "%s_peak_rss", workload);
+    add_result(name, peak_rss_kb(), "KB", 0);
+}
+
+/* ---------- Report ---------- */
+
+static int save_results(const char *path) {
+    FILE *f = fopen(path, "w");
+    if (!f) {
+        fprintf(stderr, "Cannot write results file: %s\n", path);
+        return -1;
+    }
+    fprintf(f, "name,value,unit\n");
+    for (int i = 0; i < result_count; i++) {
+        fprintf(f, "%s,%.6g,%s\n", results[i].name, results[i].value, results[i].unit);
+    }
+    return fclose(f) == 0 ? 0 : -1;
+}
+
+// Value of `name` in a results file written by save_results
+static int find_baseline(FILE *f, const char *name, double *value) {
+    char line[256];
+    size_t len = strlen(name);
+
+    rewind(f);
+    while (fgets(line, sizeof(line), f)) {
+        if (strncmp(line, name, len) == 0 && line[len] == ',') {
+            *value = strtod(line + len + 1, NULL);
+            return 0;
+        }
+    }
+    return -1;
+}
+
+// Print every result, next to its baseline when comparing. Returns the
+// number of results worse than the baseline by more than the tolerance.
+static int print_report(const BenchConfig *cfg) {
+    FILE *baseline = NULL;
+    if (cfg->compare_file) {
+        baseline = fopen(cfg->compare_file, "r");
+        if (!baseline) fprintf(stderr, "Cannot open results file: %s\n", cfg->compare_file);
+    }
+
+    int regressions = 0;
+    printf("\n%-28s %14s %-9s", "benchmark", "value", "unit");
+    if (baseline) printf(" %14s %9s", "baseline", "change");
+    printf("\n");
+
+    for (int i = 0; i < result_count; i++) {
+        const BenchResult *r = &results[i];
+        printf("%-28s %14.3f %-9s", r->name, r->value, r->unit);
+
+        double old;
+        if (baseline && find_baseline(baseline, r->name, &old) == 0 && old > 0) {
+            double change = (r->value - old) / old * 100.0;
+            int worse = r->higher_is_better ? change < -cfg->tolerance : change > cfg->tolerance;
+            printf(" %14.3f %+8.1f%%%s", old, change, worse ? "  REGRESSION" : "");
+            if (worse) regressions++;
+        }
+        printf("\n");
+    }
+
+    if (baseline) {
+        fclose(baseline);
+        if (regressions > 0) {
+            printf("\n%d result(s) regressed by more than %.0f%%\n", regressions, cfg->tolerance);
+        } else {
+            printf("\nNo regressions beyond %.0f%%\n", cfg->tolerance);
+        }
+    }
+    return regressions;
+}
+
+static void print_bench_help(const char *program_name) {
+    printf("Usage: %s [options]\n", program_name);
+    printf("\nData:\n");
+    printf("  --rows N             Rows of the synthetic CSV (default: 2000)\n");
+    printf("  --columns N          Columns, at least 3: sku, ean and text (default: 8)\n");
+    printf("  --field-length N     Average bytes of a text value (default: 24)\n");
+    printf("  --quoted PCT         Percentage of quoted text values (default: 20)\n");
+    printf("  --utf8 PCT           Percentage of text values with UTF-8 words (default: 10)\n");
+    printf("  --font FILE          TTF font for the custom font workload (default: none)\n");
+    printf("  --seed N             Seed of the data generator (default: 1)\n");
+    printf("  --out DIR            Directory for data, templates and PDFs (default: bench_data)\n");
+    printf("  --generate-only      Write the CSV and templates and stop\n");
+    printf("\nRuns:\n");
+    printf("  --iterations N       Calls per micro benchmark (default: 2000)\n");
+    printf("  -t, --threads N      Layout threads of the end to end runs (default: 1)\n");
+    printf("  --save FILE          Write the results as CSV\n");
+    printf("  --compare FILE       Compare with results saved earlier, exit 1 on regression\n");
+    printf("  --tolerance PCT      Change that counts as a regression (default: 10)\n");
+}
+
+//Main
+int main(int argc, char **argv) {
+    BenchConfig cfg;
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.rows = 2000;
+    cfg.columns = 8;
+    cfg.field_length = 24;
+    cfg.quoted_percent = 20;
+    cfg.utf8_percent = 10;
+    cfg.iterations = 2000;
+    cfg.threads = 1;
+    cfg.seed = 1;
+    cfg.out_dir = "bench_data";
+    cfg.tolerance = 10.0;
+
+    // Only problems, the renderer's messages would mix with the report
+    log_level = LOG_WARNING;
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+
+        if (strcmp(arg, "-h") == 0 || strcmp(arg, "--help") == 0) {
+            print_bench_help(argv[0]);
+            return 0;
+        }
+        else if (strcmp(arg, "--generate-only") == 0) cfg.generate_only = 1;
+        else if (!value) {
+            fprintf(stderr, "Error: Unknown option: %s\n", arg);
+            print_bench_help(argv[0]);
+            return 1;
+        }
+        else if (strcmp(arg, "--rows") == 0) cfg.rows = safe_atoi(argv[++i], cfg.rows);
+        else if (strcmp(arg, "--columns") == 0) cfg.columns = safe_atoi(argv[++i], cfg.columns);
+        else if (strcmp(arg, "--field-length") == 0) cfg.field_length = safe_atoi(argv[++i], cfg.field_length);
+        else if (strcmp(arg, "--quoted") == 0) cfg.quoted_percent = safe_atoi(argv[++i], cfg.quoted_percent);
+        else if (strcmp(arg, "--utf8") == 0) cfg.utf8_percent = safe_atoi(argv[++i], cfg.utf8_percent);
+        else if (strcmp(arg, "--font") == 0) cfg.font_file = argv[++i];
+        else if (strcmp(arg, "--seed") == 0) cfg.seed = (unsigned int)safe_atoi(argv[++i], 1);
+        else if (strcmp(arg, "--out") == 0) cfg.out_dir = argv[++i];
+        else if (strcmp(arg, "--iterations") == 0) cfg.iterations = safe_atoi(argv[++i], cfg.iterations);
+        else if (strcmp(arg, "-t") == 0 || strcmp(arg, "--threads") == 0) cfg.threads = safe_atoi(argv[++i], 1);
+        else if (strcmp(arg, "--save") == 0) cfg.save_file = argv[++i];
+        else if (strcmp(arg, "--compare") == 0) cfg.compare_file = argv[++i];
+        else if (strcmp(arg, "--tolerance") == 0) cfg.tolerance = safe_atoi(argv[++i], 10);
+        else {
+            fprintf(stderr, "Error: Unknown option: %s\n", arg);
+            print_bench_help(argv[0]);
+            return 1;
+        }
+    }
+
+    if (cfg.rows < 1 || cfg.rows > MAX_CSV_ROWS) {
+        fprintf(stderr, "Error: Rows must be between 1 and %d\n", MAX_CSV_ROWS);
+        return 1;
+    }
+    if (cfg.columns < 3 || cfg.columns > MAX_CSV_FIELDS) {
+        fprintf(stderr, "Error: Columns must be between 3 and %d\n", MAX_CSV_FIELDS);
+        return 1;
+    }
+    if (cfg.field_length < 1) cfg.field_length = 1;
+    if (cfg.iterations < 1) cfg.iterations = 1;
+    if (cfg.threads < 1) cfg.threads = 1;
+    if (cfg.threads > MAX_RENDER_THREADS) cfg.threads = MAX_RENDER_THREADS;
+
+    rng_state = cfg.seed ? cfg.seed : 1;
+
+    char csv_path[MAX_BENCH_PATH];
+    make_dir(cfg.out_dir);
+    bench_path(csv_path, &cfg, "data.csv");
+    if (generate_csv(&cfg, csv_path) != 0 || generate_templates(&cfg) != 0) {
+        return 1;
+    }
+    printf("Generated %s: %d rows, %d columns (%ld bytes)\n", csv_path, cfg.rows, cfg.columns,
+           file_size(csv_path));
+    if (cfg.generate_only) return 0;
+
+    CSVData *csv = parse_csv(csv_path, NULL, 0, NULL);
+    if (!csv) {
+        fprintf(stderr, "Failed to parse CSV file: %s\n", csv_path);
+        return 1;
+    }
+
+    printf("Running micro benchmarks (%d iterations)\n", cfg.iterations);
+    bench_parse_csv(&cfg, csv_path);
+    bench_drawing(&cfg, csv);
+    bench_save(&cfg, csv);
+    free_csv_data(csv);
+
+    printf("Running end to end workloads (%d rows, %d threads)\n", cfg.rows, cfg.threads);
+    for (int i = 0; i < WORKLOAD_COUNT; i++) {
+        bench_end_to_end(&cfg, workloads[i], csv_path);
+    }
+
+    int regressions = print_report(&cfg);
+    if (cfg.save_file && save_results(cfg.save_file) == 0) {
+        printf("Results saved to: %s\n", cfg.save_file);
+    }
+    return regressions > 0 ? 1 : 0;
+}
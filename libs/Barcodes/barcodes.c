@@ -185,6 +185,132 @@ int validate_barcode_data(BarcodeType type, const char* data) {
     }
 }
 
+/* ---------- Module Patterns ---------- */
+
+// Append the bars and spaces of a '0'/'1' pattern
+static int put_pattern(unsigned char* modules, int count, int max_modules, const char* pattern) {
+    for (; *pattern; pattern++) {
+        if (count >= max_modules) return -1;
+        modules[count++] = (unsigned char)(*pattern == '1');
+    }
+    return count;
+}
+
+static int code128_modules(const char* data, unsigned char* modules, int max_modules, int* width_modules) {
+    int codes[256];
+    // Start, checksum and stop codes around the data
+    if (strlen(data) > sizeof(codes) / sizeof(codes[0]) - 3) return 0;
+
+    int code_count = code128_encode_string(data, codes);
+    if (code_count == 0) return 0;
+
+    // Left quiet zone (10 modules)
+    int count = 0;
+    for (; count < 10 && count < max_modules; count++) {
+        modules[count] = 0;
+    }
+
+    for (int i = 0; i < code_count && count >= 0; i++) {
+        count = put_pattern(modules, count, max_modules, code128_encoding[codes[i]]);
+    }
+    if (count < 0) return 0;
+
+    // Symbol width plus quiet zones
+    *width_modules = count + 1;
+    return count;
+}
+
+static int ean13_modules(const char* data, unsigned char* modules, int max_modules, int* width_modules) {
+    // Left guard bars
+    int count = put_pattern(modules, 0, max_modules, "110");
+
+    // Determine left-hand pattern set from first digit
+    int first_digit = data[0] - '0';
+    const char* pattern_set = ean_first_digit_patterns[first_digit];
+
+    // Left-hand digits (positions 1-6)
+    for (int i = 1; i <= 6 && count >= 0; i++) {
+        int digit = data[i] - '0';
+        int set = pattern_set[i-1] == 'A' ? 0 : 1;
+        count = put_pattern(modules, count, max_modules, ean_left_patterns[digit][set]);
+    }
+
+    // Center guard bars
+    if (count >= 0) count = put_pattern(modules, count, max_modules, "01010");
+
+    // Right-hand digits (positions 7-12)
+    for (int i = 7; i <= 12 && count >= 0; i++) {
+        count = put_pattern(modules, count, max_modules, ean_right_patterns[data[i] - '0']);
+    }
+
+    // Right guard bars
+    if (count >= 0) count = put_pattern(modules, count, max_modules, "0101");
+    if (count < 0) return 0;
+
+    *width_modules = 95; // EAN-13 has 95 modules total
+    return count;
+}
+
+// Bars and spaces of a symbol, one byte per module (1 for a bar) from the
+// left edge of the barcode area. width_modules receives the number of
+// modules spanning the barcode width. Returns the module count, 0 when the
+// data cannot be encoded.
+int barcode_modules(BarcodeType type, const char* data, unsigned char* modules,
+                    int max_modules, int* width_modules) {
+    if (!data || !modules || !width_modules || !validate_barcode_data(type, data)) return 0;
+
+    switch (type) {
+        case BARCODE_CODE128:
+            return code128_modules(data, modules, max_modules, width_modules);
+
+        case BARCODE_EAN13:
+            return ean13_modules(data, modules, max_modules, width_modules);
+
+        case BARCODE_UPCA: {
+            // Convert UPC-A to EAN-13 format (add leading 0)
+            char ean13_data[14];
+            snprintf(ean13_data, sizeof(ean13_data), "0%s", data);
+            return ean13_modules(ean13_data, modules, max_modules, width_modules);
+        }
+
+        default:
+            return 0;
+    }
+}
+
+// One rectangle per run of adjacent bars, all filled at once
+static void fill_modules(HPDF_Page page, float x, float y, float module_width, float height,
+                         const unsigned char* modules, int count) {
+    int bars = 0;
+    int j = 0;
+    while (j < count) {
+        if (!modules[j]) {
+            j++;
+            continue;
+        }
+        int start = j;
+        while (j < count && modules[j]) j++;
+
+        HPDF_Page_Rectangle(page, x + start * module_width, y, (j - start) * module_width, height);
+        bars++;
+    }
+
+    if (bars > 0) HPDF_Page_Fill(page);
+}
+
+// Pack modules into a one row stencil mask, a clear bit for each bar
+HPDF_Image create_barcode_image(HPDF_Doc pdf, const unsigned char* modules, int count) {
+    if (!pdf || !modules || count <= 0 || count > BARCODE_MAX_MODULES) return NULL;
+
+    unsigned char bits[(BARCODE_MAX_MODULES + 7) / 8];
+    memset(bits, 0xFF, (count + 7) / 8);
+    for (int i = 0; i < count; i++) {
+        if (modules[i]) bits[i >> 3] &= (unsigned char)~(0x80 >> (i & 7));
+    }
+
+    return HPDF_LoadImageMaskFromMem(pdf, bits, count, 1);
+}
+
 void draw_barcode(HPDF_Page page, float x, float y, float width, float height, 
                   BarcodeType type, const char* data) {
     if (!page || !data || width <= 0 || height <= 0) return;
@@ -211,187 +337,24 @@ void draw_barcode(HPDF_Page page, float x, float y, float width, float height,
     HPDF_Page_GRestore(page);
 }
 
+static void draw_symbol(HPDF_Page page, float x, float y, float width, float height,
+                        BarcodeType type, const char* data) {
+    unsigned char modules[BARCODE_MAX_MODULES];
+    int width_modules;
+    int count = barcode_modules(type, data, modules, BARCODE_MAX_MODULES, &width_modules);
+    if (count == 0) return;
+
+    fill_modules(page, x, y, width / width_modules, height, modules, count);
+}
+
 void draw_code128(HPDF_Page page, float x, float y, float width, float height, const char* data) {
-    if (!validate_barcode_data(BARCODE_CODE128, data)) return;
-    
-    int codes[256];
-    int code_count = code128_encode_string(data, codes);
-    if (code_count == 0) return;
-    
-    // Calculate module width
-    int total_modules = 0;
-    for (int i = 0; i < code_count; i++) {
-        total_modules += strlen(code128_encoding[codes[i]]);
-    }
-    total_modules += 11; // Add quiet zones
-    
-    float module_width = width / total_modules;
-    float current_x = x;
-    
-    // Left quiet zone (10 modules)
-    current_x += module_width * 10;
-    
-    // Group adjacent bars into single rectangles
-    for (int i = 0; i < code_count; i++) {
-        const char* pattern = code128_encoding[codes[i]];
-        int pattern_len = strlen(pattern);
-        
-        int j = 0;
-        while (j < pattern_len) {
-            if (pattern[j] == '1') {
-                // Find consecutive '1's to draw as a single rectangle
-                int start = j;
-                while (j < pattern_len && pattern[j] == '1') {
-                    j++;
-                }
-                int consecutive_ones = j - start;
-                
-                HPDF_Page_Rectangle(page,
-                    current_x + (start * module_width),
-                    y,
-                    consecutive_ones * module_width,
-                    height
-                );
-                HPDF_Page_Fill(page);
-            } else {
-                j++;
-            }
-        }
-        current_x += pattern_len * module_width;
-    }
+    draw_symbol(page, x, y, width, height, BARCODE_CODE128, data);
 }
 
 void draw_ean13(HPDF_Page page, float x, float y, float width, float height, const char* data) {
-    if (!validate_barcode_data(BARCODE_EAN13, data)) return;
-    
-    // Calculate module width
-    float module_width = width / 95.0f; // EAN-13 has 95 modules total
-    float current_x = x;
-    
-    // Left guard bars - draw as single rectangles
-    HPDF_Page_Rectangle(page, current_x, y, module_width, height);
-    HPDF_Page_Fill(page);
-    current_x += module_width;
-    
-    HPDF_Page_Rectangle(page, current_x, y, module_width, height);
-    HPDF_Page_Fill(page);
-    current_x += module_width;
-    
-    // Space between left guard bars
-    current_x += module_width;
-    
-    // Determine left-hand pattern set from first digit
-    int first_digit = data[0] - '0';
-    const char* pattern_set = ean_first_digit_patterns[first_digit];
-    
-    // Left-hand digits (positions 1-6)
-    for (int i = 1; i <= 6; i++) {
-        int digit = data[i] - '0';
-        const char* pattern;
-        
-        if (pattern_set[i-1] == 'A') {
-            pattern = ean_left_patterns[digit][0];
-        } else {
-            pattern = ean_left_patterns[digit][1];
-        }
-        
-        // Group consecutive bars
-        int j = 0;
-        while (j < 7) {
-            if (pattern[j] == '1') {
-                // Find consecutive '1's to draw as a single rectangle
-                int start = j;
-                while (j < 7 && pattern[j] == '1') {
-                    j++;
-                }
-                int consecutive_ones = j - start;
-                
-                HPDF_Page_Rectangle(page,
-                    current_x + (start * module_width),
-                    y,
-                    consecutive_ones * module_width,
-                    height
-                );
-                HPDF_Page_Fill(page);
-            } else {
-                j++;
-            }
-        }
-        current_x += 7 * module_width;
-    }
-    
-    // Center guard bars - space before first bar
-    current_x += module_width;
-    
-    // First center guard bar
-    HPDF_Page_Rectangle(page, current_x, y, module_width, height);
-    HPDF_Page_Fill(page);
-    current_x += module_width;
-    
-    // Space between center guard bars
-    current_x += module_width;
-    
-    // Second center guard bar
-    HPDF_Page_Rectangle(page, current_x, y, module_width, height);
-    HPDF_Page_Fill(page);
-    current_x += module_width;
-    
-    // Space after center guard bars
-    current_x += module_width;
-    
-    // Right-hand digits (positions 7-12)
-    for (int i = 7; i <= 12; i++) {
-        int digit = data[i] - '0';
-        const char* pattern = ean_right_patterns[digit];
-        
-        // Group consecutive bars
-        int j = 0;
-        while (j < 7) {
-            if (pattern[j] == '1') {
-                // Find consecutive '1's to draw as a single rectangle
-                int start = j;
-                while (j < 7 && pattern[j] == '1') {
-                    j++;
-                }
-                int consecutive_ones = j - start;
-                
-                HPDF_Page_Rectangle(page,
-                    current_x + (start * module_width),
-                    y,
-                    consecutive_ones * module_width,
-                    height
-                );
-                HPDF_Page_Fill(page);
-            } else {
-                j++;
-            }
-        }
-        current_x += 7 * module_width;
-    }
-    
-    // Right guard bars - space before first bar
-    current_x += module_width;
-    
-    // First right guard bar
-    HPDF_Page_Rectangle(page, current_x, y, module_width, height);
-    HPDF_Page_Fill(page);
-    current_x += module_width;
-    
-    // Space between right guard bars
-    current_x += module_width;
-    
-    // Second right guard bar
-    HPDF_Page_Rectangle(page, current_x, y, module_width, height);
-    HPDF_Page_Fill(page);
+    draw_symbol(page, x, y, width, height, BARCODE_EAN13, data);
 }
 
 void draw_upca(HPDF_Page page, float x, float y, float width, float height, const char* data) {
-    if (!validate_barcode_data(BARCODE_UPCA, data)) return;
-    
-    // Convert UPC-A to EAN-13 format (add leading 0)
-    char ean13_data[14];
-    snprintf(ean13_data, sizeof(ean13_data), "0%s", data);
-    
-    // Draw as EAN-13 (UPC-A is a subset of EAN-13)
-    draw_ean13(page, x, y, width, height, ean13_data);
+    draw_symbol(page, x, y, width, height, BARCODE_UPCA, data);
 }
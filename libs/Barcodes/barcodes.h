@@ -3,6 +3,9 @@
 
 #include "hpdf.h"
 
+// Longest module pattern: quiet zone plus 256 Code128 symbols
+#define BARCODE_MAX_MODULES (10 + 256 * 11)
+
 typedef enum {
     BARCODE_CODE128,
     BARCODE_EAN13,
@@ -12,6 +15,13 @@ typedef enum {
 // Barcode validation
 int validate_barcode_data(BarcodeType type, const char* data);
 
+// Bars and spaces of a symbol, one byte per module (1 for a bar)
+int barcode_modules(BarcodeType type, const char* data, unsigned char* modules,
+                    int max_modules, int* width_modules);
+
+// One row image mask of a module pattern, to be stretched over the barcode area
+HPDF_Image create_barcode_image(HPDF_Doc pdf, const unsigned char* modules, int count);
+
 // Main barcode drawing function
 void draw_barcode(HPDF_Page page, float x, float y, float width, float height, 
                   BarcodeType type, const char* data);
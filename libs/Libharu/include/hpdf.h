@@ -166,6 +166,20 @@ HPDF_SaveToFile  (HPDF_Doc     pdf,
                   const char  *file_name);
 
 
+HPDF_EXPORT(HPDF_STATUS)
+HPDF_BeginStreamingSave  (HPDF_Doc     pdf,
+                          const char  *file_name);
+
+
+HPDF_EXPORT(HPDF_STATUS)
+HPDF_FlushPage  (HPDF_Doc    pdf,
+                 HPDF_Page   page);
+
+
+HPDF_EXPORT(HPDF_STATUS)
+HPDF_EndStreamingSave  (HPDF_Doc   pdf);
+
+
 HPDF_EXPORT(HPDF_STATUS)
 HPDF_GetError  (HPDF_Doc   pdf);
 
@@ -494,6 +508,38 @@ HPDF_Page_CreateXObjectAsWhiteRect  (HPDF_Doc   pdf,
                                      HPDF_Page  page,
                                      HPDF_Rect  rect);
 
+HPDF_EXPORT(HPDF_XObject)
+HPDF_Page_BeginFormXObject  (HPDF_Doc   pdf,
+                             HPDF_Page  page,
+                             HPDF_Rect  bbox);
+
+HPDF_EXPORT(HPDF_STATUS)
+HPDF_Page_EndFormXObject  (HPDF_Page  page);
+
+/*--------------------------------------------------------------------------*/
+/*----- compression ahead of saving ----------------------------------------*/
+
+HPDF_EXPORT(HPDF_UINT)
+HPDF_Page_GetDeflateBound  (HPDF_Page  page);
+
+HPDF_EXPORT(HPDF_STATUS)
+HPDF_Page_DeflateContents  (HPDF_Page   page,
+                            HPDF_INT    level,
+                            HPDF_INT    strategy,
+                            HPDF_BYTE  *buf,
+                            HPDF_UINT  *len);
+
+HPDF_EXPORT(HPDF_STATUS)
+HPDF_Page_SetDeflatedContents  (HPDF_Page         page,
+                                const HPDF_BYTE  *buf,
+                                HPDF_UINT         len);
+
+HPDF_EXPORT(HPDF_UINT)
+HPDF_Page_GetContentsSize  (HPDF_Page  page);
+
+HPDF_EXPORT(HPDF_UINT)
+HPDF_Page_GetOperatorCount  (HPDF_Page  page);
+
 /*--------------------------------------------------------------------------*/
 /*----- annotation ---------------------------------------------------------*/
 
@@ -855,6 +901,13 @@ HPDF_LoadRawImageFromMem  (HPDF_Doc           pdf,
                            HPDF_ColorSpace    color_space,
                            HPDF_UINT          bits_per_component);
 
+
+HPDF_EXPORT(HPDF_Image)
+HPDF_LoadImageMaskFromMem  (HPDF_Doc           pdf,
+                            const HPDF_BYTE   *buf,
+                            HPDF_UINT          width,
+                            HPDF_UINT          height);
+
 HPDF_EXPORT(HPDF_STATUS)
 HPDF_Image_AddSMask  (HPDF_Image    image,
                       HPDF_Image    smask);
@@ -947,6 +1000,18 @@ HPDF_SetCompressionMode  (HPDF_Doc    pdf,
                           HPDF_UINT   mode);
 
 
+HPDF_EXPORT(HPDF_STATUS)
+HPDF_SetCompressionLevel  (HPDF_Doc    pdf,
+                           HPDF_INT    level,
+                           HPDF_INT    strategy);
+
+
+HPDF_EXPORT(HPDF_STATUS)
+HPDF_GetDeflateTotals  (HPDF_Doc      pdf,
+                        HPDF_UINT64  *in_size,
+                        HPDF_UINT64  *out_size);
+
+
 /*--------------------------------------------------------------------------*/
 /*----- font ---------------------------------------------------------------*/
 
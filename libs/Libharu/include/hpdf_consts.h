@@ -81,6 +81,16 @@
  */
 #define  HPDF_COMP_MASK            0xFF
 
+/* deflate level and strategy, the values zlib uses */
+#define  HPDF_COMP_LEVEL_DEFAULT      -1
+#define  HPDF_COMP_LEVEL_STORE        0
+#define  HPDF_COMP_LEVEL_BEST_SPEED   1
+#define  HPDF_COMP_LEVEL_BEST         9
+#define  HPDF_COMP_STRATEGY_DEFAULT   0
+#define  HPDF_COMP_STRATEGY_FILTERED  1
+#define  HPDF_COMP_STRATEGY_HUFFMAN   2
+#define  HPDF_COMP_STRATEGY_RLE       3
+
 
 /*----------------------------------------------------------------------------*/
 /*----- permission flags (only Revision 2 is supported)-----------------------*/
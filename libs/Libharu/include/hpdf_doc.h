@@ -52,6 +52,10 @@ typedef struct _HPDF_Doc_Rec {
     HPDF_List         font_mgr;
     HPDF_BYTE         ttfont_tag[6];
 
+    /* open addressing index of font_mgr by font name and encoding */
+    HPDF_Font        *font_index;
+    HPDF_UINT         font_index_size;
+
     /* list for loaded fontdefs */
     HPDF_List         fontdef_list;
 
@@ -62,6 +66,12 @@ typedef struct _HPDF_Doc_Rec {
 
     /* default compression mode */
     HPDF_BOOL         compression_mode;
+    HPDF_INT          compression_level;
+    HPDF_INT          compression_strategy;
+
+    /* bytes deflated by the last save, before and after compression */
+    HPDF_UINT64       deflate_in;
+    HPDF_UINT64       deflate_out;
 
     HPDF_BOOL         encrypt_on;
     HPDF_EncryptDict  encrypt_dict;
@@ -74,6 +84,10 @@ typedef struct _HPDF_Doc_Rec {
     /* buffer for saving into memory stream */
     HPDF_Stream       stream;
 
+    /* file stream for incremental saving (HPDF_BeginStreamingSave) */
+    HPDF_Stream       output;
+    HPDF_BOOL         streamed;
+
     /* PDF/A conformance */
     HPDF_PDFAType     pdfa_type;
     HPDF_List         xmp_extensions;
@@ -75,6 +75,14 @@ HPDF_Image_LoadRawImageFromMem  (HPDF_MMgr          mmgr,
                                  HPDF_UINT          bits_per_component);
 
 
+HPDF_Image
+HPDF_Image_LoadRawMaskFromMem  (HPDF_MMgr          mmgr,
+                                const HPDF_BYTE   *buf,
+                                HPDF_Xref          xref,
+                                HPDF_UINT          width,
+                                HPDF_UINT          height);
+
+
 HPDF_BOOL
 HPDF_Image_Validate (HPDF_Image  image);
 
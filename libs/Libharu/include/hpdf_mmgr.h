@@ -25,8 +25,28 @@
 extern "C" {
 #endif
 
+/*
+ *  size classes of the memory pool: 16 byte steps up to 256 bytes, then
+ *  powers of two up to 64K. larger blocks bypass the pool.
+ */
+#define HPDF_MPOOL_SMALL_STEP      16
+#define HPDF_MPOOL_SMALL_MAX       256
+#define HPDF_MPOOL_MEDIUM_MIN      512
+#define HPDF_MPOOL_MAX_BLOCK       65536
+#define HPDF_MPOOL_CLASSES         24
+#define HPDF_MPOOL_LARGE           0xFFFFFFFF
+
 typedef struct  _HPDF_MPool_Node_Rec  *HPDF_MPool_Node;
 
+/* header in front of every block handed out by the memory pool */
+typedef union  _HPDF_MPool_Block_Rec  *HPDF_MPool_Block;
+
+typedef union  _HPDF_MPool_Block_Rec {
+    HPDF_UINT         size_class;
+    HPDF_MPool_Block  next;     /* while the block is on a free list */
+    double            align;
+} HPDF_MPool_Block_Rec;
+
 typedef struct  _HPDF_MPool_Node_Rec {
     HPDF_BYTE*       buf;
     HPDF_UINT        size;
@@ -43,6 +63,7 @@ typedef struct  _HPDF_MMgr_Rec {
     HPDF_Free_Func    free_fn;
     HPDF_MPool_Node   mpool;
     HPDF_UINT         buf_size;
+    HPDF_MPool_Block  free_list[HPDF_MPOOL_CLASSES];
 
 #ifdef HPDF_MEM_DEBUG
     HPDF_UINT         alloc_cnt;
@@ -55,7 +76,10 @@ typedef struct  _HPDF_MMgr_Rec {
  *
  *  create new HPDF_mpool object. when memory allocation goes wrong,
  *  it returns NULL and error handling function will be called.
- *  if buf_size is non-zero, mmgr is configured to be using memory-pool
+ *  if buf_size is non-zero, mmgr is configured to be using memory-pool:
+ *  blocks are cut from buf_size chunks, freed blocks are kept on a free
+ *  list per size class for reuse, and the chunks are released together
+ *  by HPDF_MMgr_Free.
  */
 HPDF_MMgr
 HPDF_MMgr_New  (HPDF_Error       error,
@@ -430,6 +430,7 @@ typedef struct _HPDF_Dict_Rec {
     HPDF_Stream                stream;
     HPDF_UINT                  filter;
     HPDF_Dict                  filterParams;
+    HPDF_BOOL                  encoded;    /* stream already holds filtered data */
     void                       *attr;
 } HPDF_Dict_Rec;
 
@@ -455,6 +456,10 @@ void
 HPDF_Dict_Free  (HPDF_Dict  dict);
 
 
+void
+HPDF_Dict_Clear  (HPDF_Dict  dict);
+
+
 HPDF_STATUS
 HPDF_Dict_Write  (HPDF_Dict     dict,
                   HPDF_Stream   stream,
@@ -536,6 +541,7 @@ typedef struct _HPDF_XrefEntry_Rec {
       HPDF_UINT    byte_offset;
       HPDF_UINT16  gen_no;
       void*        obj;
+      HPDF_BOOL    flushed;   /* already written by HPDF_Xref_FlushObject */
 } HPDF_XrefEntry_Rec;
 
 
@@ -569,6 +575,18 @@ HPDF_Xref_GetEntry  (HPDF_Xref  xref,
                      HPDF_UINT  index);
 
 
+HPDF_STATUS
+HPDF_Xref_FlushObject  (HPDF_Xref     xref,
+                        void          *obj,
+                        HPDF_Stream   stream,
+                        HPDF_Encrypt  e);
+
+
+HPDF_STATUS
+HPDF_Xref_ReleaseObject  (HPDF_Xref  xref,
+                          void       *obj);
+
+
 HPDF_STATUS
 HPDF_Xref_WriteToStream  (HPDF_Xref     xref,
                           HPDF_Stream   stream,
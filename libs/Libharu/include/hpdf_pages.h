@@ -48,6 +48,11 @@ HPDF_Page_InsertBefore  (HPDF_Page   page,
                          HPDF_Page   target);
 
 
+HPDF_STATUS
+HPDF_Page_Flush  (HPDF_Page     page,
+                  HPDF_Stream   stream);
+
+
 typedef struct _HPDF_PageAttr_Rec  *HPDF_PageAttr;
 
 typedef struct _HPDF_PageAttr_Rec {
@@ -67,6 +72,16 @@ typedef struct _HPDF_PageAttr_Rec {
     HPDF_Xref          xref;
     HPDF_UINT          compression_mode;
 	HPDF_PDFVer       *ver; 
+
+    /* Form XObject being drawn (HPDF_Page_BeginFormXObject) and the page
+     * content stream and resources it temporarily replaces */
+    HPDF_Dict          form;
+    HPDF_UINT          form_depth;
+    HPDF_Stream        page_stream;
+    HPDF_Dict          page_fonts;
+    HPDF_Dict          page_xobjects;
+    HPDF_Dict          page_ext_gstates;
+    HPDF_Dict          page_shadings;
 } HPDF_PageAttr_Rec;
 
 
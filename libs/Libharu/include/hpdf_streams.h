@@ -109,6 +109,10 @@ typedef struct _HPDF_Stream_Rec {
     HPDF_Stream_Tell_Func     tell_fn;
     HPDF_Stream_Size_Func     size_fn;
     void*                     attr;
+    HPDF_INT                  deflate_level;     /* for streams deflated into this one */
+    HPDF_INT                  deflate_strategy;
+    HPDF_UINT64               deflate_in;        /* bytes deflated into this one */
+    HPDF_UINT64               deflate_out;
 } HPDF_Stream_Rec;
 
 
@@ -142,6 +146,23 @@ void
 HPDF_MemStream_FreeData  (HPDF_Stream  stream);
 
 
+HPDF_UINT
+HPDF_MemStream_DeflateBound  (HPDF_Stream  stream);
+
+
+HPDF_STATUS
+HPDF_MemStream_Deflate  (HPDF_Stream  stream,
+                         HPDF_INT     level,
+                         HPDF_INT     strategy,
+                         HPDF_BYTE    *buf,
+                         HPDF_UINT    *len);
+
+
+HPDF_UINT
+HPDF_MemStream_CountByte  (HPDF_Stream  stream,
+                           HPDF_BYTE    c);
+
+
 HPDF_STATUS
 HPDF_Stream_WriteToStream  (HPDF_Stream   src,
                             HPDF_Stream   dst,
@@ -84,8 +84,10 @@ HPDF_Destination_Validate (HPDF_Destination  dst)
     if (dst->list->count < 2)
         return HPDF_FALSE;
 
+    /* only referred to: a page written by HPDF_Page_Flush is still valid */
     target = (HPDF_Page)HPDF_Array_GetItem (dst, 0, HPDF_OCLASS_DICT);
-    if (!HPDF_Page_Validate (target)) {
+    if (!target || target->header.obj_class !=
+                (HPDF_OCLASS_DICT | HPDF_OSUBCLASS_PAGE)) {
 	    HPDF_SetError (dst->error, HPDF_INVALID_PAGE, 0);
         return HPDF_FALSE;
     }
@@ -116,6 +116,40 @@ HPDF_Dict_Free  (HPDF_Dict  dict)
     HPDF_FreeMem (dict->mmgr, dict);
 }
 
+/*
+ *  HPDF_Dict_Clear
+ *
+ *  Release every element and the stream data of a dictionary that has
+ *  already been written, keeping the object itself so that references
+ *  to it stay valid.
+ */
+
+void
+HPDF_Dict_Clear  (HPDF_Dict  dict)
+{
+    HPDF_UINT i;
+
+    if (!dict)
+        return;
+
+    for (i = 0; i < dict->list->count; i++) {
+        HPDF_DictElement element =
+                (HPDF_DictElement)HPDF_List_ItemAt (dict->list, i);
+
+        if (element) {
+            HPDF_Obj_Free (dict->mmgr, element->value);
+            HPDF_FreeMem (dict->mmgr, element);
+        }
+    }
+
+    HPDF_List_Clear (dict->list);
+
+    if (dict->stream) {
+        HPDF_Stream_Free (dict->stream);
+        dict->stream = NULL;
+    }
+}
+
 HPDF_STATUS
 HPDF_Dict_Add_FilterParams(HPDF_Dict    dict, HPDF_Dict filterParam)
 {
@@ -260,7 +294,8 @@ HPDF_Dict_Write  (HPDF_Dict     dict,
             HPDF_Encrypt_Reset (e);
 
         if ((ret = HPDF_Stream_WriteToStream (dict->stream, stream,
-                        dict->filter, e)) != HPDF_OK)
+                        dict->encoded ? HPDF_STREAM_FILTER_NONE : dict->filter,
+                        e)) != HPDF_OK)
             return ret;
 
         HPDF_Number_SetValue (length, stream->size - strptr);
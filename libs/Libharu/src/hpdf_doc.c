@@ -179,6 +179,8 @@ HPDF_NewEx  (HPDF_Error_Handler    user_error_fn,
     pdf->mmgr = mmgr;
     pdf->pdf_version = HPDF_VER_13;
     pdf->compression_mode = HPDF_COMP_NONE;
+    pdf->compression_level = HPDF_COMP_LEVEL_DEFAULT;
+    pdf->compression_strategy = HPDF_COMP_STRATEGY_DEFAULT;
 
     /* copy the data of temporary-error object to the one which is
        included in pdf_doc object */
@@ -300,12 +302,20 @@ HPDF_FreeDoc  (HPDF_Doc  pdf)
             pdf->font_mgr = NULL;
         }
 
+        if (pdf->font_index) {
+            HPDF_FreeMem (pdf->mmgr, pdf->font_index);
+            pdf->font_index = NULL;
+            pdf->font_index_size = 0;
+        }
+
         if (pdf->fontdef_list)
             CleanupFontDefList (pdf);
 
         HPDF_MemSet(pdf->ttfont_tag, 0, 6);
 
         pdf->pdf_version = HPDF_VER_13;
+        pdf->deflate_in = 0;
+        pdf->deflate_out = 0;
         pdf->outlines = NULL;
         pdf->catalog = NULL;
         pdf->root_pages = NULL;
@@ -332,6 +342,12 @@ HPDF_FreeDoc  (HPDF_Doc  pdf)
             pdf->stream = NULL;
         }
 
+        if (pdf->output) {
+            HPDF_Stream_Free (pdf->output);
+            pdf->output = NULL;
+        }
+        pdf->streamed = HPDF_FALSE;
+
         pdf->pdfa_type = HPDF_PDFA_NON_PDFA;
         if (pdf->xmp_extensions) {
             HPDF_PDFA_ClearXmpExtensions(pdf);
@@ -357,6 +373,8 @@ HPDF_FreeDocAll  (HPDF_Doc  pdf)
             FreeEncoderList (pdf);
 
         pdf->compression_mode = HPDF_COMP_NONE;
+        pdf->compression_level = HPDF_COMP_LEVEL_DEFAULT;
+        pdf->compression_strategy = HPDF_COMP_STRATEGY_DEFAULT;
 
         HPDF_Error_Reset (&pdf->error);
     }
@@ -625,10 +643,19 @@ InternalSaveToStream  (HPDF_Doc      pdf,
 {
     HPDF_STATUS ret;
 
+    /* flushed pages are gone; the document can only be finished */
+    if (pdf->streamed)
+        return HPDF_RaiseError (&pdf->error, HPDF_INVALID_OPERATION, 0);
+
     /* Add metadata in case of PDF/A document */
     if (pdf->pdfa_type != HPDF_PDFA_NON_PDFA && (ret = HPDF_PDFA_AddXmpMetadata(pdf)) != HPDF_OK)
         return ret;
 
+    stream->deflate_level = pdf->compression_level;
+    stream->deflate_strategy = pdf->compression_strategy;
+    stream->deflate_in = 0;
+    stream->deflate_out = 0;
+
     if ((ret = WriteHeader (pdf, stream)) != HPDF_OK)
         return ret;
 
@@ -651,6 +678,9 @@ InternalSaveToStream  (HPDF_Doc      pdf,
             return ret;
     }
 
+    pdf->deflate_in = stream->deflate_in;
+    pdf->deflate_out = stream->deflate_out;
+
     return HPDF_OK;
 }
 
@@ -778,6 +808,9 @@ HPDF_SaveToFile  (HPDF_Doc     pdf,
     if (!HPDF_HasDoc (pdf))
         return HPDF_INVALID_DOCUMENT;
 
+    if (pdf->streamed)
+        return HPDF_RaiseError (&pdf->error, HPDF_INVALID_OPERATION, 0);
+
     stream = HPDF_FileWriter_New (pdf->mmgr, file_name);
     if (!stream)
         return HPDF_CheckError (&pdf->error);
@@ -790,6 +823,87 @@ HPDF_SaveToFile  (HPDF_Doc     pdf,
 }
 
 
+/*
+ *  Incremental saving: the header is written up front, every finished page
+ *  is written and released with HPDF_FlushPage, and the shared objects,
+ *  page tree, xref table and trailer follow in HPDF_EndStreamingSave.
+ *  Encryption and PDF/A need the whole document and are not supported.
+ */
+
+HPDF_EXPORT(HPDF_STATUS)
+HPDF_BeginStreamingSave  (HPDF_Doc     pdf,
+                          const char  *file_name)
+{
+    HPDF_PTRACE ((" HPDF_BeginStreamingSave\n"));
+
+    if (!HPDF_HasDoc (pdf))
+        return HPDF_INVALID_DOCUMENT;
+
+    if (pdf->output || pdf->streamed || pdf->encrypt_on ||
+            pdf->pdfa_type != HPDF_PDFA_NON_PDFA)
+        return HPDF_RaiseError (&pdf->error, HPDF_INVALID_OPERATION, 0);
+
+    pdf->output = HPDF_FileWriter_New (pdf->mmgr, file_name);
+    if (!pdf->output)
+        return HPDF_CheckError (&pdf->error);
+
+    pdf->output->deflate_level = pdf->compression_level;
+    pdf->output->deflate_strategy = pdf->compression_strategy;
+    pdf->streamed = HPDF_TRUE;
+
+    if (WriteHeader (pdf, pdf->output) != HPDF_OK)
+        return HPDF_CheckError (&pdf->error);
+
+    return HPDF_OK;
+}
+
+
+HPDF_EXPORT(HPDF_STATUS)
+HPDF_FlushPage  (HPDF_Doc    pdf,
+                 HPDF_Page   page)
+{
+    HPDF_PTRACE ((" HPDF_FlushPage\n"));
+
+    if (!HPDF_HasDoc (pdf))
+        return HPDF_INVALID_DOCUMENT;
+
+    if (!pdf->output)
+        return HPDF_RaiseError (&pdf->error, HPDF_INVALID_OPERATION, 0);
+
+    if (!HPDF_Page_Validate (page))
+        return HPDF_RaiseError (&pdf->error, HPDF_INVALID_PAGE, 0);
+
+    if (HPDF_Page_Flush (page, pdf->output) != HPDF_OK)
+        return HPDF_CheckError (&pdf->error);
+
+    return HPDF_OK;
+}
+
+
+HPDF_EXPORT(HPDF_STATUS)
+HPDF_EndStreamingSave  (HPDF_Doc   pdf)
+{
+    HPDF_PTRACE ((" HPDF_EndStreamingSave\n"));
+
+    if (!HPDF_HasDoc (pdf))
+        return HPDF_INVALID_DOCUMENT;
+
+    if (!pdf->output)
+        return HPDF_RaiseError (&pdf->error, HPDF_INVALID_OPERATION, 0);
+
+    if (PrepareTrailer (pdf) == HPDF_OK)
+        HPDF_Xref_WriteToStream (pdf->xref, pdf->output, NULL);
+
+    pdf->deflate_in = pdf->output->deflate_in;
+    pdf->deflate_out = pdf->output->deflate_out;
+
+    HPDF_Stream_Free (pdf->output);
+    pdf->output = NULL;
+
+    return HPDF_CheckError (&pdf->error);
+}
+
+
 HPDF_EXPORT(HPDF_Page)
 HPDF_GetCurrentPage  (HPDF_Doc   pdf)
 {
@@ -1282,6 +1396,79 @@ FreeEncoderList  (HPDF_Doc  pdf)
 /*----- font handling -------------------------------------------------------*/
 
 
+static HPDF_UINT32
+FontKeyHash  (const char  *font_name,
+              const char  *encoding_name)
+{
+    HPDF_UINT32 hash = 2166136261u;
+
+    while (*font_name)
+        hash = (hash ^ (HPDF_BYTE)*font_name++) * 16777619u;
+
+    hash = (hash ^ 0xFF) * 16777619u;
+
+    while (*encoding_name)
+        hash = (hash ^ (HPDF_BYTE)*encoding_name++) * 16777619u;
+
+    return hash;
+}
+
+
+static void
+IndexFont  (HPDF_Font  *index,
+            HPDF_UINT   size,
+            HPDF_Font   font)
+{
+    HPDF_FontAttr attr = (HPDF_FontAttr)font->attr;
+    HPDF_UINT i = FontKeyHash (attr->fontdef->base_font, attr->encoder->name) &
+            (size - 1);
+
+    while (index[i])
+        i = (i + 1) & (size - 1);
+
+    index[i] = font;
+}
+
+
+/* add a new font to font_mgr, keeping the index at most half full */
+static HPDF_STATUS
+RegisterFont  (HPDF_Doc   pdf,
+               HPDF_Font  font)
+{
+    HPDF_STATUS ret;
+
+    /* the index grows first: when that fails the font is not in the list
+     * either, and the next HPDF_GetFont does not create it twice */
+    if ((pdf->font_mgr->count + 1) * 2 > pdf->font_index_size) {
+        HPDF_UINT size = pdf->font_index_size ? pdf->font_index_size * 2 : 64;
+        HPDF_Font *index;
+        HPDF_UINT i;
+
+        index = HPDF_GetMem (pdf->mmgr, sizeof(HPDF_Font) * size);
+        if (!index)
+            return HPDF_Error_GetCode (&pdf->error);
+
+        HPDF_MemSet (index, 0, sizeof(HPDF_Font) * size);
+
+        for (i = 0; i < pdf->font_mgr->count; i++)
+            IndexFont (index, size, (HPDF_Font)HPDF_List_ItemAt (pdf->font_mgr, i));
+
+        if (pdf->font_index)
+            HPDF_FreeMem (pdf->mmgr, pdf->font_index);
+
+        pdf->font_index = index;
+        pdf->font_index_size = size;
+    }
+
+    if ((ret = HPDF_List_Add (pdf->font_mgr, font)) != HPDF_OK)
+        return ret;
+
+    IndexFont (pdf->font_index, pdf->font_index_size, font);
+
+    return HPDF_OK;
+}
+
+
 HPDF_Font
 HPDF_Doc_FindFont  (HPDF_Doc          pdf,
                     const char  *font_name,
@@ -1292,15 +1479,19 @@ HPDF_Doc_FindFont  (HPDF_Doc          pdf,
 
     HPDF_PTRACE ((" HPDF_Doc_FindFont\n"));
 
-    for (i = 0; i < pdf->font_mgr->count; i++) {
-        HPDF_FontAttr attr;
+    if (!pdf->font_index)
+        return NULL;
 
-        font = (HPDF_Font)HPDF_List_ItemAt (pdf->font_mgr, i);
-        attr = (HPDF_FontAttr) font->attr;
+    i = FontKeyHash (font_name, encoding_name) & (pdf->font_index_size - 1);
+
+    while ((font = pdf->font_index[i]) != NULL) {
+        HPDF_FontAttr attr = (HPDF_FontAttr) font->attr;
 
         if (HPDF_StrCmp (attr->fontdef->base_font, font_name) == 0 &&
                 HPDF_StrCmp (attr->encoder->name, encoding_name) == 0)
             return font;
+
+        i = (i + 1) & (pdf->font_index_size - 1);
     }
 
     return NULL;
@@ -1378,8 +1569,8 @@ HPDF_GetFont  (HPDF_Doc          pdf,
         case HPDF_FONTDEF_TYPE_TYPE1:
             font = HPDF_Type1Font_New (pdf->mmgr, fontdef, encoder, pdf->xref);
 
-            if (font)
-                HPDF_List_Add (pdf->font_mgr, font);
+            if (font && RegisterFont (pdf, font) != HPDF_OK)
+                font = NULL;
 
             break;
         case HPDF_FONTDEF_TYPE_TRUETYPE:
@@ -1389,15 +1580,15 @@ HPDF_GetFont  (HPDF_Doc          pdf,
             else
                 font = HPDF_TTFont_New (pdf->mmgr, fontdef, encoder, pdf->xref);
 
-            if (font)
-                HPDF_List_Add (pdf->font_mgr, font);
+            if (font && RegisterFont (pdf, font) != HPDF_OK)
+                font = NULL;
 
             break;
         case HPDF_FONTDEF_TYPE_CID:
             font = HPDF_Type0Font_New (pdf->mmgr, fontdef, encoder, pdf->xref);
 
-            if (font)
-                HPDF_List_Add (pdf->font_mgr, font);
+            if (font && RegisterFont (pdf, font) != HPDF_OK)
+                font = NULL;
 
             break;
         default:
@@ -1773,6 +1964,32 @@ HPDF_LoadRawImageFromMem  (HPDF_Doc           pdf,
 }
 
 
+HPDF_EXPORT(HPDF_Image)
+HPDF_LoadImageMaskFromMem  (HPDF_Doc           pdf,
+                            const HPDF_BYTE   *buf,
+                            HPDF_UINT          width,
+                            HPDF_UINT          height)
+{
+    HPDF_Image image;
+
+    HPDF_PTRACE ((" HPDF_LoadImageMaskFromMem\n"));
+
+    if (!HPDF_HasDoc (pdf))
+        return NULL;
+
+    image = HPDF_Image_LoadRawMaskFromMem (pdf->mmgr, buf, pdf->xref, width, height);
+
+    if (!image)
+        HPDF_CheckError (&pdf->error);
+
+    if (image && pdf->compression_mode & HPDF_COMP_IMAGE) {
+        image->filter = HPDF_STREAM_FILTER_FLATE_DECODE;
+    }
+
+    return image;
+}
+
+
 HPDF_EXPORT(HPDF_Image)
 HPDF_LoadJpegImageFromFile  (HPDF_Doc     pdf,
                              const char  *filename)
@@ -2215,6 +2432,53 @@ HPDF_SetCompressionMode  (HPDF_Doc    pdf,
 }
 
 
+/*
+ *  HPDF_SetCompressionLevel
+ *
+ *  deflate level (HPDF_COMP_LEVEL_DEFAULT or 0 to 9) and strategy of the
+ *  streams compressed when the document is saved.
+ */
+
+HPDF_EXPORT(HPDF_STATUS)
+HPDF_SetCompressionLevel  (HPDF_Doc    pdf,
+                           HPDF_INT    level,
+                           HPDF_INT    strategy)
+{
+    if (!HPDF_Doc_Validate (pdf))
+        return HPDF_INVALID_DOCUMENT;
+
+    if (level < HPDF_COMP_LEVEL_DEFAULT || level > HPDF_COMP_LEVEL_BEST ||
+            strategy < HPDF_COMP_STRATEGY_DEFAULT ||
+            strategy > HPDF_COMP_STRATEGY_RLE)
+        return HPDF_RaiseError (&pdf->error, HPDF_INVALID_COMPRESSION_MODE, 0);
+
+    pdf->compression_level = level;
+    pdf->compression_strategy = strategy;
+
+    return HPDF_OK;
+}
+
+
+/* Streams deflated while the document was last saved: their total size
+ * before and after compression. Streams compressed ahead of the save with
+ * HPDF_Page_DeflateContents are not included. */
+HPDF_EXPORT(HPDF_STATUS)
+HPDF_GetDeflateTotals  (HPDF_Doc      pdf,
+                        HPDF_UINT64  *in_size,
+                        HPDF_UINT64  *out_size)
+{
+    if (!HPDF_Doc_Validate (pdf))
+        return HPDF_INVALID_DOCUMENT;
+
+    if (in_size)
+        *in_size = pdf->deflate_in;
+    if (out_size)
+        *out_size = pdf->deflate_out;
+
+    return HPDF_OK;
+}
+
+
 HPDF_EXPORT(HPDF_STATUS)
 HPDF_GetError  (HPDF_Doc   pdf)
 {
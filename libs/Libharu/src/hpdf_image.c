@@ -394,6 +394,53 @@ HPDF_Image_LoadRawImageFromMem  (HPDF_MMgr          mmgr,
 }
 
 
+/*
+ *  HPDF_Image_LoadRawMaskFromMem
+ *
+ *  Stencil mask of 1 bit per sample, each row padded to a whole byte and
+ *  the top row first. Samples of 0 are painted with the current fill color,
+ *  samples of 1 leave the page untouched.
+ */
+
+HPDF_Image
+HPDF_Image_LoadRawMaskFromMem  (HPDF_MMgr          mmgr,
+                                const HPDF_BYTE   *buf,
+                                HPDF_Xref          xref,
+                                HPDF_UINT          width,
+                                HPDF_UINT          height)
+{
+    HPDF_Dict image;
+    HPDF_STATUS ret = HPDF_OK;
+
+    HPDF_PTRACE ((" HPDF_Image_LoadRawMaskFromMem\n"));
+
+    if (width == 0 || height == 0) {
+        HPDF_SetError (mmgr->error, HPDF_INVALID_IMAGE, 0);
+        return NULL;
+    }
+
+    image = HPDF_DictStream_New (mmgr, xref);
+    if (!image)
+        return NULL;
+
+    image->header.obj_class |= HPDF_OSUBCLASS_XOBJECT;
+    ret += HPDF_Dict_AddName (image, "Type", "XObject");
+    ret += HPDF_Dict_AddName (image, "Subtype", "Image");
+    ret += HPDF_Dict_AddBoolean (image, "ImageMask", HPDF_TRUE);
+    ret += HPDF_Dict_AddNumber (image, "Width", width);
+    ret += HPDF_Dict_AddNumber (image, "Height", height);
+    ret += HPDF_Dict_AddNumber (image, "BitsPerComponent", 1);
+    if (ret != HPDF_OK)
+        return NULL;
+
+    if (HPDF_Stream_Write (image->stream, buf, (width + 7) / 8 * height)
+            != HPDF_OK)
+        return NULL;
+
+    return image;
+}
+
+
 HPDF_BOOL
 HPDF_Image_Validate (HPDF_Image  image)
 {
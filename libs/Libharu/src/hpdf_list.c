@@ -79,9 +79,12 @@ HPDF_List_Add  (HPDF_List  list,
 {
     HPDF_PTRACE((" HPDF_List_Add\n"));
 
+    /* grow geometrically so that appending stays linear for long lists
+     * such as the xref entries, page list and Kids arrays */
     if (list->count >= list->block_siz) {
-        HPDF_STATUS ret = Resize (list,
-                list->block_siz + list->items_per_block);
+        HPDF_UINT grow = (list->block_siz > list->items_per_block) ?
+                list->block_siz : list->items_per_block;
+        HPDF_STATUS ret = Resize (list, list->block_siz + grow);
 
         if (ret != HPDF_OK) {
             return ret;
@@ -115,6 +115,7 @@ HPDF_MMgr_New  (HPDF_Error       error,
 
         if (mmgr) {
             mmgr->buf_size = buf_size;
+            HPDF_MemSet (mmgr->free_list, 0, sizeof(mmgr->free_list));
         }
     } else
         HPDF_SetError(error, HPDF_FAILED_TO_ALLOC_MEM, HPDF_NOERROR);
@@ -160,6 +161,80 @@ HPDF_MMgr_Free  (HPDF_MMgr  mmgr)
     mmgr->free_fn (mmgr);
 }
 
+/*
+ *  size class of a block of size bytes and the usable size of that class,
+ *  or HPDF_MPOOL_LARGE for blocks that are allocated on their own.
+ */
+static HPDF_UINT
+SizeClass  (HPDF_UINT   size,
+            HPDF_UINT  *class_size)
+{
+    HPDF_UINT cls;
+    HPDF_UINT siz;
+
+    if (size <= HPDF_MPOOL_SMALL_MAX) {
+        cls = (size + HPDF_MPOOL_SMALL_STEP - 1) / HPDF_MPOOL_SMALL_STEP;
+        if (cls == 0)
+            cls = 1;
+        *class_size = cls * HPDF_MPOOL_SMALL_STEP;
+        return cls - 1;
+    }
+
+    if (size > HPDF_MPOOL_MAX_BLOCK)
+        return HPDF_MPOOL_LARGE;
+
+    cls = HPDF_MPOOL_SMALL_MAX / HPDF_MPOOL_SMALL_STEP;
+    siz = HPDF_MPOOL_MEDIUM_MIN;
+    while (siz < size) {
+        siz <<= 1;
+        cls++;
+    }
+
+    *class_size = siz;
+    return cls;
+}
+
+
+/* cut size bytes from the current chunk, starting a new one when full */
+static void*
+PoolAlloc  (HPDF_MMgr  mmgr,
+            HPDF_UINT  size)
+{
+    HPDF_MPool_Node node = mmgr->mpool;
+    HPDF_UINT tmp_buf_siz;
+    void *ptr;
+
+    if (node->size - node->used_size >= size) {
+        ptr = node->buf + node->used_size;
+        node->used_size += size;
+        return ptr;
+    }
+
+    tmp_buf_siz = (mmgr->buf_size < size) ? size : mmgr->buf_size;
+
+    node = (HPDF_MPool_Node)mmgr->alloc_fn (sizeof(HPDF_MPool_Node_Rec)
+            + tmp_buf_siz);
+    HPDF_PTRACE(("+%p mmgr-new-node\n", node));
+
+    if (!node) {
+        HPDF_SetError (mmgr->error, HPDF_FAILED_TO_ALLOC_MEM, HPDF_NOERROR);
+        return NULL;
+    }
+
+#ifdef HPDF_MEM_DEBUG
+    mmgr->alloc_cnt++;
+#endif
+
+    node->size = tmp_buf_siz;
+    node->next_node = mmgr->mpool;
+    mmgr->mpool = node;
+    node->used_size = size;
+    node->buf = (HPDF_BYTE*)node + sizeof(HPDF_MPool_Node_Rec);
+
+    return node->buf;
+}
+
+
 void*
 HPDF_GetMem  (HPDF_MMgr  mmgr,
               HPDF_UINT  size)
@@ -167,47 +242,44 @@ HPDF_GetMem  (HPDF_MMgr  mmgr,
     void * ptr;
 
     if (mmgr->mpool) {
-        HPDF_MPool_Node node = mmgr->mpool;
+        HPDF_MPool_Block block;
+        HPDF_UINT class_size;
+        HPDF_UINT cls = SizeClass (size, &class_size);
 
-#ifdef HPDF_ALINMENT_SIZ
-        size = (size + (HPDF_ALINMENT_SIZ - 1)) / HPDF_ALINMENT_SIZ;
-        size *= HPDF_ALINMENT_SIZ;
-#endif
+        if (cls == HPDF_MPOOL_LARGE) {
+            block = (HPDF_MPool_Block)mmgr->alloc_fn (
+                    sizeof(HPDF_MPool_Block_Rec) + size);
+            HPDF_PTRACE(("+%p mmgr-alloc_fn size=%u\n", block, size));
 
-        if (node->size - node->used_size >= size) {
-            ptr = (HPDF_BYTE*)node->buf + node->used_size;
-            node->used_size += size;
-            return ptr;
-        } else {
-            HPDF_UINT tmp_buf_siz = (mmgr->buf_size < size) ?  size :
-                mmgr->buf_size;
-
-            node = (HPDF_MPool_Node)mmgr->alloc_fn (sizeof(HPDF_MPool_Node_Rec)
-                    + tmp_buf_siz);
-            HPDF_PTRACE(("+%p mmgr-new-node\n", node));
-
-            if (!node) {
+            if (!block) {
                 HPDF_SetError (mmgr->error, HPDF_FAILED_TO_ALLOC_MEM,
                         HPDF_NOERROR);
                 return NULL;
             }
 
-            node->size = tmp_buf_siz;
+#ifdef HPDF_MEM_DEBUG
+            mmgr->alloc_cnt++;
+#endif
+        } else if (mmgr->free_list[cls]) {
+            block = mmgr->free_list[cls];
+            mmgr->free_list[cls] = block->next;
+        } else {
+            block = (HPDF_MPool_Block)PoolAlloc (mmgr,
+                    sizeof(HPDF_MPool_Block_Rec) + class_size);
+            if (!block)
+                return NULL;
         }
 
-        node->next_node = mmgr->mpool;
-        mmgr->mpool = node;
-        node->used_size = size;
-        node->buf = (HPDF_BYTE*)node + sizeof(HPDF_MPool_Node_Rec);
-        ptr = node->buf;
-    } else {
-        ptr = mmgr->alloc_fn (size);
-        HPDF_PTRACE(("+%p mmgr-alloc_fn size=%u\n", ptr, size));
-
-        if (ptr == NULL)
-            HPDF_SetError (mmgr->error, HPDF_FAILED_TO_ALLOC_MEM, HPDF_NOERROR);
+        block->size_class = cls;
+        return block + 1;
     }
 
+    ptr = mmgr->alloc_fn (size);
+    HPDF_PTRACE(("+%p mmgr-alloc_fn size=%u\n", ptr, size));
+
+    if (ptr == NULL)
+        HPDF_SetError (mmgr->error, HPDF_FAILED_TO_ALLOC_MEM, HPDF_NOERROR);
+
 #ifdef HPDF_MEM_DEBUG
     if (ptr)
         mmgr->alloc_cnt++;
@@ -223,14 +295,27 @@ HPDF_FreeMem  (HPDF_MMgr  mmgr,
     if (!aptr)
         return;
 
-    if (!mmgr->mpool) {
-        HPDF_PTRACE(("-%p mmgr-free-mem\n", aptr));
-        mmgr->free_fn(aptr);
+    if (mmgr->mpool) {
+        HPDF_MPool_Block block = (HPDF_MPool_Block)aptr - 1;
+        HPDF_UINT cls = block->size_class;
+
+        if (cls != HPDF_MPOOL_LARGE) {
+            /* back to the free list of its class, reused by later objects
+             * such as the next page once a streamed page is released */
+            block->next = mmgr->free_list[cls];
+            mmgr->free_list[cls] = block;
+            return;
+        }
+
+        aptr = block;
+    }
+
+    HPDF_PTRACE(("-%p mmgr-free-mem\n", aptr));
+    mmgr->free_fn(aptr);
 
 #ifdef HPDF_MEM_DEBUG
-        mmgr->free_cnt++;
+    mmgr->free_cnt++;
 #endif
-    }
 
     return;
 }
@@ -77,6 +77,9 @@ AddAnnotation  (HPDF_Page        page,
 static HPDF_UINT
 GetPageCount  (HPDF_Dict    pages);
 
+static HPDF_Dict
+GetResources  (HPDF_Page  page);
+
 static const char * const HPDF_INHERITABLE_ENTRIES[5] = {
                         "Resources",
                         "MediaBox",
@@ -366,6 +369,124 @@ HPDF_GetPageMMgr  (HPDF_Page page)
 }
 
 
+/*
+ *  HPDF_Page_Flush
+ *
+ *  Write a finished page and its content streams to the output stream and
+ *  release everything but the xref offsets and the empty page dictionary,
+ *  which the page tree (and any destination) still refers to. No drawing
+ *  operator is accepted on the page afterwards.
+ *
+ *  The page's own content stream and its length are freed. The XObjects
+ *  and shared content streams it uses are complete once drawn, so they are
+ *  written and emptied as well; later pages may still refer to them.
+ */
+
+static HPDF_STATUS
+FlushContents  (HPDF_Xref    xref,
+                HPDF_Dict    contents,
+                HPDF_Stream  stream,
+                HPDF_BOOL    release)
+{
+    HPDF_Number length;
+    HPDF_STATUS ret;
+
+    length = (HPDF_Number)HPDF_Dict_GetItem (contents, "Length",
+                    HPDF_OCLASS_NUMBER);
+
+    if ((ret = HPDF_Xref_FlushObject (xref, contents, stream, NULL)) != HPDF_OK)
+        return ret;
+
+    /* the length object is filled in while the stream is written */
+    if (length && (ret = HPDF_Xref_FlushObject (xref, length, stream, NULL))
+            != HPDF_OK)
+        return ret;
+
+    if (!release) {
+        HPDF_Dict_Clear (contents);
+        return HPDF_OK;
+    }
+
+    if ((ret = HPDF_Xref_ReleaseObject (xref, contents)) != HPDF_OK)
+        return ret;
+
+    if (length)
+        return HPDF_Xref_ReleaseObject (xref, length);
+
+    return HPDF_OK;
+}
+
+
+HPDF_STATUS
+HPDF_Page_Flush  (HPDF_Page     page,
+                  HPDF_Stream   stream)
+{
+    HPDF_PageAttr attr;
+    HPDF_Array array;
+    HPDF_STATUS ret;
+    HPDF_UINT i;
+
+    HPDF_PTRACE((" HPDF_Page_Flush\n"));
+
+    if (!HPDF_Page_Validate (page))
+        return HPDF_INVALID_PAGE;
+
+    attr = (HPDF_PageAttr)page->attr;
+
+    if ((ret = HPDF_Xref_FlushObject (attr->xref, page, stream, NULL)) != HPDF_OK)
+        return ret;
+
+    if (attr->xobjects) {
+        for (i = 0; i < attr->xobjects->list->count; i++) {
+            HPDF_DictElement element =
+                    (HPDF_DictElement)HPDF_List_ItemAt (attr->xobjects->list, i);
+            HPDF_Dict xobject = (HPDF_Dict)element->value;
+
+            if (xobject->header.obj_class == HPDF_OCLASS_PROXY)
+                xobject = (HPDF_Dict)((HPDF_Proxy)xobject)->obj;
+
+            if (xobject != attr->form && (ret = FlushContents (attr->xref,
+                    xobject, stream, HPDF_FALSE)) != HPDF_OK)
+                return ret;
+        }
+    }
+
+    /* The page's own content stream is freed here: the page dictionary
+     * still points to it, but only to be cleared below, which frees the
+     * references without following them */
+    array = (HPDF_Array)HPDF_Dict_GetItem (page, "Contents", HPDF_OCLASS_ARRAY);
+    if (array) {
+        /* the first stream is the page's own, the others may be shared */
+        for (i = 0; i < array->list->count; i++) {
+            HPDF_Dict contents = (HPDF_Dict)HPDF_Array_GetItem (array, i,
+                    HPDF_OCLASS_DICT);
+
+            if (contents && (ret = FlushContents (attr->xref, contents,
+                    stream, i == 0)) != HPDF_OK)
+                return ret;
+        }
+    } else if (attr->contents) {
+        /* a single content stream, not an array */
+        HPDF_Error_Reset (page->error);
+
+        if ((ret = FlushContents (attr->xref, attr->contents, stream,
+                HPDF_TRUE)) != HPDF_OK)
+            return ret;
+    }
+
+    HPDF_Dict_Clear (page);
+
+    if (attr->gstate)
+        HPDF_GState_Free (page->mmgr, attr->gstate);
+
+    /* HPDF_Page_Validate fails from now on */
+    HPDF_FreeMem (page->mmgr, attr);
+    page->attr = NULL;
+
+    return HPDF_OK;
+}
+
+
 static void
 Page_OnFree  (HPDF_Dict  obj)
 {
@@ -392,7 +513,8 @@ HPDF_Page_CheckState  (HPDF_Page  page,
     if (page->header.obj_class != (HPDF_OSUBCLASS_PAGE | HPDF_OCLASS_DICT))
         return HPDF_INVALID_PAGE;
 
-    if (!(((HPDF_PageAttr)page->attr)->gmode & mode))
+    /* a page written by HPDF_Page_Flush accepts no operator */
+    if (!page->attr || !(((HPDF_PageAttr)page->attr)->gmode & mode))
         return HPDF_RaiseError (page->error, HPDF_PAGE_INVALID_GMODE, 0);
 
     return HPDF_OK;
@@ -502,8 +624,7 @@ HPDF_Page_GetLocalFontName  (HPDF_Page  page,
         HPDF_Dict resources;
         HPDF_Dict fonts;
 
-        resources = HPDF_Page_GetInheritableItem (page, "Resources",
-                        HPDF_OCLASS_DICT);
+        resources = GetResources (page);
         if (!resources)
             return NULL;
 
@@ -822,6 +943,294 @@ HPDF_Page_CreateXObjectAsWhiteRect  (HPDF_Doc   pdf,
     return fromxobject;
 }
 
+/*
+ *  HPDF_Page_BeginFormXObject
+ *
+ *  Redirect the drawing operators of a page into a new Form XObject with
+ *  its own resources until HPDF_Page_EndFormXObject. The form can then be
+ *  painted on any page of the document with HPDF_Page_ExecuteXObject.
+ */
+
+HPDF_EXPORT(HPDF_XObject)
+HPDF_Page_BeginFormXObject  (HPDF_Doc   pdf,
+                             HPDF_Page  page,
+                             HPDF_Rect  bbox)
+{
+    HPDF_PageAttr attr;
+    HPDF_Dict form;
+    HPDF_Dict resource;
+    HPDF_Array procset;
+    HPDF_Array array;
+    HPDF_GState gstate;
+    HPDF_STATUS ret = HPDF_OK;
+
+    HPDF_PTRACE((" HPDF_Page_BeginFormXObject\n"));
+
+    if (!HPDF_Page_Validate (page))
+        return NULL;
+
+    attr = (HPDF_PageAttr)page->attr;
+    if (attr->form || attr->gmode != HPDF_GMODE_PAGE_DESCRIPTION) {
+        HPDF_RaiseError (page->error, HPDF_PAGE_INVALID_GMODE, 0);
+        return NULL;
+    }
+
+    form = HPDF_DictStream_New (pdf->mmgr, pdf->xref);
+    if (!form)
+        return NULL;
+
+    form->header.obj_class |= HPDF_OSUBCLASS_XOBJECT;
+    form->filter = attr->contents->filter;
+
+    resource = HPDF_Dict_New (page->mmgr);
+    if (!resource)
+        return NULL;
+
+    ret += HPDF_Dict_Add (form, "Resources", resource);
+
+    procset = HPDF_Array_New (page->mmgr);
+    if (!procset)
+        return NULL;
+
+    ret += HPDF_Dict_Add (resource, "ProcSet", procset);
+    ret += HPDF_Array_Add (procset, HPDF_Name_New (page->mmgr, "PDF"));
+    ret += HPDF_Array_Add (procset, HPDF_Name_New (page->mmgr, "Text"));
+
+    array = HPDF_Array_New (page->mmgr);
+    if (!array)
+        return NULL;
+
+    ret += HPDF_Dict_Add (form, "BBox", array);
+    ret += HPDF_Array_AddReal (array, bbox.left);
+    ret += HPDF_Array_AddReal (array, bbox.bottom);
+    ret += HPDF_Array_AddReal (array, bbox.right);
+    ret += HPDF_Array_AddReal (array, bbox.top);
+
+    array = HPDF_Array_New (page->mmgr);
+    if (!array)
+        return NULL;
+
+    ret += HPDF_Dict_Add (form, "Matrix", array);
+    ret += HPDF_Array_AddReal (array, 1.0);
+    ret += HPDF_Array_AddReal (array, 0.0);
+    ret += HPDF_Array_AddReal (array, 0.0);
+    ret += HPDF_Array_AddReal (array, 1.0);
+    ret += HPDF_Array_AddReal (array, 0.0);
+    ret += HPDF_Array_AddReal (array, 0.0);
+
+    ret += HPDF_Dict_AddNumber (form, "FormType", 1);
+    ret += HPDF_Dict_AddName (form, "Subtype", "Form");
+    ret += HPDF_Dict_AddName (form, "Type", "XObject");
+
+    if (ret != HPDF_OK)
+        return NULL;
+
+    /* the form starts from the current graphics state, as "Do" runs it
+     * between an implicit "q" and "Q" */
+    gstate = HPDF_GState_New (page->mmgr, attr->gstate);
+    if (!gstate)
+        return NULL;
+
+    attr->gstate = gstate;
+    attr->form = form;
+    attr->form_depth = gstate->depth;
+    attr->page_stream = attr->stream;
+    attr->page_fonts = attr->fonts;
+    attr->page_xobjects = attr->xobjects;
+    attr->page_ext_gstates = attr->ext_gstates;
+    attr->page_shadings = attr->shadings;
+
+    attr->stream = form->stream;
+    attr->fonts = NULL;
+    attr->xobjects = NULL;
+    attr->ext_gstates = NULL;
+    attr->shadings = NULL;
+
+    return form;
+}
+
+
+HPDF_EXPORT(HPDF_STATUS)
+HPDF_Page_EndFormXObject  (HPDF_Page  page)
+{
+    HPDF_PageAttr attr;
+    HPDF_STATUS ret;
+
+    HPDF_PTRACE((" HPDF_Page_EndFormXObject\n"));
+
+    if (!HPDF_Page_Validate (page))
+        return HPDF_INVALID_PAGE;
+
+    attr = (HPDF_PageAttr)page->attr;
+    if (!attr->form)
+        return HPDF_RaiseError (page->error, HPDF_PAGE_INVALID_GMODE, 0);
+
+    if (attr->gmode == HPDF_GMODE_PATH_OBJECT &&
+            (ret = HPDF_Page_EndPath (page)) != HPDF_OK)
+        return ret;
+
+    if (attr->gmode == HPDF_GMODE_TEXT_OBJECT &&
+            (ret = HPDF_Page_EndText (page)) != HPDF_OK)
+        return ret;
+
+    while (attr->gstate->depth > attr->form_depth)
+        if ((ret = HPDF_Page_GRestore (page)) != HPDF_OK)
+            return ret;
+
+    attr->gstate = HPDF_GState_Free (page->mmgr, attr->gstate);
+
+    attr->stream = attr->page_stream;
+    attr->fonts = attr->page_fonts;
+    attr->xobjects = attr->page_xobjects;
+    attr->ext_gstates = attr->page_ext_gstates;
+    attr->shadings = attr->page_shadings;
+    attr->form = NULL;
+
+    return HPDF_OK;
+}
+
+
+/*
+ *  Compression ahead of saving
+ *
+ *  The content stream of a finished page can be deflated before the
+ *  document is saved, e.g. by worker threads while later pages are drawn.
+ *  HPDF_Page_GetDeflateBound returns the size of the buffer needed, or 0
+ *  when there is nothing to compress. HPDF_Page_DeflateContents only reads
+ *  the stream and may run on any thread; HPDF_Page_SetDeflatedContents
+ *  stores the result on the thread owning the document. No drawing
+ *  operator is accepted on the page afterwards.
+ */
+
+static HPDF_BOOL
+CanDeflateContents  (HPDF_PageAttr  attr)
+{
+    return (attr->contents && attr->stream && !attr->form &&
+            !attr->contents->encoded &&
+            (attr->contents->filter & HPDF_STREAM_FILTER_FLATE_DECODE) &&
+            attr->stream->type == HPDF_STREAM_MEMORY &&
+            attr->gmode == HPDF_GMODE_PAGE_DESCRIPTION &&
+            (!attr->gstate || !attr->gstate->prev));
+}
+
+
+HPDF_EXPORT(HPDF_UINT)
+HPDF_Page_GetDeflateBound  (HPDF_Page  page)
+{
+    HPDF_PageAttr attr;
+
+    if (!HPDF_Page_Validate (page))
+        return 0;
+
+    attr = (HPDF_PageAttr)page->attr;
+    if (!CanDeflateContents (attr) || attr->stream->size == 0)
+        return 0;
+
+    return HPDF_MemStream_DeflateBound (attr->stream);
+}
+
+
+HPDF_EXPORT(HPDF_STATUS)
+HPDF_Page_DeflateContents  (HPDF_Page   page,
+                            HPDF_INT    level,
+                            HPDF_INT    strategy,
+                            HPDF_BYTE  *buf,
+                            HPDF_UINT  *len)
+{
+    HPDF_PageAttr attr;
+
+    if (!HPDF_Page_Validate (page))
+        return HPDF_INVALID_PAGE;
+
+    attr = (HPDF_PageAttr)page->attr;
+    if (!buf || !len || !CanDeflateContents (attr))
+        return HPDF_INVALID_PARAMETER;
+
+    return HPDF_MemStream_Deflate (attr->stream, level, strategy, buf, len);
+}
+
+
+HPDF_EXPORT(HPDF_STATUS)
+HPDF_Page_SetDeflatedContents  (HPDF_Page         page,
+                                const HPDF_BYTE  *buf,
+                                HPDF_UINT         len)
+{
+    HPDF_PageAttr attr;
+    HPDF_STATUS ret;
+
+    HPDF_PTRACE((" HPDF_Page_SetDeflatedContents\n"));
+
+    if (!HPDF_Page_Validate (page))
+        return HPDF_INVALID_PAGE;
+
+    attr = (HPDF_PageAttr)page->attr;
+    if (!buf || !CanDeflateContents (attr))
+        return HPDF_RaiseError (page->error, HPDF_INVALID_OPERATION, 0);
+
+    HPDF_MemStream_FreeData (attr->stream);
+    if ((ret = HPDF_Stream_Write (attr->stream, buf, len)) != HPDF_OK)
+        return HPDF_CheckError (page->error);
+
+    attr->contents->encoded = HPDF_TRUE;
+    attr->stream = NULL;
+    attr->gmode = 0;
+
+    return HPDF_OK;
+}
+
+
+/*
+ *  Size of the page's content stream and the number of operators in it,
+ *  0 once the stream has been written out or compressed. Every operator
+ *  Libharu writes ends its line, and text is written escaped, so counting
+ *  operators is counting newlines. Both only read the stream.
+ */
+
+HPDF_EXPORT(HPDF_UINT)
+HPDF_Page_GetContentsSize  (HPDF_Page  page)
+{
+    HPDF_PageAttr attr;
+
+    if (!HPDF_Page_Validate (page))
+        return 0;
+
+    attr = (HPDF_PageAttr)page->attr;
+    if (!attr->stream || attr->form)
+        return 0;
+
+    return attr->stream->size;
+}
+
+
+HPDF_EXPORT(HPDF_UINT)
+HPDF_Page_GetOperatorCount  (HPDF_Page  page)
+{
+    HPDF_PageAttr attr;
+
+    if (!HPDF_Page_Validate (page))
+        return 0;
+
+    attr = (HPDF_PageAttr)page->attr;
+    if (!attr->stream || attr->form)
+        return 0;
+
+    return HPDF_MemStream_CountByte (attr->stream, 0x0A);
+}
+
+
+/* resources of the form being drawn, or of the page itself */
+static HPDF_Dict
+GetResources  (HPDF_Page  page)
+{
+    HPDF_PageAttr attr = (HPDF_PageAttr)page->attr;
+
+    if (attr->form)
+        return HPDF_Dict_GetItem (attr->form, "Resources", HPDF_OCLASS_DICT);
+
+    return HPDF_Page_GetInheritableItem (page, "Resources", HPDF_OCLASS_DICT);
+}
+
+
 const char*
 HPDF_Page_GetXObjectName  (HPDF_Page     page,
                            HPDF_XObject  xobj)
@@ -835,8 +1244,7 @@ HPDF_Page_GetXObjectName  (HPDF_Page     page,
         HPDF_Dict resources;
         HPDF_Dict xobjects;
 
-        resources = HPDF_Page_GetInheritableItem (page, "Resources",
-                        HPDF_OCLASS_DICT);
+        resources = GetResources (page);
         if (!resources)
             return NULL;
 
@@ -886,8 +1294,7 @@ HPDF_Page_GetExtGStateName  (HPDF_Page       page,
         HPDF_Dict resources;
         HPDF_Dict ext_gstates;
 
-        resources = HPDF_Page_GetInheritableItem (page, "Resources",
-                        HPDF_OCLASS_DICT);
+        resources = GetResources (page);
         if (!resources)
             return NULL;
 
@@ -936,8 +1343,7 @@ HPDF_Page_GetShadingName  (HPDF_Page    page,
         HPDF_Dict resources;
         HPDF_Dict shadings;
 
-        resources = HPDF_Page_GetInheritableItem (page, "Resources",
-                                                  HPDF_OCLASS_DICT);
+        resources = GetResources (page);
         if (!resources)
             return NULL;
 
@@ -33,6 +33,9 @@
 #ifdef LIBHPDF_HAVE_ZLIB
 #include <zlib.h>
 #include <zconf.h>
+
+/* the memory level deflateInit uses */
+#define HPDF_DEFLATE_MEM_LEVEL  8
 #endif /* LIBHPDF_HAVE_ZLIB */
 
 HPDF_STATUS
@@ -586,8 +589,9 @@ HPDF_Stream_WriteToStreamWithDeflate  (HPDF_Stream  src,
     strm.next_out = otbuf;
     strm.avail_out = DEFLATE_BUF_SIZ;
 
-    ret = deflateInit_(&strm, Z_DEFAULT_COMPRESSION, ZLIB_VERSION,
-            sizeof(z_stream));
+    ret = deflateInit2_(&strm, dst->deflate_level, Z_DEFLATED, MAX_WBITS,
+            HPDF_DEFLATE_MEM_LEVEL, dst->deflate_strategy,
+            ZLIB_VERSION, sizeof(z_stream));
     if (ret != Z_OK)
         return HPDF_SetError (src->error, HPDF_ZLIB_ERROR, ret);
 
@@ -674,6 +678,9 @@ HPDF_Stream_WriteToStreamWithDeflate  (HPDF_Stream  src,
             break;
     }
 
+    dst->deflate_in += strm.total_in;
+    dst->deflate_out += strm.total_out;
+
     deflateEnd(&strm);
     return HPDF_OK;
 #else /* LIBHPDF_HAVE_ZLIB */
@@ -684,6 +691,125 @@ HPDF_Stream_WriteToStreamWithDeflate  (HPDF_Stream  src,
 #endif /* LIBHPDF_HAVE_ZLIB */
 }
 
+/*
+ *  HPDF_MemStream_Deflate
+ *
+ *  Compress the whole of a memory stream into buf, which holds *len bytes
+ *  and should be HPDF_MemStream_DeflateBound long. Only the buffers of the
+ *  stream are read and no error is set on failure, so a finished stream
+ *  can be compressed on another thread while its document is in use.
+ */
+
+HPDF_UINT
+HPDF_MemStream_DeflateBound  (HPDF_Stream  stream)
+{
+#ifdef LIBHPDF_HAVE_ZLIB
+    return (HPDF_UINT)compressBound (stream->size);
+#else /* LIBHPDF_HAVE_ZLIB */
+    HPDF_UNUSED (stream);
+    return 0;
+#endif /* LIBHPDF_HAVE_ZLIB */
+}
+
+
+HPDF_STATUS
+HPDF_MemStream_Deflate  (HPDF_Stream  stream,
+                         HPDF_INT     level,
+                         HPDF_INT     strategy,
+                         HPDF_BYTE    *buf,
+                         HPDF_UINT    *len)
+{
+#ifdef LIBHPDF_HAVE_ZLIB
+    HPDF_MemStreamAttr attr;
+    z_stream strm;
+    HPDF_UINT i;
+    int ret;
+
+    HPDF_PTRACE((" HPDF_MemStream_Deflate\n"));
+
+    if (stream->type != HPDF_STREAM_MEMORY)
+        return HPDF_INVALID_STREAM;
+
+    attr = (HPDF_MemStreamAttr)stream->attr;
+
+    HPDF_MemSet(&strm, 0x00, sizeof(z_stream));
+    ret = deflateInit2_(&strm, level, Z_DEFLATED, MAX_WBITS,
+            HPDF_DEFLATE_MEM_LEVEL, strategy,
+            ZLIB_VERSION, sizeof(z_stream));
+    if (ret != Z_OK)
+        return HPDF_ZLIB_ERROR;
+
+    strm.next_out = buf;
+    strm.avail_out = *len;
+
+    for (i = 0; i < attr->buf->count; i++) {
+        strm.next_in = (Bytef *)HPDF_List_ItemAt (attr->buf, i);
+        strm.avail_in = (i == attr->buf->count - 1) ? attr->w_pos :
+                attr->buf_siz;
+
+        while (strm.avail_in > 0) {
+            ret = deflate(&strm, Z_NO_FLUSH);
+            if (ret != Z_OK || strm.avail_out == 0) {
+                deflateEnd(&strm);
+                return HPDF_ZLIB_ERROR;
+            }
+        }
+    }
+
+    ret = deflate(&strm, Z_FINISH);
+    deflateEnd(&strm);
+    if (ret != Z_STREAM_END)
+        return HPDF_ZLIB_ERROR;
+
+    *len = *len - strm.avail_out;
+    return HPDF_OK;
+#else /* LIBHPDF_HAVE_ZLIB */
+    HPDF_UNUSED (stream);
+    HPDF_UNUSED (level);
+    HPDF_UNUSED (strategy);
+    HPDF_UNUSED (buf);
+    HPDF_UNUSED (len);
+    return HPDF_UNSUPPORTED_FUNC;
+#endif /* LIBHPDF_HAVE_ZLIB */
+}
+
+
+/*
+ *  HPDF_MemStream_CountByte
+ *
+ *  Occurrences of c in the data of a memory stream. Like
+ *  HPDF_MemStream_Deflate it only reads the buffers.
+ */
+
+HPDF_UINT
+HPDF_MemStream_CountByte  (HPDF_Stream  stream,
+                           HPDF_BYTE    c)
+{
+    HPDF_MemStreamAttr attr;
+    HPDF_UINT count = 0;
+    HPDF_UINT i;
+
+    HPDF_PTRACE((" HPDF_MemStream_CountByte\n"));
+
+    if (stream->type != HPDF_STREAM_MEMORY)
+        return 0;
+
+    attr = (HPDF_MemStreamAttr)stream->attr;
+
+    for (i = 0; i < attr->buf->count; i++) {
+        const HPDF_BYTE *p = (const HPDF_BYTE *)HPDF_List_ItemAt (attr->buf, i);
+        const HPDF_BYTE *end = p + ((i == attr->buf->count - 1) ? attr->w_pos :
+                attr->buf_siz);
+
+        while (p < end)
+            if (*p++ == c)
+                count++;
+    }
+
+    return count;
+}
+
+
 HPDF_STATUS
 HPDF_Stream_WriteToStream  (HPDF_Stream  src,
                             HPDF_Stream  dst,
@@ -776,6 +902,8 @@ HPDF_FileReader_New  (HPDF_MMgr   mmgr,
     if (stream) {
         HPDF_MemSet(stream, 0, sizeof(HPDF_Stream_Rec));
         stream->sig_bytes = HPDF_STREAM_SIG_BYTES;
+        stream->deflate_level = HPDF_COMP_LEVEL_DEFAULT;
+        stream->deflate_strategy = HPDF_COMP_STRATEGY_DEFAULT;
         stream->type = HPDF_STREAM_FILE;
         stream->error = mmgr->error;
         stream->mmgr = mmgr;
@@ -952,6 +1080,8 @@ HPDF_FileWriter_New  (HPDF_MMgr        mmgr,
     if (stream) {
         HPDF_MemSet (stream, 0, sizeof(HPDF_Stream_Rec));
         stream->sig_bytes = HPDF_STREAM_SIG_BYTES;
+        stream->deflate_level = HPDF_COMP_LEVEL_DEFAULT;
+        stream->deflate_strategy = HPDF_COMP_STRATEGY_DEFAULT;
         stream->error = mmgr->error;
         stream->mmgr = mmgr;
         stream->write_fn = HPDF_FileWriter_WriteFunc;
@@ -1219,6 +1349,8 @@ HPDF_MemStream_New  (HPDF_MMgr  mmgr,
         }
 
         stream->sig_bytes = HPDF_STREAM_SIG_BYTES;
+        stream->deflate_level = HPDF_COMP_LEVEL_DEFAULT;
+        stream->deflate_strategy = HPDF_COMP_STRATEGY_DEFAULT;
         stream->type = HPDF_STREAM_MEMORY;
         stream->error = mmgr->error;
         stream->mmgr = mmgr;
@@ -1402,6 +1534,8 @@ HPDF_CallbackReader_New  (HPDF_MMgr              mmgr,
     if (stream) {
         HPDF_MemSet (stream, 0, sizeof(HPDF_Stream_Rec));
         stream->sig_bytes = HPDF_STREAM_SIG_BYTES;
+        stream->deflate_level = HPDF_COMP_LEVEL_DEFAULT;
+        stream->deflate_strategy = HPDF_COMP_STRATEGY_DEFAULT;
         stream->error = mmgr->error;
         stream->mmgr = mmgr;
         stream->read_fn = read_fn;
@@ -1444,6 +1578,8 @@ HPDF_CallbackWriter_New (HPDF_MMgr               mmgr,
     if (stream) {
         HPDF_MemSet (stream, 0, sizeof(HPDF_Stream_Rec));
         stream->sig_bytes = HPDF_STREAM_SIG_BYTES;
+        stream->deflate_level = HPDF_COMP_LEVEL_DEFAULT;
+        stream->deflate_strategy = HPDF_COMP_STRATEGY_DEFAULT;
         stream->error = mmgr->error;
         stream->mmgr = mmgr;
         stream->write_fn = write_fn;
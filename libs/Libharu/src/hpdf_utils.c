@@ -178,6 +178,18 @@ HPDF_IToA2  (char         *s,
 }
 
 
+/*
+ *  values up to 10^-n get at least n + 5 fractional digits in HPDF_FToA,
+ *  the same precision log10 gives but without calling it.
+ */
+static const double HPDF_NEG_POW10[] = {
+    1e-1, 1e-2, 1e-3, 1e-4, 1e-5, 1e-6, 1e-7, 1e-8, 1e-9, 1e-10,
+    1e-11, 1e-12, 1e-13, 1e-14, 1e-15, 1e-16, 1e-17, 1e-18, 1e-19
+};
+
+/* below this the integer part fits 32 bits and is split exactly */
+#define HPDF_FTOA_FAST_LIMIT    1000000.0f
+
 char*
 HPDF_FToA  (char       *s,
             HPDF_REAL   val,
@@ -206,36 +218,86 @@ HPDF_FToA  (char       *s,
         val = -val;
     }
 
-    /* compute the decimal precision to write at least 5 significant figures */
-    logVal = (HPDF_INT32)(val > 1e-20 ? log10(val) : 0.);
-    if (logVal >= 0) {
-        prec = 5;
-    }
-    else {
-        prec = -logVal + 5;
-    }
+    if (val < HPDF_FTOA_FAST_LIMIT) {
+        /* content stream coordinates: the same digits as the general case
+         * below, taken from integers instead of log10 and modff */
+        HPDF_UINT32 ival = (HPDF_UINT32)val;
+
+        fpart_val = val - (HPDF_REAL)ival;
+
+        do {
+            *t++ = (char)(ival % 10) + '0';
+            ival /= 10;
+        } while (ival > 0);
+
+        t--;
+        while (s <= eptr && *t != 0)
+            *s++ = *t--;
+
+        *s++ = '.';
+        if (fpart_val != 0.0 && val >= 8.0f) {
+            /* from 8 up the fraction is a multiple of 2^-20, so every float
+             * step above is exact and the 5 digits are plain truncation */
+            HPDF_UINT32 i;
+            HPDF_UINT32 digits = (HPDF_UINT32)(((HPDF_UINT64)(fpart_val *
+                    1048576.0f) * 100000) >> 20);
+
+            for (i = 5; i > 0; i--) {
+                s[i - 1] = (char)(digits % 10) + '0';
+                digits /= 10;
+            }
+            s += 5;
+        } else if (fpart_val != 0.0) {
+            HPDF_UINT32 i;
+
+            prec = 5;
+            if (val < 1 && val > 1e-20) {
+                for (i = 0; i < sizeof(HPDF_NEG_POW10) / sizeof(double) &&
+                        val <= HPDF_NEG_POW10[i]; i++)
+                    prec++;
+            }
 
-    /* separate an integer part and a fractional part. */
-    fpart_val = modff(val, &int_val);
-
-    /* process integer part */
-    do {
-        dig = modff(int_val/10.0f, &int_val);
-        *t++ = (char)(dig*10.0 + 0.5) + '0';
-    } while (int_val > 0);
-
-    /* copy to destination buffer */
-    t--;
-    while (s <= eptr && *t != 0)
-        *s++ = *t--;
-
-    /* process fractional part */
-    *s++ = '.';
-    if (fpart_val != 0.0) {
-        HPDF_UINT32 i;
-        for (i = 0; i < prec; i++) {
-            fpart_val = modff(fpart_val*10.0f, &int_val);
-            *s++ = (char)(int_val + 0.5) + '0';
+            for (i = 0; i < prec; i++) {
+                HPDF_UINT32 d;
+
+                fpart_val *= 10.0f;
+                d = (HPDF_UINT32)fpart_val;
+                fpart_val -= (HPDF_REAL)d;
+                *s++ = (char)d + '0';
+            }
+        }
+    } else {
+        /* compute the decimal precision to write at least 5 significant figures */
+        logVal = (HPDF_INT32)(val > 1e-20 ? log10(val) : 0.);
+        if (logVal >= 0) {
+            prec = 5;
+        }
+        else {
+            prec = -logVal + 5;
+        }
+
+        /* separate an integer part and a fractional part. */
+        fpart_val = modff(val, &int_val);
+
+        /* process integer part */
+        do {
+            dig = modff(int_val/10.0f, &int_val);
+            *t++ = (char)(dig*10.0 + 0.5) + '0';
+        } while (int_val > 0);
+
+        /* copy to destination buffer */
+        t--;
+        while (s <= eptr && *t != 0)
+            *s++ = *t--;
+
+        /* process fractional part */
+        *s++ = '.';
+        if (fpart_val != 0.0) {
+            HPDF_UINT32 i;
+            for (i = 0; i < prec; i++) {
+                fpart_val = modff(fpart_val*10.0f, &int_val);
+                *s++ = (char)(int_val + 0.5) + '0';
+            }
         }
     }
 
@@ -23,6 +23,12 @@ static HPDF_STATUS
 WriteTrailer  (HPDF_Xref     xref,
                HPDF_Stream   stream);
 
+static HPDF_STATUS
+WriteObject  (HPDF_XrefEntry  entry,
+              HPDF_UINT       obj_id,
+              HPDF_Stream     stream,
+              HPDF_Encrypt    e);
+
 
 HPDF_Xref
 HPDF_Xref_New  (HPDF_MMgr     mmgr,
@@ -162,6 +168,7 @@ HPDF_Xref_Add  (HPDF_Xref  xref,
     entry->byte_offset = 0;
     entry->gen_no = 0;
     entry->obj = obj;
+    entry->flushed = HPDF_FALSE;
     header->obj_id = xref->start_offset + xref->entries->count - 1 +
                     HPDF_OTYPE_INDIRECT;
 
@@ -243,28 +250,13 @@ HPDF_Xref_WriteToStream  (HPDF_Xref    xref,
         for (i = str_idx; i < tmp_xref->entries->count; i++) {
             HPDF_XrefEntry  entry =
                         (HPDF_XrefEntry)HPDF_List_ItemAt (tmp_xref->entries, i);
-            HPDF_UINT obj_id = tmp_xref->start_offset + i;
-            HPDF_UINT16 gen_no = entry->gen_no;
-
-            entry->byte_offset = stream->size;
-
-            pbuf = buf;
-            pbuf = HPDF_IToA (pbuf, obj_id, eptr);
-            *pbuf++ = ' ';
-            pbuf = HPDF_IToA (pbuf, gen_no, eptr);
-            HPDF_StrCpy(pbuf, " obj\012", eptr);
-
-            if ((ret = HPDF_Stream_WriteStr (stream, buf)) != HPDF_OK)
-               return ret;
-
-            if (e)
-                HPDF_Encrypt_InitKey (e, obj_id, gen_no);
 
-            if ((ret = HPDF_Obj_WriteValue (entry->obj, stream, e)) != HPDF_OK)
-                return ret;
+            /* objects flushed earlier already have their byte offset */
+            if (entry->flushed)
+                continue;
 
-            if ((ret = HPDF_Stream_WriteStr (stream, "\012endobj\012"))
-                    != HPDF_OK)
+            if ((ret = WriteObject (entry, tmp_xref->start_offset + i, stream,
+                    e)) != HPDF_OK)
                 return ret;
        }
 
@@ -313,6 +305,117 @@ HPDF_Xref_WriteToStream  (HPDF_Xref    xref,
     return ret;
 }
 
+static HPDF_STATUS
+WriteObject  (HPDF_XrefEntry  entry,
+              HPDF_UINT       obj_id,
+              HPDF_Stream     stream,
+              HPDF_Encrypt    e)
+{
+    HPDF_STATUS ret;
+    char buf[HPDF_SHORT_BUF_SIZ];
+    char* pbuf;
+    char* eptr = buf + HPDF_SHORT_BUF_SIZ - 1;
+    HPDF_UINT16 gen_no = entry->gen_no;
+
+    entry->byte_offset = stream->size;
+
+    pbuf = buf;
+    pbuf = HPDF_IToA (pbuf, obj_id, eptr);
+    *pbuf++ = ' ';
+    pbuf = HPDF_IToA (pbuf, gen_no, eptr);
+    HPDF_StrCpy(pbuf, " obj\012", eptr);
+
+    if ((ret = HPDF_Stream_WriteStr (stream, buf)) != HPDF_OK)
+       return ret;
+
+    if (e)
+        HPDF_Encrypt_InitKey (e, obj_id, gen_no);
+
+    if ((ret = HPDF_Obj_WriteValue (entry->obj, stream, e)) != HPDF_OK)
+        return ret;
+
+    return HPDF_Stream_WriteStr (stream, "\012endobj\012");
+}
+
+
+/*
+ *  HPDF_Xref_FlushObject
+ *
+ *  Write one indirect object ahead of HPDF_Xref_WriteToStream, which then
+ *  only lists it in the cross-reference table. Used to stream finished
+ *  pages to the output while the rest of the document is being built.
+ */
+
+HPDF_STATUS
+HPDF_Xref_FlushObject  (HPDF_Xref     xref,
+                        void          *obj,
+                        HPDF_Stream   stream,
+                        HPDF_Encrypt  e)
+{
+    HPDF_Obj_Header *header = (HPDF_Obj_Header *)obj;
+    HPDF_XrefEntry entry;
+    HPDF_UINT obj_id;
+    HPDF_STATUS ret;
+
+    HPDF_PTRACE((" HPDF_Xref_FlushObject\n"));
+
+    if (!obj || !(header->obj_id & HPDF_OTYPE_INDIRECT))
+        return HPDF_SetError (xref->error, HPDF_INVALID_OBJECT, 0);
+
+    obj_id = header->obj_id & 0x00FFFFFF;
+    if (obj_id < xref->start_offset ||
+            obj_id >= xref->start_offset + xref->entries->count)
+        return HPDF_SetError (xref->error, HPDF_INVALID_OBJ_ID, 0);
+
+    entry = HPDF_Xref_GetEntry (xref, obj_id - xref->start_offset);
+    if (entry->flushed)
+        return HPDF_OK;
+
+    if ((ret = WriteObject (entry, obj_id, stream, e)) != HPDF_OK)
+        return ret;
+
+    entry->flushed = HPDF_TRUE;
+
+    return HPDF_OK;
+}
+
+
+/*
+ *  HPDF_Xref_ReleaseObject
+ *
+ *  Free an object written by HPDF_Xref_FlushObject that nothing refers to
+ *  any more. Its entry keeps the byte offset for the cross-reference table.
+ */
+
+HPDF_STATUS
+HPDF_Xref_ReleaseObject  (HPDF_Xref  xref,
+                          void       *obj)
+{
+    HPDF_Obj_Header *header = (HPDF_Obj_Header *)obj;
+    HPDF_XrefEntry entry;
+    HPDF_UINT obj_id;
+
+    HPDF_PTRACE((" HPDF_Xref_ReleaseObject\n"));
+
+    if (!obj || !(header->obj_id & HPDF_OTYPE_INDIRECT))
+        return HPDF_SetError (xref->error, HPDF_INVALID_OBJECT, 0);
+
+    obj_id = header->obj_id & 0x00FFFFFF;
+    if (obj_id < xref->start_offset ||
+            obj_id >= xref->start_offset + xref->entries->count)
+        return HPDF_SetError (xref->error, HPDF_INVALID_OBJ_ID, 0);
+
+    entry = HPDF_Xref_GetEntry (xref, obj_id - xref->start_offset);
+    if (!entry->flushed || entry->obj != obj)
+        return HPDF_SetError (xref->error, HPDF_INVALID_OBJECT, 0);
+
+    HPDF_Obj_ForceFree (xref->mmgr, obj);
+    entry->obj = NULL;
+
+    return HPDF_OK;
+}
+
+
 static HPDF_STATUS
 WriteTrailer  (HPDF_Xref     xref,
                HPDF_Stream   stream)
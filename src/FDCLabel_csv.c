@@ -0,0 +1,1258 @@
+/* FDCLabel_csv.c Fast Dynamic C Label Generator
+ *
+ * Copyright (C) Ivan Rolero
+ *
+ * This file is part of FDCLabel.
+ *
+ * FDCLabel is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FDCLabel is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#ifdef _WIN32
+#include <windows.h>
+#include <io.h>
+#include <fcntl.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#include "utils.h"
+
+/* ---------- File Buffer ---------- */
+
+// The whole file is mapped copy-on-write (or read into one buffer) and
+// tokenized in place: field values are NUL-terminated where their
+// delimiter was, so every value points straight into the file contents.
+
+static void release_csv_buffer(CSVData *csv) {
+    if (!csv->data) return;
+
+    if (csv->mapped) {
+#ifdef _WIN32
+        UnmapViewOfFile(csv->data);
+#else
+        munmap(csv->data, csv->data_size);
+#endif
+    } else {
+        free(csv->data);
+    }
+    csv->data = NULL;
+    csv->data_size = 0;
+    csv->mapped = 0;
+}
+
+// Fallback when the file cannot be mapped: one allocation for all of it.
+// A newline is appended so the last line has room for its terminator.
+static int read_csv_buffer(FILE *f, CSVData *csv) {
+    size_t capacity = 64 * 1024;
+    size_t size = 0;
+    char *data = malloc(capacity);
+    if (!data) return -1;
+
+    for (;;) {
+        if (size + 1 >= capacity) {
+            char *grown = realloc(data, capacity * 2);
+            if (!grown) {
+                free(data);
+                return -1;
+            }
+            data = grown;
+            capacity *= 2;
+        }
+        size_t n = fread(data + size, 1, capacity - size - 1, f);
+        if (n == 0) break;
+        size += n;
+    }
+
+    // An empty file stays empty, anything else gets its final newline
+    if (size > 0) data[size++] = '\n';
+    csv->data = data;
+    csv->data_size = size;
+    csv->mapped = 0;
+    return 0;
+}
+
+// Map the file when it ends with a newline, so that every field terminator
+// lands inside the mapping; otherwise read it into memory.
+static int load_csv_buffer(const char *filename, CSVData *csv) {
+    if (strcmp(filename, "-") == 0) {
+#ifdef _WIN32
+        _setmode(_fileno(stdin), _O_BINARY);
+#endif
+        return read_csv_buffer(stdin, csv);
+    }
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL,
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file != INVALID_HANDLE_VALUE) {
+        LARGE_INTEGER size;
+        char last = 0;
+        DWORD got = 0;
+
+        if (GetFileSizeEx(file, &size) && size.QuadPart > 0 &&
+            (unsigned long long)size.QuadPart < (size_t)-1) {
+            LARGE_INTEGER pos;
+            pos.QuadPart = size.QuadPart - 1;
+            if (SetFilePointerEx(file, pos, NULL, FILE_BEGIN)) {
+                ReadFile(file, &last, 1, &got, NULL);
+            }
+        }
+
+        if (got == 1 && last == '\n') {
+            HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+            if (mapping) {
+                char *data = MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+                CloseHandle(mapping);
+                if (data) {
+                    CloseHandle(file);
+                    csv->data = data;
+                    csv->data_size = (size_t)size.QuadPart;
+                    csv->mapped = 1;
+                    return 0;
+                }
+            }
+        }
+        CloseHandle(file);
+    }
+#else
+    int fd = open(filename, O_RDONLY);
+    if (fd >= 0) {
+        struct stat st;
+        char last = 0;
+
+        if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0 &&
+            pread(fd, &last, 1, st.st_size - 1) == 1 && last == '\n') {
+            void *data = mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE,
+                              MAP_PRIVATE, fd, 0);
+            if (data != MAP_FAILED) {
+                close(fd);
+                csv->data = data;
+                csv->data_size = (size_t)st.st_size;
+                csv->mapped = 1;
+                return 0;
+            }
+        }
+        close(fd);
+    }
+#endif
+
+    FILE *f = fopen(filename, "rb");
+    if (!f) return -1;
+    int rc = read_csv_buffer(f, csv);
+    fclose(f);
+    return rc;
+}
+
+/* ---------- Scanner ---------- */
+
+// Byte scans of the tokenizer. The vector paths compare 32 (AVX2) or 16
+// (SSE2) bytes at a time and turn the matches into a bitmask whose lowest
+// set bit is the next hit; the tail and other targets use the scalar loop.
+// AVX2 is used when the compiler targets it (e.g. -mavx2 or -march=native).
+
+static const CSVDialect default_dialect = { ',', '"', '"' };
+
+// Blank inside a record: isspace() of the C locale without the line
+// breaks, and without the delimiter when that is a tab
+static inline int csv_blank(char c, char delimiter) {
+    return (c == ' ' || c == '\t' || c == '\v' || c == '\f') && c != delimiter;
+}
+
+// First delimiter or '\n' in [p, end), or end: the end of an unquoted field
+static inline char* scan_unquoted(char *p, char *end, char delimiter) {
+#if defined(__AVX2__)
+    const __m256i delim = _mm256_set1_epi8(delimiter);
+    const __m256i lf = _mm256_set1_epi8('\n');
+    while (end - p >= 32) {
+        __m256i chunk = _mm256_loadu_si256((const __m256i*)p);
+        unsigned mask = (unsigned)_mm256_movemask_epi8(
+            _mm256_or_si256(_mm256_cmpeq_epi8(chunk, delim), _mm256_cmpeq_epi8(chunk, lf)));
+        if (mask) return p + __builtin_ctz(mask);
+        p += 32;
+    }
+#elif defined(__SSE2__)
+    const __m128i delim = _mm_set1_epi8(delimiter);
+    const __m128i lf = _mm_set1_epi8('\n');
+    while (end - p >= 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i*)p);
+        unsigned mask = (unsigned)_mm_movemask_epi8(
+            _mm_or_si128(_mm_cmpeq_epi8(chunk, delim), _mm_cmpeq_epi8(chunk, lf)));
+        if (mask) return p + __builtin_ctz(mask);
+        p += 16;
+    }
+#endif
+    while (p < end && *p != delimiter && *p != '\n') p++;
+    return p;
+}
+
+// First quote (or escape character) in [p, end), or end: inside a quoted
+// field only these end the plain text, line breaks included
+static inline char* scan_quoted(char *p, char *end, const CSVDialect *d) {
+    if (d->escape == d->quote || d->escape == '\0') {
+        char *q = memchr(p, d->quote, (size_t)(end - p));
+        return q ? q : end;
+    }
+    while (p < end && *p != d->quote && *p != d->escape) p++;
+    return p;
+}
+
+/* ---------- Tokenizer ---------- */
+
+// States of find_record_end, the same steps next_csv_field takes
+enum {
+    RECORD_FIELD_START,
+    RECORD_UNQUOTED,            // also the rest of a field after its closing quote
+    RECORD_QUOTED,
+    RECORD_QUOTED_ESCAPE,       // escape character seen, the next byte is literal
+    RECORD_QUOTED_QUOTE         // quote seen: closing, or the first of a doubled one
+};
+
+// Advance the record state over [p, end) and return the '\n' that ends the
+// record, or NULL when it continues past end. Only a quote at the start of
+// a field opens a quoted field, so line breaks inside it belong to the value.
+static char* find_record_end(char *p, char *end, const CSVDialect *d, int *state) {
+    while (p < end) {
+        switch (*state) {
+        case RECORD_FIELD_START:
+            if (*p == '\n') return p;
+            if (d->quote && *p == d->quote) *state = RECORD_QUOTED;
+            else if (*p != d->delimiter && !csv_blank(*p, d->delimiter)) *state = RECORD_UNQUOTED;
+            p++;
+            break;
+        case RECORD_UNQUOTED:
+            p = scan_unquoted(p, end, d->delimiter);
+            if (p == end) break;
+            if (*p == '\n') return p;
+            *state = RECORD_FIELD_START;
+            p++;
+            break;
+        case RECORD_QUOTED:
+            p = scan_quoted(p, end, d);
+            if (p == end) break;
+            *state = *p == d->quote ? RECORD_QUOTED_QUOTE : RECORD_QUOTED_ESCAPE;
+            p++;
+            break;
+        case RECORD_QUOTED_ESCAPE:
+            *state = RECORD_QUOTED;
+            p++;
+            break;
+        case RECORD_QUOTED_QUOTE:
+            if (*p == d->quote) {
+                *state = RECORD_QUOTED;
+                p++;
+            } else {
+                *state = RECORD_UNQUOTED;
+            }
+            break;
+        }
+    }
+    return NULL;
+}
+
+// Parse the field at *cursor of a record that ends before end. Leading
+// blanks are skipped, unquoted fields lose trailing blanks (and the CR of
+// a CRLF), quoted fields may span lines and have their doubled quotes and
+// escapes collapsed in place (only when they contain one). *cursor moves
+// past the delimiter, or past the record's '\n' with *last set. Returns
+// the NUL-terminated value.
+static char* next_csv_field(char **cursor, char *end, const CSVDialect *d,
+                            int *out_len, int *last) {
+    char *ptr = *cursor;
+    const char delimiter = d->delimiter;
+
+    while (ptr < end && csv_blank(*ptr, delimiter)) ptr++;
+
+    char *start = ptr;
+    char *value_end;
+    int quoted = d->quote && ptr < end && *ptr == d->quote;
+    int escaped = 0;
+
+    if (quoted) {
+        start = ++ptr;
+        for (;;) {
+            ptr = scan_quoted(ptr, end, d);
+            if (ptr + 1 >= end) {
+                // Unterminated: the value runs to the end of the input
+                ptr = end;
+                break;
+            }
+            if (*ptr == d->quote && ptr[1] != d->quote) break;
+            escaped = 1;
+            ptr += 2;
+        }
+        value_end = ptr;
+        if (ptr < end) ptr++; // closing quote
+
+        // Text after the closing quote up to the delimiter is dropped
+        ptr = scan_unquoted(ptr, end, delimiter);
+
+        // Keep the terminator inside the buffer, the input ends with '\n'
+        if (value_end >= end) value_end = end - 1;
+    } else {
+        ptr = scan_unquoted(ptr, end, delimiter);
+        value_end = ptr;
+        while (value_end > start && (csv_blank(value_end[-1], delimiter) || value_end[-1] == '\r')) {
+            value_end--;
+        }
+    }
+
+    int len;
+    if (escaped) {
+        char *dest = start;
+        char *src = start;
+        while (src < value_end) {
+            char *special = scan_quoted(src, value_end, d);
+            size_t n = (size_t)(special - src);
+            memmove(dest, src, n);
+            dest += n;
+            if (special + 1 >= value_end) {
+                if (special < value_end) *dest++ = *special;
+                break;
+            }
+            *dest++ = special[1];
+            src = special + 2;
+        }
+        len = (int)(dest - start);
+    } else {
+        len = (int)(value_end - start);
+    }
+
+    // Step over the delimiter or line break before it can be overwritten
+    // by the terminator
+    *last = ptr >= end || *ptr == '\n';
+    if (ptr < end) ptr++;
+
+    start[len] = '\0';
+    *cursor = ptr;
+    *out_len = len;
+    return start;
+}
+
+// Parse the record at *cursor, storing up to max values; further fields
+// are skipped. Returns the number of values stored and moves *cursor to
+// the next record.
+static int next_csv_record(char **cursor, char *end, const CSVDialect *d,
+                           char **values, int *lengths, int max) {
+    int count = 0;
+    int last = 0;
+
+    while (!last && *cursor < end) {
+        int len;
+        char *value = next_csv_field(cursor, end, d, &len, &last);
+        if (count < max) {
+            values[count] = value;
+            lengths[count] = len;
+            count++;
+        }
+    }
+    return count;
+}
+
+// Skip lines holding only blanks and delimiters; returns the next record
+static char* skip_blank_lines(char *p, char *end, char delimiter) {
+    for (;;) {
+        char *q = p;
+        while (q < end && (csv_blank(*q, delimiter) || *q == delimiter || *q == '\r')) q++;
+        if (q >= end) return end;
+        if (*q != '\n') return p;
+        p = q + 1;
+    }
+}
+
+// Length of a UTF-8 byte order mark at p, which is not part of the header
+static size_t csv_bom_length(const char *p, size_t size) {
+    return size >= 3 && (unsigned char)p[0] == 0xEF && (unsigned char)p[1] == 0xBB &&
+           (unsigned char)p[2] == 0xBF ? 3 : 0;
+}
+
+/* ---------- Row Selection ---------- */
+
+// Keep a copy of the selection with its conditions bound to the header's
+// columns. Returns -1 when a --where field is not in the header.
+static int bind_csv_selection(CSVData *csv, const CSVSelection *selection) {
+    if (!selection || (selection->range_count == 0 && selection->condition_count == 0)) return 0;
+    csv->selection = *selection;
+    csv->selecting = 1;
+    CSVSelection *sel = &csv->selection;
+
+    sel->last_row = sel->range_count > 0 ? 0 : INT_MAX;
+    for (int r = 0; r < sel->range_count; r++) {
+        if (sel->ranges[r].end > sel->last_row) sel->last_row = sel->ranges[r].end;
+    }
+
+    for (int c = 0; c < sel->condition_count; c++) {
+        CSVRowCondition *cond = &sel->conditions[c];
+        cond->column = -1;
+        for (int f = 0; f < csv->field_count; f++) {
+            if ((int)strlen(csv->field_names[f]) == cond->field_length &&
+                memcmp(csv->field_names[f], cond->field, cond->field_length) == 0) {
+                cond->column = f;
+                break;
+            }
+        }
+        if (cond->column < 0) {
+            log_message(LOG_ERROR, "Error: Unknown field in --where: %.*s\n", cond->field_length, cond->field);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int row_in_ranges(const CSVSelection *sel, int index) {
+    if (sel->range_count == 0) return 1;
+
+    for (int r = 0; r < sel->range_count; r++) {
+        const CSVRowRange *range = &sel->ranges[r];
+        if (index >= range->start && index <= range->end && (index - range->start) % range->step == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int row_matches_conditions(const CSVSelection *sel, char **values, const int *lengths) {
+    for (int c = 0; c < sel->condition_count; c++) {
+        const CSVRowCondition *cond = &sel->conditions[c];
+        int equal = lengths[cond->column] == cond->value_length &&
+                    memcmp(values[cond->column], cond->value, cond->value_length) == 0;
+        if (equal == cond->negate) return 0;
+    }
+    return 1;
+}
+
+// Move past the record at p without tokenizing it
+static char* skip_csv_record(char *p, char *end, const CSVDialect *d) {
+    int state = RECORD_FIELD_START;
+    char *nl = find_record_end(p, end, d, &state);
+    return nl ? nl + 1 : end;
+}
+
+/* ---------- Columnar Layout ---------- */
+
+// With --columnar every column keeps its values in one buffer of its own
+// instead of pointing into the file, which is released after loading.
+// Columns start as dictionaries: each distinct value is stored once and
+// rows keep a 16-bit code. A column with too many distinct values for that
+// to pay off is turned into a plain one, where rows are stored in order.
+
+static uint32_t hash_value(const char *s, int len) {
+    uint32_t h = 2166136261u;
+    for (int i = 0; i < len; i++) {
+        h = (h ^ (unsigned char)s[i]) * 16777619u;
+    }
+    return h;
+}
+
+static void free_csv_column(CSVColumn *col) {
+    free(col->bytes);
+    free(col->offsets);
+    free(col->codes);
+    free(col->slots);
+}
+
+static int init_csv_column(CSVColumn *col) {
+    memset(col, 0, sizeof(*col));
+    col->bytes_cap = 256;
+    col->offset_cap = 64;
+    col->slot_count = 64;
+    col->bytes = malloc(col->bytes_cap);
+    col->offsets = malloc(col->offset_cap * sizeof(uint32_t));
+    col->slots = calloc(col->slot_count, sizeof(uint32_t));
+    if (!col->bytes || !col->offsets || !col->slots) return -1;
+    col->offsets[col->offset_count++] = 0;
+    return 0;
+}
+
+// Append a value and its terminator; offsets stay 32-bit, so a column
+// holds up to 4 GB
+static int column_add_value(CSVColumn *col, const char *value, int len) {
+    size_t needed = col->bytes_len + (size_t)len + 1;
+    if (needed > UINT32_MAX) return -1;
+    if (needed > col->bytes_cap) {
+        size_t grown = col->bytes_cap * 2;
+        while (grown < needed) grown *= 2;
+        char *bytes = realloc(col->bytes, grown);
+        if (!bytes) return -1;
+        col->bytes = bytes;
+        col->bytes_cap = grown;
+    }
+    if (col->offset_count >= col->offset_cap) {
+        int grown = col->offset_cap * 2;
+        uint32_t *offsets = realloc(col->offsets, grown * sizeof(uint32_t));
+        if (!offsets) return -1;
+        col->offsets = offsets;
+        col->offset_cap = grown;
+    }
+
+    memcpy(col->bytes + col->bytes_len, value, len);
+    col->bytes[col->bytes_len + len] = '\0';
+    col->bytes_len = needed;
+    col->offsets[col->offset_count++] = (uint32_t)needed;
+    return 0;
+}
+
+static int grow_column_slots(CSVColumn *col) {
+    uint32_t count = col->slot_count * 2;
+    uint32_t *slots = calloc(count, sizeof(uint32_t));
+    if (!slots) return -1;
+
+    for (int v = 0; v < col->offset_count - 1; v++) {
+        int len = (int)(col->offsets[v + 1] - col->offsets[v]) - 1;
+        uint32_t i = hash_value(col->bytes + col->offsets[v], len) & (count - 1);
+        while (slots[i] != 0) i = (i + 1) & (count - 1);
+        slots[i] = (uint32_t)v + 1;
+    }
+    free(col->slots);
+    col->slots = slots;
+    col->slot_count = count;
+    return 0;
+}
+
+// Write the values of the first rows out in row order and drop the dictionary
+static int make_column_plain(CSVColumn *col, int rows) {
+    CSVColumn plain;
+    if (init_csv_column(&plain) != 0) {
+        free_csv_column(&plain);
+        return -1;
+    }
+    for (int r = 0; r < rows; r++) {
+        uint32_t v = col->codes[r];
+        int len = (int)(col->offsets[v + 1] - col->offsets[v]) - 1;
+        if (column_add_value(&plain, col->bytes + col->offsets[v], len) != 0) {
+            free_csv_column(&plain);
+            return -1;
+        }
+    }
+    free(plain.slots);
+    plain.slots = NULL;
+    plain.slot_count = 0;
+
+    free_csv_column(col);
+    *col = plain;
+    return 0;
+}
+
+// Add the value of row to a column
+static int column_append(CSVColumn *col, const char *value, int len, int row) {
+    if (!col->codes) return column_add_value(col, value, len);
+
+    if (row >= col->code_cap) {
+        int grown = col->code_cap > 0 ? col->code_cap * 2 : 256;
+        uint16_t *codes = realloc(col->codes, grown * sizeof(uint16_t));
+        if (!codes) return -1;
+        col->codes = codes;
+        col->code_cap = grown;
+    }
+
+    uint32_t mask = col->slot_count - 1;
+    uint32_t i = hash_value(value, len) & mask;
+    for (; col->slots[i] != 0; i = (i + 1) & mask) {
+        uint32_t v = col->slots[i] - 1;
+        if (col->offsets[v + 1] - col->offsets[v] - 1 == (uint32_t)len &&
+            memcmp(col->bytes + col->offsets[v], value, len) == 0) {
+            col->codes[row] = (uint16_t)v;
+            return 0;
+        }
+    }
+
+    int distinct = col->offset_count - 1;
+    if (distinct >= CSV_DICT_MAX_VALUES) {
+        if (make_column_plain(col, row) != 0) return -1;
+        return column_add_value(col, value, len);
+    }
+    if (column_add_value(col, value, len) != 0) return -1;
+    col->slots[i] = (uint32_t)distinct + 1;
+    col->codes[row] = (uint16_t)distinct;
+    distinct++;
+
+    // Mostly unique values: the codes only add to the size
+    if (row + 1 >= CSV_DICT_SAMPLE_ROWS && distinct * 2 > row + 1) {
+        return make_column_plain(col, row + 1);
+    }
+    if ((uint32_t)distinct * 2 > col->slot_count) return grow_column_slots(col);
+    return 0;
+}
+
+// Columnar loads copy every value out of the file, so the mapped pages
+// before p can be dropped while the rest is parsed instead of adding up
+// to the whole file. *released is where the previous call stopped.
+static void release_csv_pages(CSVData *csv, char *p, char **released) {
+#ifndef _WIN32
+    if (!csv->mapped || p - *released < CSV_RELEASE_BYTES) return;
+    uintptr_t page = (uintptr_t)sysconf(_SC_PAGESIZE);
+    uintptr_t from = ((uintptr_t)*released + page - 1) & ~(page - 1);
+    uintptr_t to = (uintptr_t)p & ~(page - 1);
+    if (to > from) madvise((void*)from, to - from, MADV_DONTNEED);
+    *released = p;
+#else
+    (void)csv;
+    (void)p;
+    (void)released;
+#endif
+}
+
+// Columnar rows picked by a selection remember the data row they come from
+static int add_source_row(CSVData *csv, int *capacity, int source_row) {
+    if (csv->row_count >= *capacity) {
+        int grown = *capacity > 0 ? *capacity * 2 : 256;
+        int *rows = realloc(csv->source_rows, grown * sizeof(int));
+        if (!rows) return -1;
+        csv->source_rows = rows;
+        *capacity = grown;
+    }
+    csv->source_rows[csv->row_count] = source_row;
+    return 0;
+}
+
+static int init_csv_columns(CSVData *csv) {
+    csv->columns = calloc(csv->field_count > 0 ? csv->field_count : 1, sizeof(CSVColumn));
+    if (!csv->columns) return -1;
+    for (int c = 0; c < csv->field_count; c++) {
+        if (init_csv_column(&csv->columns[c]) != 0) return -1;
+        // Codes are allocated with the first row
+        csv->columns[c].codes = malloc(256 * sizeof(uint16_t));
+        if (!csv->columns[c].codes) return -1;
+        csv->columns[c].code_cap = 256;
+    }
+    return 0;
+}
+
+// Loading is done: drop the hash tables and give back unused capacity
+static void finish_csv_columns(CSVData *csv) {
+    for (int c = 0; c < csv->field_count; c++) {
+        CSVColumn *col = &csv->columns[c];
+        free(col->slots);
+        col->slots = NULL;
+        col->slot_count = 0;
+
+        char *bytes = realloc(col->bytes, col->bytes_len > 0 ? col->bytes_len : 1);
+        if (bytes) {
+            col->bytes = bytes;
+            col->bytes_cap = col->bytes_len;
+        }
+        uint32_t *offsets = realloc(col->offsets, col->offset_count * sizeof(uint32_t));
+        if (offsets) {
+            col->offsets = offsets;
+            col->offset_cap = col->offset_count;
+        }
+        if (col->codes && csv->row_count > 0) {
+            uint16_t *codes = realloc(col->codes, csv->row_count * sizeof(uint16_t));
+            if (codes) {
+                col->codes = codes;
+                col->code_cap = csv->row_count;
+            }
+        }
+    }
+}
+
+// The header names point into the file buffer; copy them before it goes
+static int copy_field_names(CSVData *csv) {
+    size_t size = 1;
+    for (int i = 0; i < csv->field_count; i++) size += strlen(csv->field_names[i]) + 1;
+    csv->field_name_data = malloc(size);
+    if (!csv->field_name_data) return -1;
+
+    char *p = csv->field_name_data;
+    for (int i = 0; i < csv->field_count; i++) {
+        size_t len = strlen(csv->field_names[i]) + 1;
+        memcpy(p, csv->field_names[i], len);
+        csv->field_names[i] = p;
+        p += len;
+    }
+    return 0;
+}
+
+static int count_dictionary_columns(const CSVData *csv) {
+    int count = 0;
+    for (int c = 0; c < csv->field_count; c++) {
+        if (csv->columns[c].codes) count++;
+    }
+    return count;
+}
+
+// Row index of a loaded CSV. Rows of the columnar layout are put together
+// in buffer, pointing into the column storage, and stay valid until buffer
+// is used for another row. Returns NULL when memory runs out.
+const CSVRow* get_csv_row(const CSVData *csv, int index, CSVRowBuffer *buffer) {
+    if (!csv->columns) return &csv->rows[index];
+
+    if (csv->field_count > buffer->value_capacity) {
+        char **values = realloc(buffer->values, csv->field_count * sizeof(char*));
+        if (values) buffer->values = values;
+        int *lengths = realloc(buffer->lengths, csv->field_count * sizeof(int));
+        if (lengths) buffer->lengths = lengths;
+        if (!values || !lengths) return NULL;
+        buffer->value_capacity = csv->field_count;
+    }
+
+    for (int c = 0; c < csv->field_count; c++) {
+        const CSVColumn *col = &csv->columns[c];
+        uint32_t v = col->codes ? col->codes[index] : (uint32_t)index;
+        buffer->values[c] = col->bytes + col->offsets[v];
+        buffer->lengths[c] = (int)(col->offsets[v + 1] - col->offsets[v]) - 1;
+    }
+    buffer->row.fields = buffer->values;
+    buffer->row.lengths = buffer->lengths;
+    buffer->row.count = csv->field_count;
+    buffer->row.source_row = csv->source_rows ? csv->source_rows[index] : index;
+    buffer->row.interned = 1;
+    return &buffer->row;
+}
+
+// The data row of the file that row index of a loaded CSV comes from
+int csv_source_row(const CSVData *csv, int index) {
+    if (!csv->columns) return csv->rows[index].source_row;
+    return csv->source_rows ? csv->source_rows[index] : index;
+}
+
+/* ---------- CSV Data ---------- */
+
+static void close_csv_stream(CSVStream *stream);
+
+void free_csv_data(CSVData *csv) {
+    if (!csv) return;
+
+    close_csv_stream(csv->stream);
+    release_csv_buffer(csv);
+    free(csv->field_names);
+    free(csv->values);
+    free(csv->lengths);
+    free(csv->rows);
+    if (csv->columns) {
+        for (int c = 0; c < csv->field_count; c++) free_csv_column(&csv->columns[c]);
+        free(csv->columns);
+    }
+    free(csv->field_name_data);
+    free(csv->source_rows);
+    free(csv);
+}
+
+// Make room for one more row of field_count values
+static int reserve_csv_row(CSVData *csv, int *capacity) {
+    if (csv->row_count < *capacity) return 0;
+    if (*capacity >= MAX_CSV_ROWS) return -1;
+
+    int grown = *capacity * 2;
+    if (grown > MAX_CSV_ROWS) grown = MAX_CSV_ROWS;
+
+    size_t cells = (size_t)grown * (csv->field_count > 0 ? csv->field_count : 1);
+    CSVRow *rows = realloc(csv->rows, grown * sizeof(CSVRow));
+    if (rows) csv->rows = rows;
+    char **values = realloc(csv->values, cells * sizeof(char*));
+    if (values) csv->values = values;
+    int *lengths = realloc(csv->lengths, cells * sizeof(int));
+    if (lengths) csv->lengths = lengths;
+
+    if (!rows || !values || !lengths) return -1;
+    *capacity = grown;
+    return 0;
+}
+
+// Tokenize the loaded buffer into the header and the value tables of the
+// selected rows, or with columnar into columns, after which the buffer is
+// released. Frees csv and returns NULL on error.
+static CSVData* tokenize_csv(CSVData *csv, int columnar, const CSVSelection *selection) {
+    const CSVDialect *d = &csv->dialect;
+    char *ptr = csv->data;
+    char *data_end = csv->data + csv->data_size;
+    STATS_ADD(STAT_BYTES_READ, csv->data_size);
+
+    // Header record; the buffer ends with a newline
+    if (csv->data_size > 0) ptr += csv_bom_length(ptr, csv->data_size);
+    ptr = skip_blank_lines(ptr, data_end, d->delimiter);
+    if (ptr >= data_end) {
+        log_message(LOG_ERROR, "CSV file is empty\n");
+        free_csv_data(csv);
+        return NULL;
+    }
+
+    csv->field_names = malloc(MAX_CSV_FIELDS * sizeof(char*));
+    int *name_lengths = malloc(MAX_CSV_FIELDS * sizeof(int));
+    if (!csv->field_names || !name_lengths) {
+        free(name_lengths);
+        free_csv_data(csv);
+        return NULL;
+    }
+    csv->field_count = next_csv_record(&ptr, data_end, d, csv->field_names, name_lengths, MAX_CSV_FIELDS);
+    free(name_lengths);
+    if (bind_csv_selection(csv, selection) != 0) {
+        free_csv_data(csv);
+        return NULL;
+    }
+
+    // Empty value for missing trailing fields: the header's line break is
+    // never part of a field
+    char *empty = ptr - 1;
+    *empty = '\0';
+
+    // Data rows; the columnar layout tokenizes each row into one row of
+    // the value tables and appends it to the columns
+    int capacity = columnar ? 1 : 100;
+    int source_capacity = 0;
+    char *released = ptr;       // the header stays, its names are still used
+    size_t cells = (size_t)capacity * (csv->field_count > 0 ? csv->field_count : 1);
+    csv->rows = malloc(capacity * sizeof(CSVRow));
+    csv->values = malloc(cells * sizeof(char*));
+    csv->lengths = malloc(cells * sizeof(int));
+    if (!csv->rows || !csv->values || !csv->lengths ||
+        (columnar && init_csv_columns(csv) != 0)) {
+        free_csv_data(csv);
+        return NULL;
+    }
+
+    for (;;) {
+        ptr = skip_blank_lines(ptr, data_end, d->delimiter);
+        // Columnar rows cost a code or an offset per column, so only the
+        // value tables of the row layout are capped
+        if (ptr >= data_end || (!columnar && csv->row_count >= MAX_CSV_ROWS)) break;
+
+        // Rows outside the ranges are only scanned for their end
+        int source_row = csv->scanned_rows++;
+        if (csv->selecting) {
+            if (source_row > csv->selection.last_row) break;
+            if (!row_in_ranges(&csv->selection, source_row)) {
+                ptr = skip_csv_record(ptr, data_end, d);
+                continue;
+            }
+        }
+
+        if (!columnar && reserve_csv_row(csv, &capacity) != 0) {
+            log_message(LOG_ERROR, "Memory allocation error for CSV row\n");
+            break;
+        }
+
+        size_t base = columnar ? 0 : (size_t)csv->row_count * csv->field_count;
+        int field_index = next_csv_record(&ptr, data_end, d, csv->values + base,
+                                          csv->lengths + base, csv->field_count);
+
+        // Fill missing fields with empty strings
+        while (field_index < csv->field_count) {
+            csv->values[base + field_index] = empty;
+            csv->lengths[base + field_index] = 0;
+            field_index++;
+        }
+
+        // A row that does not match is overwritten by the next one
+        if (csv->selecting && !row_matches_conditions(&csv->selection, csv->values + base,
+                                                      csv->lengths + base)) {
+            continue;
+        }
+
+        if (columnar) {
+            if (csv->selecting && add_source_row(csv, &source_capacity, source_row) != 0) {
+                log_message(LOG_ERROR, "Memory allocation error for CSV row\n");
+                free_csv_data(csv);
+                return NULL;
+            }
+            int c = 0;
+            while (c < csv->field_count &&
+                   column_append(&csv->columns[c], csv->values[c], csv->lengths[c], csv->row_count) == 0) {
+                c++;
+            }
+            if (c < csv->field_count) {
+                log_message(LOG_ERROR, "Memory allocation error for CSV column\n");
+                free_csv_data(csv);
+                return NULL;
+            }
+            release_csv_pages(csv, ptr, &released);
+        } else {
+            csv->rows[csv->row_count].count = csv->field_count;
+            csv->rows[csv->row_count].source_row = source_row;
+            csv->rows[csv->row_count].interned = 0;
+        }
+        csv->row_count++;
+    }
+
+    if (columnar) {
+        finish_csv_columns(csv);
+        if (copy_field_names(csv) != 0) {
+            free_csv_data(csv);
+            return NULL;
+        }
+        free(csv->rows);
+        free(csv->values);
+        free(csv->lengths);
+        csv->rows = NULL;
+        csv->values = NULL;
+        csv->lengths = NULL;
+        release_csv_buffer(csv);
+        log_message(LOG_INFO, "Columnar CSV: %d of %d columns dictionary encoded\n",
+                    count_dictionary_columns(csv), csv->field_count);
+        return csv;
+    }
+
+    // The value tables are final now, point every row into them
+    for (int i = 0; i < csv->row_count; i++) {
+        csv->rows[i].fields = csv->values + (size_t)i * csv->field_count;
+        csv->rows[i].lengths = csv->lengths + (size_t)i * csv->field_count;
+    }
+
+    return csv;
+}
+
+// dialect may be NULL for comma separated values with double quotes.
+// columnar keeps the values per column (see get_csv_row) so that the file
+// does not stay in memory. selection, when not NULL, picks the rows to keep.
+CSVData* parse_csv(const char *filename, const CSVDialect *dialect, int columnar,
+                   const CSVSelection *selection) {
+    if (!filename) {
+        log_message(LOG_ERROR, "NULL filename provided\n");
+        return NULL;
+    }
+
+    CSVData *csv = calloc(1, sizeof(CSVData));
+    if (!csv) return NULL;
+    csv->dialect = dialect ? *dialect : default_dialect;
+
+    if (load_csv_buffer(filename, csv) != 0) {
+        log_message(LOG_ERROR, "Cannot open CSV file: %s\n", filename);
+        free(csv);
+        return NULL;
+    }
+
+    return tokenize_csv(csv, columnar, selection);
+}
+
+// CSV text that is already in memory, such as a request body. Takes
+// ownership of data, a malloc'd buffer with room for one more byte after
+// size for the final newline; it is freed with the CSVData or on error.
+CSVData* parse_csv_buffer(char *data, size_t size, const CSVDialect *dialect) {
+    if (!data) return NULL;
+
+    CSVData *csv = calloc(1, sizeof(CSVData));
+    if (!csv) {
+        free(data);
+        return NULL;
+    }
+    csv->dialect = dialect ? *dialect : default_dialect;
+
+    if (size > 0) data[size++] = '\n';
+    csv->data = data;
+    csv->data_size = size;
+    csv->mapped = 0;
+    return tokenize_csv(csv, 0, NULL);
+}
+
+/* ---------- Streaming Reader ---------- */
+
+// Row-at-a-time reading for inputs that are too large to hold, or that are
+// still being written (a pipe on stdin). Only the header and the current
+// record are kept; memory is bounded by the longest record.
+struct CSVStream {
+    int fd;
+    int owns_fd;
+    int eof;
+    int error;                  // errno of a failed read, the input ends early
+    char *buf;
+    size_t cap;
+    size_t start;               // first unread byte
+    size_t end;                 // end of valid data
+    CSVRow row;
+};
+
+static void close_csv_stream(CSVStream *stream) {
+    if (!stream) return;
+    if (stream->owns_fd) {
+#ifdef _WIN32
+        _close(stream->fd);
+#else
+        close(stream->fd);
+#endif
+    }
+    free(stream->buf);
+    free(stream);
+}
+
+// Read more input after the unread bytes, dropping consumed bytes and
+// growing the buffer when the unread bytes fill it. Sets eof at the end of
+// input; returns -1 with error set when the read fails.
+static int fill_csv_stream(CSVStream *stream) {
+    if (stream->start > 0) {
+        memmove(stream->buf, stream->buf + stream->start, stream->end - stream->start);
+        stream->end -= stream->start;
+        stream->start = 0;
+    }
+    if (stream->end + 1 >= stream->cap) {
+        char *grown = realloc(stream->buf, stream->cap * 2);
+        if (!grown) {
+            stream->error = ENOMEM;
+            return -1;
+        }
+        stream->buf = grown;
+        stream->cap *= 2;
+    }
+
+    for (;;) {
+#ifdef _WIN32
+        int n = _read(stream->fd, stream->buf + stream->end, (unsigned int)(stream->cap - stream->end - 1));
+#else
+        ssize_t n = read(stream->fd, stream->buf + stream->end, stream->cap - stream->end - 1);
+#endif
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) {
+            // A failed read is not the end of the input: the rows would be cut short
+            stream->error = errno;
+            return -1;
+        }
+        if (n == 0) {
+            stream->eof = 1;
+        } else {
+            stream->end += (size_t)n;
+            STATS_ADD(STAT_BYTES_READ, n);
+        }
+        return 0;
+    }
+}
+
+// Next complete record, up to the '\n' outside quotes that ends it, read
+// with plain read() so that a pipe yields rows as soon as they arrive.
+// Returns NULL at the end of input or after a failed read.
+static char* next_stream_record(CSVStream *stream, const CSVDialect *d, char **record_end) {
+    size_t scanned = 0;         // bytes of the record already scanned
+    int state = RECORD_FIELD_START;
+    int terminated = 0;
+    if (stream->error) return NULL;
+
+    for (;;) {
+        char *nl = find_record_end(stream->buf + stream->start + scanned, stream->buf + stream->end,
+                                   d, &state);
+        if (nl) {
+            char *record = stream->buf + stream->start;
+            *record_end = nl;
+            stream->start = (size_t)(nl - stream->buf) + 1;
+            return record;
+        }
+        scanned = stream->end - stream->start;
+
+        if (stream->eof) {
+            if (stream->start == stream->end) return NULL;
+            if (!terminated) {
+                terminated = 1;
+                if (stream->buf[stream->end - 1] != '\n') {
+                    // Last line without a newline: terminate it (room is kept by fill_csv_stream)
+                    stream->buf[stream->end++] = '\n';
+                    continue;
+                }
+            }
+            // Unterminated quote: the rest of the input is the last record
+            char *record = stream->buf + stream->start;
+            *record_end = stream->buf + stream->end - 1;
+            stream->start = stream->end;
+            return record;
+        }
+
+        if (fill_csv_stream(stream) < 0) return NULL;
+    }
+}
+
+// Open a CSV file ("-" for stdin) for row-at-a-time reading. The returned
+// CSVData has its field names but no rows; fetch them with read_csv_row.
+CSVData* open_csv_stream(const char *filename, const CSVDialect *dialect,
+                         const CSVSelection *selection) {
+    if (!filename) {
+        log_message(LOG_ERROR, "NULL filename provided\n");
+        return NULL;
+    }
+
+    CSVData *csv = calloc(1, sizeof(CSVData));
+    CSVStream *stream = calloc(1, sizeof(CSVStream));
+    if (!csv || !stream) {
+        free(csv);
+        free(stream);
+        return NULL;
+    }
+    csv->stream = stream;
+    csv->dialect = dialect ? *dialect : default_dialect;
+
+    if (strcmp(filename, "-") == 0) {
+#ifdef _WIN32
+        _setmode(_fileno(stdin), _O_BINARY);
+#endif
+        stream->fd = fileno(stdin);
+    } else {
+#ifdef _WIN32
+        stream->fd = _open(filename, _O_RDONLY | _O_BINARY);
+#else
+        stream->fd = open(filename, O_RDONLY);
+#endif
+        if (stream->fd < 0) {
+            log_message(LOG_ERROR, "Cannot open CSV file: %s\n", filename);
+            free_csv_data(csv);
+            return NULL;
+        }
+        stream->owns_fd = 1;
+    }
+
+    stream->cap = 64 * 1024;
+    stream->buf = malloc(stream->cap);
+    if (!stream->buf) {
+        free_csv_data(csv);
+        return NULL;
+    }
+
+    // A byte order mark is dropped before the header is split: its bytes
+    // would start an unquoted field and hide a quote that follows
+    while (stream->end < 3 && !stream->eof) {
+        if (fill_csv_stream(stream) < 0) break;
+    }
+    stream->start = csv_bom_length(stream->buf, stream->end);
+
+    // The header record is kept for the whole run in csv->data
+    char *record_end;
+    char *record;
+    do {
+        record = next_stream_record(stream, &csv->dialect, &record_end);
+    } while (record && skip_blank_lines(record, record_end + 1, csv->dialect.delimiter) > record_end);
+    if (!record) {
+        if (stream->error) {
+            log_message(LOG_ERROR, "Error reading CSV input: %s\n", strerror(stream->error));
+        } else {
+            log_message(LOG_ERROR, "CSV file is empty\n");
+        }
+        free_csv_data(csv);
+        return NULL;
+    }
+    csv->data_size = (size_t)(record_end - record) + 1;
+    csv->data = malloc(csv->data_size);
+    csv->field_names = malloc(MAX_CSV_FIELDS * sizeof(char*));
+    int *name_lengths = malloc(MAX_CSV_FIELDS * sizeof(int));
+    if (!csv->data || !csv->field_names || !name_lengths) {
+        free(name_lengths);
+        free_csv_data(csv);
+        return NULL;
+    }
+    memcpy(csv->data, record, csv->data_size);
+
+    char *ptr = csv->data;
+    csv->field_count = next_csv_record(&ptr, csv->data + csv->data_size, &csv->dialect,
+                                       csv->field_names, name_lengths, MAX_CSV_FIELDS);
+    free(name_lengths);
+    csv->data[csv->data_size - 1] = '\0';
+    if (bind_csv_selection(csv, selection) != 0) {
+        free_csv_data(csv);
+        return NULL;
+    }
+
+    size_t cells = csv->field_count > 0 ? csv->field_count : 1;
+    csv->values = malloc(cells * sizeof(char*));
+    csv->lengths = malloc(cells * sizeof(int));
+    if (!csv->values || !csv->lengths) {
+        free_csv_data(csv);
+        return NULL;
+    }
+    stream->row.fields = csv->values;
+    stream->row.lengths = csv->lengths;
+    stream->row.count = csv->field_count;
+
+    return csv;
+}
+
+// Read the next non-blank selected row of a stream opened with
+// open_csv_stream. The row stays valid until the next call. Returns 1 for
+// a row, 0 at the end of input or after the last row a range can pick,
+// and -1 on error.
+int read_csv_row(CSVData *csv, const CSVRow **row) {
+    if (!csv || !csv->stream || !row) return -1;
+    CSVStream *stream = csv->stream;
+    if (stream->error) return -1;
+
+    for (;;) {
+        if (csv->selecting && csv->scanned_rows > csv->selection.last_row) return 0;
+
+        char *record_end;
+        char *ptr = next_stream_record(stream, &csv->dialect, &record_end);
+        if (!ptr) return stream->eof ? 0 : -1;
+        if (skip_blank_lines(ptr, record_end + 1, csv->dialect.delimiter) > record_end) continue;
+        int source_row = csv->scanned_rows++;
+        if (csv->selecting && !row_in_ranges(&csv->selection, source_row)) continue;
+
+        int field_index = next_csv_record(&ptr, record_end + 1, &csv->dialect,
+                                          csv->values, csv->lengths, csv->field_count);
+
+        // Fill missing fields with empty strings (the header's terminator)
+        while (field_index < csv->field_count) {
+            csv->values[field_index] = csv->data + csv->data_size - 1;
+            csv->lengths[field_index] = 0;
+            field_index++;
+        }
+        if (csv->selecting && !row_matches_conditions(&csv->selection, csv->values, csv->lengths)) {
+            continue;
+        }
+
+        csv->row_count++;
+        stream->row.source_row = source_row;
+        *row = &stream->row;
+        return 1;
+    }
+}
+
+/* ---------- Row Buffers ---------- */
+
+// Copy a row into storage owned by the caller, for rows that must outlive
+// the next read_csv_row call
+int copy_csv_row(CSVRowBuffer *dst, const CSVRow *src) {
+    if (!dst || !src) return -1;
+
+    size_t bytes = 0;
+    for (int i = 0; i < src->count; i++) bytes += (size_t)src->lengths[i] + 1;
+
+    if (src->count > dst->value_capacity) {
+        char **values = realloc(dst->values, src->count * sizeof(char*));
+        if (values) dst->values = values;
+        int *lengths = realloc(dst->lengths, src->count * sizeof(int));
+        if (lengths) dst->lengths = lengths;
+        if (!values || !lengths) return -1;
+        dst->value_capacity = src->count;
+    }
+    if (bytes > dst->data_capacity) {
+        char *data = realloc(dst->data, bytes);
+        if (!data) return -1;
+        dst->data = data;
+        dst->data_capacity = bytes;
+    }
+
+    char *out = dst->data;
+    for (int i = 0; i < src->count; i++) {
+        memcpy(out, src->fields[i], (size_t)src->lengths[i] + 1);
+        dst->values[i] = out;
+        dst->lengths[i] = src->lengths[i];
+        out += src->lengths[i] + 1;
+    }
+
+    dst->row.fields = dst->values;
+    dst->row.lengths = dst->lengths;
+    dst->row.count = src->count;
+    dst->row.source_row = src->source_row;
+    dst->row.interned = 0;      // the copy is overwritten by the next row
+    return 0;
+}
+
+void free_csv_row_buffer(CSVRowBuffer *buffer) {
+    if (!buffer) return;
+    free(buffer->data);
+    free(buffer->values);
+    free(buffer->lengths);
+    memset(buffer, 0, sizeof(*buffer));
+}
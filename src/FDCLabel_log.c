@@ -0,0 +1,246 @@
+/* FDCLabel_log.c Fast Dynamic C Label Generator
+ *
+ * Copyright (C) Ivan Rolero
+ *
+ * This file is part of FDCLabel.
+ *
+ * FDCLabel is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FDCLabel is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <pthread.h>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+#include "hpdf.h"
+#include "utils.h"
+
+/* ---------- Logging ---------- */
+
+// Errors and warnings are written to stderr at once. Everything else is
+// appended to one buffer that goes to stdout when it is full, on every
+// progress update and at the end, so the render threads never wait on
+// the console.
+
+LogLevel log_level = LOG_INFO;
+int progress_bar = PROGRESS_AUTO;
+
+static char log_buf[LOG_BUFFER_SIZE];
+static size_t log_len = 0;
+static pthread_mutex_t log_lock = PTHREAD_MUTEX_INITIALIZER;
+static int truncated_fields = 0;
+
+// Progress of the labels being rendered, reported every interval
+static int progress_active = 0;
+static int progress_total = -1;     // -1 while the row count is unknown
+static int progress_done = 0;
+static int progress_tty = 0;
+static int progress_shown = 0;      // the bar is on the current terminal line
+static uint64_t progress_start_ns;
+static uint64_t progress_last_ns;
+static uint64_t progress_interval_ns;
+static FILE *progress_file = NULL;
+
+int parse_log_level(const char *s) {
+    if (!s) return -1;
+    if (strcmp(s, "silent") == 0) return LOG_SILENT;
+    if (strcmp(s, "error") == 0) return LOG_ERROR;
+    if (strcmp(s, "warning") == 0) return LOG_WARNING;
+    if (strcmp(s, "info") == 0) return LOG_INFO;
+    if (strcmp(s, "verbose") == 0) return LOG_VERBOSE;
+    return -1;
+}
+
+static void clear_progress_locked(void) {
+    if (progress_shown) {
+        fprintf(stderr, "\r%79s\r", "");
+        progress_shown = 0;
+    }
+}
+
+static void flush_locked(void) {
+    if (log_len == 0) return;
+    clear_progress_locked();
+    fwrite(log_buf, 1, log_len, stdout);
+    fflush(stdout);
+    log_len = 0;
+}
+
+void log_message(LogLevel level, const char *fmt, ...) {
+    if (level > log_level || level == LOG_SILENT) return;
+    va_list args;
+
+    pthread_mutex_lock(&log_lock);
+    if (level <= LOG_WARNING) {
+        // Keep the order with what is still buffered for stdout
+        flush_locked();
+        clear_progress_locked();
+        va_start(args, fmt);
+        vfprintf(stderr, fmt, args);
+        va_end(args);
+    } else {
+        size_t room = sizeof(log_buf) - log_len;
+        va_start(args, fmt);
+        int n = vsnprintf(log_buf + log_len, room, fmt, args);
+        va_end(args);
+
+        if (n >= 0 && (size_t)n >= room) {
+            flush_locked();
+            va_start(args, fmt);
+            if ((size_t)n < sizeof(log_buf)) {
+                n = vsnprintf(log_buf, sizeof(log_buf), fmt, args);
+            } else {
+                vfprintf(stdout, fmt, args);
+                n = 0;
+            }
+            va_end(args);
+        }
+        if (n > 0) log_len += (size_t)n;
+    }
+    pthread_mutex_unlock(&log_lock);
+}
+
+void log_flush(void) {
+    pthread_mutex_lock(&log_lock);
+    flush_locked();
+    pthread_mutex_unlock(&log_lock);
+}
+
+// Truncated values are listed with --verbose and counted otherwise
+void log_truncated_field(const char *field, int row_index) {
+    __atomic_fetch_add(&truncated_fields, 1, __ATOMIC_RELAXED);
+    if (log_level >= LOG_VERBOSE) {
+        log_message(LOG_VERBOSE, "Notice: Truncated field '%s' in row %d\n", field, row_index);
+    }
+}
+
+/* ---------- Progress ---------- */
+
+// Machine-readable progress: one JSON line per update on an open descriptor
+int progress_open_fd(int fd) {
+#ifdef _WIN32
+    progress_file = _fdopen(fd, "w");
+#else
+    progress_file = fdopen(fd, "w");
+#endif
+    if (!progress_file) {
+        fprintf(stderr, "Cannot write progress to file descriptor %d\n", fd);
+        return -1;
+    }
+    return 0;
+}
+
+static void report_progress_locked(int done, uint64_t now, int finished) {
+    double seconds = (double)(now - progress_start_ns) / 1e9;
+    double rate = seconds > 0 ? (double)done / seconds : 0;
+    double eta = progress_total >= 0 && rate > 0 ? (double)(progress_total - done) / rate : -1;
+
+    flush_locked();
+
+    if (progress_bar == 1) {
+        char line[80];
+        int eta_s = eta >= 0 ? (int)(eta + 0.5) : 0;
+        if (progress_total > 0) {
+            char bar[21];
+            int filled = (int)((double)done * 20 / progress_total);
+            if (filled > 20) filled = 20;
+            memset(bar, '#', filled);
+            memset(bar + filled, '-', 20 - filled);
+            bar[20] = '\0';
+            snprintf(line, sizeof(line), "[%s] %d/%d labels  %.0f labels/s  ETA %d:%02d",
+                     bar, done, progress_total, rate, eta_s / 60, eta_s % 60);
+        } else {
+            snprintf(line, sizeof(line), "%d labels  %.0f labels/s", done, rate);
+        }
+
+        if (progress_tty) {
+            fprintf(stderr, "\r%-79s", line);
+            progress_shown = !finished;
+            if (finished) fputc('\n', stderr);
+        } else {
+            fprintf(stderr, "%s\n", line);
+        }
+        fflush(stderr);
+    }
+
+    if (progress_file) {
+        fprintf(progress_file, "{\"done\":%d,\"total\":%d,\"labels_per_sec\":%.1f,\"eta_s\":%.1f,\"finished\":%s}\n",
+                done, progress_total, rate, eta, finished ? "true" : "false");
+        fflush(progress_file);
+    }
+}
+
+// Start counting rendered labels; total is -1 when rows are streamed.
+// What was logged so far is shown first.
+void progress_start(int total) {
+    log_flush();
+#ifdef _WIN32
+    progress_tty = _isatty(_fileno(stderr));
+#else
+    progress_tty = isatty(fileno(stderr));
+#endif
+    if (progress_bar == PROGRESS_AUTO) {
+        progress_bar = progress_tty && log_level >= LOG_INFO;
+    }
+
+    uint64_t interval_ms = progress_bar == 1 && !progress_tty ? PROGRESS_LOG_INTERVAL_MS
+                                                               : PROGRESS_INTERVAL_MS;
+    progress_interval_ns = interval_ms * 1000000ull;
+    progress_total = total;
+    progress_done = 0;
+    progress_start_ns = progress_last_ns = stats_clock();
+    progress_active = 1;
+}
+
+// Called for every finished page. Only every 32nd label looks at the clock,
+// and only one thread reports.
+void progress_add(int labels) {
+    if (!progress_active) return;
+    int done = __atomic_add_fetch(&progress_done, labels, __ATOMIC_RELAXED);
+    if ((done & 31) != 0) return;
+
+    uint64_t now = stats_clock();
+    if (now - __atomic_load_n(&progress_last_ns, __ATOMIC_RELAXED) < progress_interval_ns) return;
+    if (pthread_mutex_trylock(&log_lock) != 0) return;
+    if (now - progress_last_ns >= progress_interval_ns) {
+        progress_last_ns = now;
+        report_progress_locked(done, now, 0);
+    }
+    pthread_mutex_unlock(&log_lock);
+}
+
+// Final progress line, the truncation count and whatever is still buffered
+void log_finish(void) {
+    pthread_mutex_lock(&log_lock);
+    if (progress_active) {
+        report_progress_locked(__atomic_load_n(&progress_done, __ATOMIC_RELAXED), stats_clock(), 1);
+        progress_active = 0;
+    }
+    pthread_mutex_unlock(&log_lock);
+
+    if (truncated_fields > 0 && log_level == LOG_INFO) {
+        log_message(LOG_INFO, "Notice: Truncated %d field values, --verbose lists them\n", truncated_fields);
+    }
+    log_flush();
+
+    if (progress_file) {
+        fclose(progress_file);
+        progress_file = NULL;
+    }
+}
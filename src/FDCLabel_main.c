@@ -36,11 +36,16 @@ int safe_atoi(const char *str, int default_val);
 
 // Helpers
 void error_handler(HPDF_STATUS error_no, HPDF_STATUS detail_no, void *user_data);
-void generate_hex_code(char *hex, int length);
+uint64_t hex_code_seed(uint64_t value);
+void generate_hex_code(uint64_t *state, char *hex, int length);
 
 // CSV functions
-CSVData* parse_csv(const char *filename);
+CSVData* parse_csv(const char *filename, const CSVDialect *dialect, int columnar,
+                   const CSVSelection *selection);
+CSVData* parse_csv_buffer(char *data, size_t size, const CSVDialect *dialect);
 void free_csv_data(CSVData *csv);
+CSVData* open_csv_stream(const char *filename, const CSVDialect *dialect,
+                         const CSVSelection *selection);
 
 // Drawing functions
 void draw_qr_code(HPDF_Page page, float x, float y, float size, const char *text);
@@ -50,14 +55,59 @@ void draw_text_in_box(HPDF_Page page, HPDF_Font font,
 
 // JSON loading functions
 int parse_align(const char *s);
+int parse_compression(const char *s, CompressionConfig *config);
+int parse_csv_char(const char *s, char *out);
+int parse_row_ranges(const char *s, CSVSelection *selection);
+int parse_row_condition(const char *s, CSVSelection *selection);
 HPDF_PageSizes parse_page_size(const char *s);
 HPDF_PageDirection parse_orientation(const char *s);
 int load_page_config_from_json(cJSON *root, PageConfig *config);
 int load_fonts_from_json(cJSON *root, FontConfig *font_config, HPDF_Doc pdf);
-int load_fields_from_json(cJSON *root, Field **out_fields, int *out_count, const char *hex_code, CSVData *csv, int csv_row_index);
 int load_lines_from_json(cJSON *root, LineEntry **out_lines, int *out_count);
-int load_qr_from_json(cJSON *root, QRCodeEntry *qr_entry, const char *hex_code, CSVData *csv, int csv_row_index);
 int validate_json_config(cJSON *root);
+cJSON* load_json_config(const char *config_filename);
+
+// Template compilation and rendering
+int compile_template(cJSON *root, const CSVData *csv, const FontConfig *font_config, LabelTemplate *tpl);
+void free_template(LabelTemplate *tpl);
+
+// Layout and page emission
+int render_context_init(RenderContext *ctx, HPDF_Doc pdf, const LabelTemplate *tpl);
+void render_context_free(RenderContext *ctx);
+int render_rows(RenderContext *ctx, const CSVData *csv, int start_row, int end_row, int threads);
+int render_csv_stream(RenderContext *ctx, CSVData *csv, int threads, int *read_failed);
+int start_page_compression(RenderContext *ctx, int threads);
+int finish_page_compression(RenderContext *ctx);
+
+// Documents and sharded output
+HPDF_Doc create_label_doc(cJSON *root, FontConfig *font_config, const CompressionConfig *compression);
+void free_font_config(FontConfig *font_config);
+int default_thread_count(void);
+int plan_shards(const char *output_filename, int start_row, int end_row,
+                int shard_size, int shard_count, ShardJob **out_jobs);
+int render_shards(cJSON *root, const LabelTemplate *tpl, const CSVData *csv,
+                  ShardJob *jobs, int job_count, int threads, int streaming,
+                  const CompressionConfig *compression, uint64_t hex_seed);
+int write_shard_manifest(const char *output_filename, const CSVData *csv,
+                         const ShardJob *jobs, int job_count);
+
+// Instrumentation
+int stats_start(const char *rows_filename);
+void stats_doc_saved(HPDF_Doc pdf);
+void stats_print_summary(void);
+void stats_finish(void);
+
+// Logging and progress
+int parse_log_level(const char *s);
+void log_message(LogLevel level, const char *fmt, ...);
+void log_flush(void);
+int progress_open_fd(int fd);
+void progress_start(int total);
+void log_finish(void);
+
+// Label server
+int run_label_server(const char *config_filename, int port, const CompressionConfig *compression,
+                     const CSVDialect *dialect);
 
 // Command line and validation
 void print_version();
@@ -77,6 +127,20 @@ int main(int argc, char **argv) {
     const char *output_filename = "labels.pdf";
     int specific_row = -1;
     int validate_only = 0;
+    int threads = 1;
+    int threads_set = 0;
+    int streaming = 0;
+    int columnar = 0;
+    int shard_size = 0;
+    int shard_count = 0;
+    int serve_port = 0;
+    int show_stats = 0;
+    const char *stats_rows_filename = NULL;
+    CompressionConfig compression = { HPDF_COMP_LEVEL_DEFAULT, HPDF_COMP_STRATEGY_DEFAULT };
+    CSVDialect dialect = { ',', '"', '"' };
+    int escape_set = 0;
+    CSVSelection selection;
+    memset(&selection, 0, sizeof(selection));
     
     // Parse command line arguments
     for (int i = 1; i < argc; i++) {
@@ -100,30 +164,156 @@ int main(int argc, char **argv) {
         else if ((strcmp(argv[i], "-r") == 0 || strcmp(argv[i], "--row") == 0) && i+1 < argc) {
             specific_row = safe_atoi(argv[++i], -1);
             if (specific_row < 0) {
-                fprintf(stderr, "Warning: Row index cannot be negative, using 0\n");
+                log_message(LOG_WARNING, "Warning: Row index cannot be negative, using 0\n");
                 specific_row = 0;
             }
         }
-        else if (argv[i][0] != '-') {
-            // Positional argument (CSV file)
+        else if (strcmp(argv[i], "--rows") == 0 && i+1 < argc) {
+            if (parse_row_ranges(argv[++i], &selection) != 0) {
+                log_message(LOG_ERROR, "Error: Invalid --rows: %s (e.g. 12,40-49,1000-:10)\n", argv[i]);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--where") == 0 && i+1 < argc) {
+            if (parse_row_condition(argv[++i], &selection) != 0) {
+                log_message(LOG_ERROR, "Error: Invalid --where: %s (use FIELD=VALUE or FIELD!=VALUE, up to %d)\n",
+                            argv[i], MAX_ROW_CONDITIONS);
+                return 1;
+            }
+        }
+        else if ((strcmp(argv[i], "-t") == 0 || strcmp(argv[i], "--threads") == 0) && i+1 < argc) {
+            threads = safe_atoi(argv[++i], 1);
+            if (threads < 1) {
+                log_message(LOG_WARNING, "Warning: Thread count must be at least 1, using 1\n");
+                threads = 1;
+            }
+            if (threads > MAX_RENDER_THREADS) {
+                log_message(LOG_WARNING, "Warning: Too many threads (%d), limiting to %d\n", threads, MAX_RENDER_THREADS);
+                threads = MAX_RENDER_THREADS;
+            }
+            threads_set = 1;
+        }
+        else if (strcmp(argv[i], "--shard-size") == 0 && i+1 < argc) {
+            shard_size = safe_atoi(argv[++i], 0);
+            if (shard_size < 1) {
+                log_message(LOG_ERROR, "Error: Shard size must be at least 1\n");
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--shards") == 0 && i+1 < argc) {
+            shard_count = safe_atoi(argv[++i], 0);
+            if (shard_count < 1 || shard_count > MAX_SHARDS) {
+                log_message(LOG_ERROR, "Error: Shard count must be between 1 and %d\n", MAX_SHARDS);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--compression") == 0 && i+1 < argc) {
+            if (parse_compression(argv[++i], &compression) != 0) {
+                log_message(LOG_ERROR, "Error: Invalid compression mode: %s\n", argv[i]);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--delimiter") == 0 && i+1 < argc) {
+            if (parse_csv_char(argv[++i], &dialect.delimiter) != 0 || dialect.delimiter == '\0') {
+                log_message(LOG_ERROR, "Error: Invalid delimiter: %s\n", argv[i]);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--quote") == 0 && i+1 < argc) {
+            if (parse_csv_char(argv[++i], &dialect.quote) != 0) {
+                log_message(LOG_ERROR, "Error: Invalid quote character: %s\n", argv[i]);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--escape") == 0 && i+1 < argc) {
+            if (parse_csv_char(argv[++i], &dialect.escape) != 0) {
+                log_message(LOG_ERROR, "Error: Invalid escape character: %s\n", argv[i]);
+                return 1;
+            }
+            escape_set = 1;
+        }
+        else if (strcmp(argv[i], "--serve") == 0 && i+1 < argc) {
+            serve_port = safe_atoi(argv[++i], 0);
+            if (serve_port < 1 || serve_port > 65535) {
+                log_message(LOG_ERROR, "Error: Port must be between 1 and 65535\n");
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--stats") == 0) {
+            show_stats = 1;
+        }
+        else if (strcmp(argv[i], "--stats-rows") == 0 && i+1 < argc) {
+            show_stats = 1;
+            stats_rows_filename = argv[++i];
+        }
+        else if (strcmp(argv[i], "-q") == 0 || strcmp(argv[i], "--quiet") == 0) {
+            log_level = LOG_ERROR;
+        }
+        else if (strcmp(argv[i], "--verbose") == 0) {
+            log_level = LOG_VERBOSE;
+        }
+        else if (strcmp(argv[i], "--log-level") == 0 && i+1 < argc) {
+            int level = parse_log_level(argv[++i]);
+            if (level < 0) {
+                log_message(LOG_ERROR, "Error: Unknown log level: %s (use silent, error, warning, info or verbose)\n", argv[i]);
+                return 1;
+            }
+            log_level = (LogLevel)level;
+        }
+        else if (strcmp(argv[i], "--progress") == 0) {
+            progress_bar = 1;
+        }
+        else if (strcmp(argv[i], "--no-progress") == 0) {
+            progress_bar = 0;
+        }
+        else if (strcmp(argv[i], "--progress-fd") == 0 && i+1 < argc) {
+            if (progress_open_fd(safe_atoi(argv[++i], -1)) != 0) {
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "-s") == 0 || strcmp(argv[i], "--stream") == 0) {
+            streaming = 1;
+        }
+        else if (strcmp(argv[i], "--columnar") == 0) {
+            columnar = 1;
+        }
+        else if (argv[i][0] != '-' || strcmp(argv[i], "-") == 0) {
+            // Positional argument (CSV file, "-" for stdin)
             if (!csv_filename) {
                 csv_filename = argv[i];
             } else {
-                fprintf(stderr, "Error: Unexpected argument: %s\n", argv[i]);
+                log_message(LOG_ERROR, "Error: Unexpected argument: %s\n", argv[i]);
                 print_help(argv[0]);
                 return 1;
             }
         }
         else {
-            fprintf(stderr, "Error: Unknown option: %s\n", argv[i]);
+            log_message(LOG_ERROR, "Error: Unknown option: %s\n", argv[i]);
             print_help(argv[0]);
             return 1;
         }
     }
     
+    // Quotes are escaped by doubling them unless told otherwise
+    if (!escape_set) dialect.escape = dialect.quote;
+    if (dialect.quote != '\0' && dialect.quote == dialect.delimiter) {
+        log_message(LOG_ERROR, "Error: The quote character cannot be the delimiter\n");
+        return 1;
+    }
+
+    if (shard_size > 0 && shard_count > 0) {
+        log_message(LOG_ERROR, "Error: Use either --shard-size or --shards, not both\n");
+        return 1;
+    }
+
+    // Server mode takes its rows from each request instead of a CSV file
+    if (serve_port > 0) {
+        return run_label_server(config_filename, serve_port, &compression, &dialect);
+    }
+
     // Validate we have required arguments
     if (!csv_filename && !validate_only) {
-        fprintf(stderr, "Error: CSV file is required\n");
+        log_message(LOG_ERROR, "Error: CSV file is required\n");
         print_help(argv[0]);
         return 1;
     }
@@ -133,256 +323,213 @@ int main(int argc, char **argv) {
         return validate_config_only(config_filename);
     }
     
-    srand((unsigned int)time(NULL));
-    
-    // Parse CSV
-    CSVData *csv = parse_csv(csv_filename);
-    if (!csv) {
-        fprintf(stderr, "Failed to parse CSV file: %s\n", csv_filename);
-        return 1;
-    }
-    
-    printf("Loaded CSV '%s' with %d fields and %d rows\n", csv_filename, csv->field_count, csv->row_count);
-    printf("Using config: %s\n", config_filename);
-    printf("Output file: %s\n", output_filename);
-    
-    // Load and parse config
-    FILE *f = fopen(config_filename, "rb");
-    if (!f) {
-        fprintf(stderr, "Cannot open config file: %s\n", config_filename);
-        free_csv_data(csv);
+    uint64_t hex_seed = hex_code_seed((uint64_t)time(NULL));
+    atexit(log_flush);
+
+    if (show_stats && stats_start(stats_rows_filename) != 0) {
         return 1;
     }
     
-    fseek(f, 0, SEEK_END);
-    long size = ftell(f);
-    if (size > MAX_CONFIG_SIZE) {
-        fprintf(stderr, "Error: Config file too large: %ld bytes (max: %d)\n", size, MAX_CONFIG_SIZE);
-        fclose(f);
-        free_csv_data(csv);
-        return 1;
+    // -r is one more range; rows are picked while the CSV is read
+    if (specific_row >= 0) {
+        if (selection.range_count >= MAX_ROW_RANGES) {
+            log_message(LOG_ERROR, "Error: Too many row ranges, up to %d\n", MAX_ROW_RANGES);
+            return 1;
+        }
+        CSVRowRange *range = &selection.ranges[selection.range_count++];
+        range->start = range->end = specific_row;
+        range->step = 1;
     }
-    rewind(f);
-    
-    char *data = (char*)malloc(size + 1);
-    if (!data) {
-        fprintf(stderr, "Memory allocation error\n");
-        fclose(f);
-        free_csv_data(csv);
+
+    // Stdin and --stream read rows as they arrive, unless the whole file is
+    // needed up front to split it into shards
+    int stream_rows = shard_size == 0 && shard_count == 0 &&
+                      (streaming || strcmp(csv_filename, "-") == 0);
+
+    // Parse CSV
+    STATS_START(csv_start);
+    CSVData *csv = stream_rows ? open_csv_stream(csv_filename, &dialect, &selection)
+                               : parse_csv(csv_filename, &dialect, columnar, &selection);
+    STATS_STOP(STAT_CSV, csv_start);
+    if (!csv) {
+        log_message(LOG_ERROR, "Failed to parse CSV file: %s\n", csv_filename);
         return 1;
     }
     
-    size_t read_size = fread(data, 1, size, f);
-    if (read_size != (size_t)size) {
-        fprintf(stderr, "Error reading config file\n");
-        free(data);
-        fclose(f);
-        free_csv_data(csv);
-        return 1;
+    if (stream_rows) {
+        log_message(LOG_INFO, "Streaming CSV '%s' with %d fields\n", csv_filename, csv->field_count);
+    } else {
+        log_message(LOG_INFO, "Loaded CSV '%s' with %d fields and %d rows\n", csv_filename, csv->field_count, csv->row_count);
+        if (csv->selecting && csv->row_count == 0) {
+            log_message(LOG_ERROR, "Error: No CSV rows match -r, --rows or --where\n");
+            free_csv_data(csv);
+            return 1;
+        }
     }
+    log_message(LOG_INFO, "Using config: %s\n", config_filename);
+    log_message(LOG_INFO, "Output file: %s\n", output_filename);
     
-    data[size] = '\0';
-    fclose(f);
-
-    cJSON *root = cJSON_Parse(data);
-    free(data);
-    
+    // Load and parse config
+    STATS_START(config_start);
+    cJSON *root = load_json_config(config_filename);
+    STATS_STOP(STAT_CONFIG, config_start);
     if (!root) {
-        const char *error_ptr = cJSON_GetErrorPtr();
-        if (error_ptr) {
-            fprintf(stderr, "Error parsing JSON config file '%s' before: %s\n", config_filename, error_ptr);
-        }
         free_csv_data(csv);
         return 1;
     }
 
-    if (validate_json_config(root) != 0) {
-        fprintf(stderr, "Invalid JSON configuration in '%s'\n", config_filename);
+    FontConfig font_config;
+    HPDF_Doc pdf = create_label_doc(root, &font_config, &compression);
+    if (!pdf) {
+        log_message(LOG_ERROR, "Error creating PDF\n");
         free_csv_data(csv);
         cJSON_Delete(root);
         return 1;
     }
 
-    PageConfig page_config;
-    if (load_page_config_from_json(root, &page_config) != 0) {
-        fprintf(stderr, "Error loading page config from JSON, using defaults\n");
-        page_config.size = HPDF_PAGE_SIZE_A4;
-        page_config.orientation = HPDF_PAGE_LANDSCAPE;
-        page_config.line_width = 3.0f;
-    }
-
-    HPDF_Doc pdf = HPDF_New(error_handler, NULL);
-    if (!pdf) {
-        fprintf(stderr, "Error creating PDF\n");
+    // Compile the template once, every row only binds its values
+    LabelTemplate tpl;
+    STATS_START(template_start);
+    int compiled = compile_template(root, csv, &font_config, &tpl);
+    STATS_STOP(STAT_TEMPLATE, template_start);
+    if (compiled != 0) {
+        log_message(LOG_ERROR, "Invalid template in '%s'\n", config_filename);
+        HPDF_Free(pdf);
+        free_font_config(&font_config);
         free_csv_data(csv);
         cJSON_Delete(root);
         return 1;
     }
-    HPDF_UseUTFEncodings(pdf);
-
-    HPDF_SetCompressionMode(pdf, HPDF_COMP_ALL);
-
-    FontConfig font_config;
-    if (load_fonts_from_json(root, &font_config, pdf) != 0) {
-        fprintf(stderr, "Warning: Could not load font configuration, using defaults\n");
-        safe_strncpy(font_config.default_font, "Helvetica-Bold", sizeof(font_config.default_font));
-        font_config.custom_fonts = NULL;
-        font_config.custom_font_count = 0;
-    }
 
     // Determine which rows to process
     int start_row = 0;
     int end_row = csv->row_count - 1;
     
-    if (specific_row >= 0) {
-        start_row = specific_row;
-        if (start_row >= csv->row_count) {
-            fprintf(stderr, "Warning: Row %d is beyond CSV row count (%d), using last row\n", 
-                    specific_row, csv->row_count - 1);
-            start_row = csv->row_count - 1;
-        }
-        end_row = start_row;
-        printf("Processing row %d only\n", start_row);
+    if (stream_rows) {
+        log_message(LOG_INFO, "Processing rows as they are read\n");
+    } else if (csv->selecting) {
+        log_message(LOG_INFO, "Processing %d selected rows\n", csv->row_count);
     } else {
-        printf("Processing all %d rows\n", csv->row_count);
+        log_message(LOG_INFO, "Processing all %d rows\n", csv->row_count);
     }
 
-    for (int row_index = start_row; row_index <= end_row; row_index++) {
-        char hex_code[HEX_LENGTH + 1];
-        generate_hex_code(hex_code, HEX_LENGTH);
-
-        Field *fields = NULL;
-        int field_count = 0;
-        if (load_fields_from_json(root, &fields, &field_count, hex_code, csv, row_index) != 0) {
-            fprintf(stderr, "Error loading fields from JSON for row %d\n", row_index);
-            continue;
-        }
-
-        LineEntry *lines = NULL;
-        int line_count = 0;
-        if (load_lines_from_json(root, &lines, &line_count) != 0) {
-            fprintf(stderr, "Error loading lines from JSON\n");
-            free(fields);
-            continue;
-        }
-
-        // Load QR code configuration (optional)
-        QRCodeEntry qr_code;
-        if (load_qr_from_json(root, &qr_code, hex_code, csv, row_index) != 0) {
-            fprintf(stderr, "Error loading QR code configuration\n");
-            // Initialize with disabled state
-            qr_code.enabled = 0;
-        }
-
-        HPDF_Page page = HPDF_AddPage(pdf);
-        if (!page) {
-            fprintf(stderr, "Error creating PDF page\n");
-            free(fields);
-            free(lines);
-            continue;
-        }
-        
-        HPDF_Page_SetSize(page, page_config.size, page_config.orientation);
-        HPDF_Page_SetLineWidth(page, page_config.line_width);
-
-        for (int i = 0; i < line_count; ++i) {
-            // Set individual line width BEFORE drawing each line
-            HPDF_Page_SetLineWidth(page, lines[i].width);
-            
-            if (lines[i].type == LINE_H_TRANSFORM) {
-                float y_pos = lines[i].y;
-                HPDF_Page_MoveTo(page, lines[i].x_start, y_pos);
-                HPDF_Page_LineTo(page, lines[i].x_end, y_pos);
-                HPDF_Page_Stroke(page);
-            } else {
-                HPDF_Page_MoveTo(page, lines[i].x_start, lines[i].y_start);
-                HPDF_Page_LineTo(page, lines[i].x_end, lines[i].y_end);
-                HPDF_Page_Stroke(page);
-            }
+    // Sharded output: every shard renders into its own document and file
+    if (shard_size > 0 || shard_count > 0) {
+        HPDF_Free(pdf);
+
+        ShardJob *jobs = NULL;
+        int job_count = plan_shards(output_filename, start_row, end_row, shard_size, shard_count, &jobs);
+        if (job_count <= 0) {
+            log_message(LOG_ERROR, "Error planning shards for: %s\n", output_filename);
+            free_template(&tpl);
+            free_font_config(&font_config);
+            free_csv_data(csv);
+            cJSON_Delete(root);
+            return 1;
         }
-        // Draw QR code only if enabled and has text
-        if (qr_code.enabled && strlen(qr_code.text) > 0) {
-            draw_qr_code(page, qr_code.x, qr_code.y, qr_code.size, qr_code.text);
-        }       
 
-        BarcodeEntry *barcodes = NULL;
-        int barcode_count = 0;
-        if (load_barcodes_from_json(root, &barcodes, &barcode_count, hex_code, csv, row_index) == 0) {
-            for (int i = 0; i < barcode_count; ++i) {
-                draw_barcode_entry(page, &barcodes[i]);
-            }
-            free(barcodes);
-        }
-
-
-        for (int i = 0; i < field_count; ++i) {
-            float fx0 = fields[i].x_start;
-            float fx1 = fields[i].x_end;
-            float fy0 = fields[i].y_start;
-            float fy1 = fields[i].y_end;
-
-            // Validate coordinates
-            if (fx1 <= fx0 || fy1 <= fy0) continue;
-
-            HPDF_Font field_font;
-            if (strlen(fields[i].font_name) > 0) {
-                int found = 0;
-                for (int j = 0; j < font_config.custom_font_count; j++) {
-                    if (strcmp(font_config.custom_fonts[j].name, fields[i].font_name) == 0) {
-                        field_font = HPDF_GetFont(pdf, font_config.custom_fonts[j].name, "WinAnsiEncoding");
-                        found = 1;
-                        break;
-                    }
-                }
-                if (!found) {
-                    field_font = HPDF_GetFont(pdf, fields[i].font_name, "WinAnsiEncoding");
-                }
-            } else {
-                field_font = HPDF_GetFont(pdf, font_config.default_font, "WinAnsiEncoding");
-            }
+        int workers = threads_set ? threads : default_thread_count();
+        if (workers > job_count) workers = job_count;
+        log_message(LOG_INFO, "Rendering %d shards on %d threads\n", job_count, workers);
 
-            if (!field_font) {
-                field_font = HPDF_GetFont(pdf, font_config.default_font, "WinAnsiEncoding");
-                if (!field_font) continue;
-            }
+        progress_start(end_row - start_row + 1);
+        int generated = render_shards(root, &tpl, csv, jobs, job_count, workers, streaming,
+                                      &compression, hex_seed);
+        int failed = 0;
+        for (int i = 0; i < job_count; i++) {
+            if (jobs[i].generated < 0) failed++;
+        }
+        log_finish();
+        write_shard_manifest(output_filename, csv, jobs, job_count);
 
-            if (fields[i].wrap) {
-                draw_text_in_box(page, field_font, fx0, fx1, fy0, fy1, 
-                               fields[i].text, fields[i].font_size, fields[i].align);
-            } else {
-                HPDF_Page_BeginText(page);
-                HPDF_Page_SetFontAndSize(page, field_font, fields[i].font_size);
-                float x_offset = fx0 + 5.0f;
-                if (fields[i].align == 1) {
-                    float lw = HPDF_Page_TextWidth(page, fields[i].text);
-                    float boxw = fields[i].x_end - fields[i].x_start - 10.0f;
-                    x_offset = fx0 + (boxw - lw) / 2.0f;
-                } else if (fields[i].align == 2) {
-                    float lw = HPDF_Page_TextWidth(page, fields[i].text);
-                    x_offset = fx1 - lw - 5.0f;
-                }
-                HPDF_Page_TextOut(page, x_offset, fy1 - fields[i].font_size - 5.0f, fields[i].text);
-                HPDF_Page_EndText(page);
-            }
+        if (failed > 0) {
+            log_message(LOG_ERROR, "Error: %d of %d shards failed\n", failed, job_count);
+        } else {
+            log_message(LOG_INFO, "Successfully generated: %d shards with %d labels\n", job_count, generated);
         }
 
-        free(fields);
-        free(lines);
-        
-        printf("Generated label for row %d\n", row_index);
-    }  
+        log_flush();
+        stats_print_summary();
+        stats_finish();
+
+        free(jobs);
+        free_template(&tpl);
+        free_font_config(&font_config);
+        free_csv_data(csv);
+        cJSON_Delete(root);
+        return failed > 0 ? 1 : 0;
+    }
+
+    RenderContext render_ctx;
+    if (render_context_init(&render_ctx, pdf, &tpl) != 0) {
+        log_message(LOG_ERROR, "Memory allocation error\n");
+        HPDF_Free(pdf);
+        free_template(&tpl);
+        free_font_config(&font_config);
+        free_csv_data(csv);
+        cJSON_Delete(root);
+        return 1;
+    }
 
-    if (HPDF_SaveToFile(pdf, output_filename) != HPDF_OK) {
-        fprintf(stderr, "Error saving PDF to: %s\n", output_filename);
+    render_ctx.hex_state = hex_seed;
+
+    // Streaming writes the header now and every page as it is finished
+    if (streaming) {
+        if (HPDF_BeginStreamingSave(pdf, output_filename) != HPDF_OK) {
+            log_message(LOG_ERROR, "Error opening PDF output: %s\n", output_filename);
+            HPDF_Free(pdf);
+            render_context_free(&render_ctx);
+            free_template(&tpl);
+            free_font_config(&font_config);
+            free_csv_data(csv);
+            cJSON_Delete(root);
+            return 1;
+        }
+        render_ctx.streaming = 1;
+        log_message(LOG_INFO, "Streaming pages to: %s\n", output_filename);
+    }
+
+    // With more than one thread, pages are also deflated as they are finished
+    // instead of all at once while saving
+    render_ctx.compression = compression;
+    if (threads > 1) {
+        log_message(LOG_INFO, "Rendering with %d threads\n", threads);
+        if (compression.level != COMPRESSION_NONE && start_page_compression(&render_ctx, threads) != 0) {
+            log_message(LOG_WARNING, "Warning: Could not start page compression threads, compressing while saving\n");
+        }
+    }
+    progress_start(stream_rows ? -1 : end_row - start_row + 1);
+    int read_failed = 0;
+    int generated = stream_rows ? render_csv_stream(&render_ctx, csv, threads, &read_failed)
+                                : render_rows(&render_ctx, csv, start_row, end_row, threads);
+    generated -= finish_page_compression(&render_ctx);
+    log_finish();
+
+    STATS_START(save_start);
+    HPDF_STATUS saved = streaming ? HPDF_EndStreamingSave(pdf)
+                                  : HPDF_SaveToFile(pdf, output_filename);
+    STATS_STOP(STAT_SAVE, save_start);
+    if (saved != HPDF_OK) {
+        log_message(LOG_ERROR, "Error saving PDF to: %s\n", output_filename);
+    } else if (read_failed) {
+        log_message(LOG_ERROR, "Error: The CSV input could not be read to the end, %s has only the %d labels before the error\n",
+                    output_filename, generated);
     } else {
-        printf("Successfully generated: %s with %d labels\n", output_filename, (end_row - start_row + 1));
+        log_message(LOG_INFO, "Successfully generated: %s with %d labels\n", output_filename, generated);
     }
 
-    HPDF_Free(pdf);
-    if (font_config.custom_fonts) {
-        free(font_config.custom_fonts);
+    log_flush();
+    if (show_stats) {
+        stats_doc_saved(pdf);
+        stats_print_summary();
     }
+    stats_finish();
+
+    HPDF_Free(pdf);
+    render_context_free(&render_ctx);
+    free_template(&tpl);
+    free_font_config(&font_config);
     free_csv_data(csv);
     cJSON_Delete(root);
-    return 0;
+    return read_failed ? 1 : 0;
 }
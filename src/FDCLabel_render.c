@@ -0,0 +1,1020 @@
+/* FDCLabel_render.c Fast Dynamic C Label Generator
+ *
+ * Copyright (C) Ivan Rolero
+ *
+ * This file is part of FDCLabel.
+ *
+ * FDCLabel is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FDCLabel is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <pthread.h>
+#include "hpdf.h"
+#include "qrcodegen.h"
+#include "barcodes.h"
+#include "utils.h"
+
+static int layout_background(const RenderContext *ctx, LabelLayout *layout);
+
+/* ---------- Image Cache ---------- */
+
+// Slot for a key in a direct-mapped cache of IMAGE_CACHE_SIZE entries
+static ImageCacheEntry* image_cache_slot(ImageCacheEntry *cache, const uint8_t *key, size_t len) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        hash = (hash ^ key[i]) * 16777619u;
+    }
+    return &cache[hash % IMAGE_CACHE_SIZE];
+}
+
+static HPDF_Image image_cache_find(const ImageCacheEntry *entry, const uint8_t *key, size_t len) {
+    if (entry->image && entry->key_len == len && memcmp(entry->key, key, len) == 0) {
+        return entry->image;
+    }
+    return NULL;
+}
+
+// Replace the entry, the previous image stays in the document
+static void image_cache_store(ImageCacheEntry *entry, const uint8_t *key, size_t len, HPDF_Image image) {
+    if (entry->key_len < len || !entry->key) {
+        uint8_t *grown = realloc(entry->key, len);
+        if (!grown) {
+            entry->image = NULL;
+            return;
+        }
+        entry->key = grown;
+    }
+    memcpy(entry->key, key, len);
+    entry->key_len = len;
+    entry->image = image;
+}
+
+static void image_cache_free(ImageCacheEntry *cache) {
+    if (!cache) return;
+    for (int i = 0; i < IMAGE_CACHE_SIZE; i++) {
+        free(cache[i].key);
+    }
+    free(cache);
+}
+
+/* ---------- Render Context ---------- */
+
+int render_context_init(RenderContext *ctx, HPDF_Doc pdf, const LabelTemplate *tpl) {
+    if (!ctx || !pdf || !tpl) return -1;
+
+    ctx->pdf = pdf;
+    ctx->tpl = tpl;
+    ctx->streaming = 0;
+    ctx->background = NULL;
+    ctx->qr_images = NULL;
+    ctx->barcode_images = NULL;
+    ctx->compression.level = HPDF_COMP_LEVEL_DEFAULT;
+    ctx->compression.strategy = HPDF_COMP_STRATEGY_DEFAULT;
+    ctx->compressor = NULL;
+    ctx->hex_state = hex_code_seed((uint64_t)time(NULL));
+    memset(&ctx->background_layout, 0, sizeof(ctx->background_layout));
+    ctx->fonts = calloc(tpl->font_count > 0 ? tpl->font_count : 1, sizeof(FontMetrics));
+    ctx->font_count = tpl->font_count;
+    ctx->field_fonts = calloc(tpl->field_count > 0 ? tpl->field_count : 1, sizeof(FontMetrics*));
+    if (!ctx->fonts || !ctx->field_fonts) {
+        render_context_free(ctx);
+        return -1;
+    }
+
+    // Each distinct font of the template is looked up once per document, and
+    // gets the advance table layout workers measure with
+    for (int f = 0; f < tpl->font_count; f++) {
+        HPDF_Font font = HPDF_GetFont(pdf, tpl->font_names[f], "WinAnsiEncoding");
+        if (!font && strcmp(tpl->font_names[f], tpl->default_font) != 0) {
+            font = HPDF_GetFont(pdf, tpl->default_font, "WinAnsiEncoding");
+        }
+        font_metrics_init(&ctx->fonts[f], font);
+    }
+
+    for (int i = 0; i < tpl->field_count; i++) {
+        FontMetrics *metrics = &ctx->fonts[tpl->fields[i].font];
+        ctx->field_fonts[i] = metrics->font ? metrics : NULL;
+    }
+
+    // Lines and static text are the same on every label: lay them out once
+    // and draw them as a single Form XObject referenced by each page
+    ctx->use_background = tpl->line_count > 0;
+    for (int i = 0; i < tpl->field_count; i++) {
+        if (tpl->fields[i].text.source == TEXT_STATIC) ctx->use_background = 1;
+    }
+    if (ctx->use_background && layout_background(ctx, &ctx->background_layout) != 0) {
+        render_context_free(ctx);
+        return -1;
+    }
+
+    if (tpl->qr.enabled && tpl->qr.image) {
+        ctx->qr_images = calloc(IMAGE_CACHE_SIZE, sizeof(ImageCacheEntry));
+        if (!ctx->qr_images) {
+            render_context_free(ctx);
+            return -1;
+        }
+    }
+    for (int i = 0; i < tpl->barcode_count && !ctx->barcode_images; i++) {
+        if (!tpl->barcodes[i].image) continue;
+        ctx->barcode_images = calloc(IMAGE_CACHE_SIZE, sizeof(ImageCacheEntry));
+        if (!ctx->barcode_images) {
+            render_context_free(ctx);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+void render_context_free(RenderContext *ctx) {
+    if (!ctx) return;
+    free(ctx->field_fonts);
+    ctx->field_fonts = NULL;
+    free(ctx->fonts);
+    ctx->fonts = NULL;
+    ctx->font_count = 0;
+    layout_free(&ctx->background_layout);
+    ctx->background = NULL;     // owned by the document
+    image_cache_free(ctx->qr_images);
+    ctx->qr_images = NULL;
+    image_cache_free(ctx->barcode_images);
+    ctx->barcode_images = NULL;
+}
+
+/* ---------- Label Layout ---------- */
+
+void layout_reset(LabelLayout *layout) {
+    layout->row_index = -1;
+    layout->hex_code[0] = '\0';
+    layout->has_qr = 0;
+    layout->barcode_count = 0;
+    layout->block_count = 0;
+    layout->run_count = 0;
+    layout->strings_len = 0;
+    layout->stats.layout_ns = 0;
+    layout->stats.glyphs = 0;
+}
+
+void layout_free(LabelLayout *layout) {
+    if (!layout) return;
+    free(layout->barcodes);
+    free(layout->blocks);
+    free(layout->runs);
+    free(layout->strings);
+    memset(layout, 0, sizeof(*layout));
+}
+
+size_t layout_add_string(LabelLayout *layout, const char *text, size_t len) {
+    if (layout->strings_len + len + 1 > layout->strings_cap) {
+        size_t cap = layout->strings_cap ? layout->strings_cap : 1024;
+        while (layout->strings_len + len + 1 > cap) cap *= 2;
+
+        char *grown = realloc(layout->strings, cap);
+        if (!grown) return (size_t)-1;
+        layout->strings = grown;
+        layout->strings_cap = cap;
+    }
+
+    size_t offset = layout->strings_len;
+    memcpy(layout->strings + offset, text, len);
+    layout->strings[offset + len] = '\0';
+    layout->strings_len += len + 1;
+    return offset;
+}
+
+int layout_add_run(LabelLayout *layout, float x, float y, size_t text) {
+    if (text == (size_t)-1) return -1;
+
+    if (layout->run_count >= layout->run_capacity) {
+        int cap = layout->run_capacity ? layout->run_capacity * 2 : 32;
+        TextRun *grown = realloc(layout->runs, cap * sizeof(TextRun));
+        if (!grown) return -1;
+        layout->runs = grown;
+        layout->run_capacity = cap;
+    }
+
+    TextRun *run = &layout->runs[layout->run_count++];
+    run->x = x;
+    run->y = y;
+    run->text = text;
+    return 0;
+}
+
+static TextBlock* layout_add_block(LabelLayout *layout) {
+    if (layout->block_count >= layout->block_capacity) {
+        int cap = layout->block_capacity ? layout->block_capacity * 2 : 16;
+        TextBlock *grown = realloc(layout->blocks, cap * sizeof(TextBlock));
+        if (!grown) return NULL;
+        layout->blocks = grown;
+        layout->block_capacity = cap;
+    }
+
+    TextBlock *block = &layout->blocks[layout->block_count++];
+    memset(block, 0, sizeof(*block));
+    block->first_run = layout->run_count;
+    return block;
+}
+
+// Bind one template field and break it into positioned text runs
+static int layout_field(const RenderContext *ctx, int index, const CSVRow *row,
+                        LabelLayout *layout) {
+    const TemplateField *field = &ctx->tpl->fields[index];
+    const FontMetrics *font = ctx->field_fonts[index];
+    char text[MAX_TEXT_LEN];
+    if (!font) return 0;
+
+    int truncated = 0;
+    size_t value_len;
+    const char *value = bind_template_text(&field->text, row, layout->hex_code, field->max_length,
+                                           text, sizeof(text), &truncated, &value_len);
+
+    TextBlock *block = layout_add_block(layout);
+    if (!block) return -1;
+    block->font = font->font;
+    block->field = index;
+    block->truncated = truncated;
+
+    if (field->wrap) {
+        block->font_size = layout_text_in_box(layout, font, field->x_start, field->x_end,
+                                              field->y_start, field->y_end,
+                                              value, field->font_size, field->align);
+    } else {
+        block->font_size = field->font_size;
+        float x_offset = field->x_start + 5.0f;
+        if (field->align != 0) layout->stats.glyphs += (uint32_t)value_len;
+        if (field->align == 1) {
+            float lw = metrics_text_width(font, field->font_size, value, value_len);
+            float boxw = field->x_end - field->x_start - 10.0f;
+            x_offset = field->x_start + (boxw - lw) / 2.0f;
+        } else if (field->align == 2) {
+            float lw = metrics_text_width(font, field->font_size, value, value_len);
+            x_offset = field->x_end - lw - 5.0f;
+        }
+        if (layout_add_run(layout, x_offset, field->y_end - field->font_size - 5.0f,
+                           layout_add_string(layout, value, value_len)) != 0)
+            return -1;
+    }
+    block->run_count = layout->run_count - block->first_run;
+    return 0;
+}
+
+// Static fields only, the row-independent text of the background
+static int layout_background(const RenderContext *ctx, LabelLayout *layout) {
+    const LabelTemplate *tpl = ctx->tpl;
+
+    layout_reset(layout);
+    for (int i = 0; i < tpl->field_count; i++) {
+        if (tpl->fields[i].text.source != TEXT_STATIC) continue;
+        if (layout_field(ctx, i, NULL, layout) != 0) return -1;
+    }
+    return 0;
+}
+
+// Bind one row and compute every position on the label. Only reads the
+// document, so it can run on any thread. qr_cache may be NULL.
+int layout_label(const RenderContext *ctx, const CSVRow *row, int row_index,
+                 const char *hex_code, QRSymbolCache *qr_cache, LabelLayout *layout) {
+    const LabelTemplate *tpl = ctx->tpl;
+    char text[MAX_TEXT_LEN];
+    STATS_START(start);
+
+    layout_reset(layout);
+    layout->row_index = row_index;
+    if (hex_code) {
+        safe_strncpy(layout->hex_code, hex_code, sizeof(layout->hex_code));
+    }
+
+    if (tpl->qr.enabled) {
+        const char *qr_text = bind_template_text(&tpl->qr.text, row, layout->hex_code, 0,
+                                                 text, MAX_FIELD_LEN, NULL, NULL);
+
+        // Columnar rows share one pointer per distinct value, so a repeat
+        // of the value encoded last is found without comparing the text
+        const char *key = NULL;
+        if (qr_cache && row && row->interned && tpl->qr.text.source == TEXT_COLUMN &&
+            tpl->qr.text.column < row->count && qr_text == row->fields[tpl->qr.text.column]) {
+            key = qr_text;
+        }
+
+        if (key && key == qr_cache->key) {
+            layout->has_qr = qr_cache->encoded;
+            if (layout->has_qr) {
+                memcpy(layout->qr, qr_cache->qr, qrcodegen_BUFFER_LEN_MAX);
+            }
+        } else if (qr_text[0] != '\0') {
+            uint8_t tempBuffer[qrcodegen_BUFFER_LEN_MAX];
+            STATS_START(qr_start);
+            layout->has_qr = qrcodegen_encodeText(qr_text, tempBuffer, layout->qr, qrcodegen_Ecc_MEDIUM,
+                                                  qrcodegen_VERSION_MIN, qrcodegen_VERSION_MAX,
+                                                  qrcodegen_Mask_AUTO, true);
+            STATS_STOP(STAT_LAYOUT_QR, qr_start);
+            if (key) {
+                qr_cache->key = key;
+                qr_cache->encoded = layout->has_qr;
+                if (layout->has_qr) {
+                    memcpy(qr_cache->qr, layout->qr, qrcodegen_BUFFER_LEN_MAX);
+                }
+            }
+        }
+    }
+
+    if (tpl->barcode_count > 0 && !layout->barcodes) {
+        layout->barcodes = calloc(tpl->barcode_count, sizeof(BarcodeRun));
+        if (!layout->barcodes) return -1;
+    }
+    for (int i = 0; i < tpl->barcode_count; i++) {
+        const TemplateBarcode *bc = &tpl->barcodes[i];
+        size_t data_len;
+        const char *data = bind_template_text(&bc->text, row, layout->hex_code, 0,
+                                              text, sizeof(text), NULL, &data_len);
+
+        BarcodeRun *run = &layout->barcodes[layout->barcode_count++];
+        run->barcode = i;
+        run->valid = validate_barcode_data(bc->type, data);
+        run->text = layout_add_string(layout, data, data_len);
+        if (run->text == (size_t)-1) return -1;
+    }
+
+    STATS_START(text_start);
+    for (int i = 0; i < tpl->field_count; i++) {
+        if (ctx->use_background && tpl->fields[i].text.source == TEXT_STATIC) continue;
+        if (layout_field(ctx, i, row, layout) != 0) return -1;
+    }
+    STATS_STOP(STAT_LAYOUT_TEXT, text_start);
+
+    if (stats_enabled) {
+        layout->stats.layout_ns = stats_add_time(STAT_LAYOUT, start);
+        stats_add(STAT_ROWS, 1);
+        stats_add(STAT_GLYPHS, layout->stats.glyphs);
+    }
+    return 0;
+}
+
+/* ---------- Page Emission ---------- */
+
+static void emit_lines(const LabelTemplate *tpl, HPDF_Page page) {
+    for (int i = 0; i < tpl->line_count; ++i) {
+        const LineEntry *line = &tpl->lines[i];
+        // Set individual line width BEFORE drawing each line
+        HPDF_Page_SetLineWidth(page, line->width);
+
+        if (line->type == LINE_H_TRANSFORM) {
+            HPDF_Page_MoveTo(page, line->x_start, line->y);
+            HPDF_Page_LineTo(page, line->x_end, line->y);
+        } else {
+            HPDF_Page_MoveTo(page, line->x_start, line->y_start);
+            HPDF_Page_LineTo(page, line->x_end, line->y_end);
+        }
+        HPDF_Page_Stroke(page);
+    }
+}
+
+static void emit_text_blocks(const LabelTemplate *tpl, HPDF_Page page, const LabelLayout *layout) {
+    for (int i = 0; i < layout->block_count; i++) {
+        const TextBlock *block = &layout->blocks[i];
+
+        if (block->truncated) {
+            log_truncated_field(tpl->fields[block->field].text.text + 1, layout->row_index);
+        }
+        if (block->font_size <= 0) continue;
+
+        HPDF_Page_BeginText(page);
+        HPDF_Page_SetFontAndSize(page, block->font, block->font_size);
+        for (int r = block->first_run; r < block->first_run + block->run_count; r++) {
+            const TextRun *run = &layout->runs[r];
+            HPDF_Page_TextOut(page, run->x, run->y, layout->strings + run->text);
+        }
+        HPDF_Page_EndText(page);
+    }
+}
+
+// Draw a QR symbol as an image mask, shared by every page with the same code.
+// Falls back to paths when images are off or cannot be created.
+static void emit_qr(RenderContext *ctx, HPDF_Page page, const uint8_t *qrcode) {
+    const TemplateQR *qr = &ctx->tpl->qr;
+
+    if (ctx->qr_images) {
+        int qr_size = qrcodegen_getSize(qrcode);
+        size_t len = 1 + ((size_t)qr_size * qr_size + 7) / 8;
+
+        ImageCacheEntry *entry = image_cache_slot(ctx->qr_images, qrcode, len);
+        HPDF_Image image = image_cache_find(entry, qrcode, len);
+        if (!image) {
+            image = create_qr_image(ctx->pdf, qrcode);
+            if (image) image_cache_store(entry, qrcode, len, image);
+        }
+
+        if (image) {
+            HPDF_Page_DrawImage(page, image, qr->x, qr->y, qr->size, qr->size);
+            return;
+        }
+    }
+
+    draw_qr_modules(page, qr->x, qr->y, qr->size, qrcode);
+}
+
+// Barcodes in image mode are one row images stretched to the bar height,
+// shared by every page with the same bar pattern
+static void emit_barcode(RenderContext *ctx, HPDF_Page page, const TemplateBarcode *bc,
+                         const char *data) {
+    if (bc->image && ctx->barcode_images) {
+        unsigned char modules[BARCODE_MAX_MODULES];
+        int width_modules;
+        int count = barcode_modules(bc->type, data, modules, BARCODE_MAX_MODULES, &width_modules);
+        if (count == 0) return;
+
+        ImageCacheEntry *entry = image_cache_slot(ctx->barcode_images, modules, count);
+        HPDF_Image image = image_cache_find(entry, modules, count);
+        if (!image) {
+            image = create_barcode_image(ctx->pdf, modules, count);
+            if (image) image_cache_store(entry, modules, count, image);
+        }
+
+        if (image) {
+            HPDF_Page_DrawImage(page, image, bc->x, bc->y,
+                                bc->width * count / width_modules, bc->height);
+            return;
+        }
+    }
+
+    draw_barcode(page, bc->x, bc->y, bc->width, bc->height, bc->type, data);
+}
+
+// Record the lines and static fields once into a Form XObject of the page size
+static HPDF_XObject build_background(const RenderContext *ctx, HPDF_Page page) {
+    HPDF_Rect bbox = { 0, 0, HPDF_Page_GetWidth(page), HPDF_Page_GetHeight(page) };
+
+    HPDF_XObject form = HPDF_Page_BeginFormXObject(ctx->pdf, page, bbox);
+    if (!form) return NULL;
+
+    HPDF_Page_SetLineWidth(page, ctx->tpl->page.line_width);
+    emit_lines(ctx->tpl, page);
+    emit_text_blocks(ctx->tpl, page, &ctx->background_layout);
+
+    if (HPDF_Page_EndFormXObject(page) != HPDF_OK) return NULL;
+    return form;
+}
+
+// Write a laid out label to its page. Must run on the thread owning the document.
+void emit_label(RenderContext *ctx, HPDF_Page page, const LabelLayout *layout) {
+    const LabelTemplate *tpl = ctx->tpl;
+
+    HPDF_Page_SetSize(page, tpl->page.size, tpl->page.orientation);
+    HPDF_Page_SetLineWidth(page, tpl->page.line_width);
+
+    // A failed background stays in the static layout and is drawn on every page
+    if (ctx->use_background == 1 && !ctx->background) {
+        ctx->background = build_background(ctx, page);
+        if (!ctx->background) {
+            log_message(LOG_WARNING, "Warning: Could not create page background, drawing it on every page\n");
+            ctx->use_background = -1;
+        }
+    }
+
+    // The background also holds the static fields left out of the layout
+    if (ctx->background) {
+        HPDF_Page_ExecuteXObject(page, ctx->background);
+    } else {
+        emit_lines(tpl, page);
+        emit_text_blocks(tpl, page, &ctx->background_layout);
+    }
+
+    if (layout->has_qr) {
+        STATS_START(qr_start);
+        emit_qr(ctx, page, layout->qr);
+        STATS_STOP(STAT_EMIT_QR, qr_start);
+    }
+
+    STATS_START(barcode_start);
+    for (int i = 0; i < layout->barcode_count; i++) {
+        const BarcodeRun *run = &layout->barcodes[i];
+        const TemplateBarcode *bc = &tpl->barcodes[run->barcode];
+        const char *data = layout->strings + run->text;
+
+        if (!run->valid) {
+            log_message(LOG_WARNING, "Warning: Invalid barcode data for type %s: %s\n", bc->type_name, data);
+            continue;
+        }
+        emit_barcode(ctx, page, bc, data);
+    }
+    if (layout->barcode_count > 0) STATS_STOP(STAT_EMIT_BARCODES, barcode_start);
+
+    STATS_START(text_start);
+    emit_text_blocks(tpl, page, layout);
+    STATS_STOP(STAT_EMIT_TEXT, text_start);
+}
+
+void render_label(RenderContext *ctx, HPDF_Page page, const CSVRow *row,
+                  int row_index, const char *hex_code) {
+    LabelLayout layout;
+    memset(&layout, 0, sizeof(layout));
+
+    if (layout_label(ctx, row, row_index, hex_code, NULL, &layout) == 0) {
+        emit_label(ctx, page, &layout);
+    } else {
+        log_message(LOG_ERROR, "Memory allocation error laying out row %d\n", row_index);
+    }
+    layout_free(&layout);
+}
+
+/* ---------- Page Compression ---------- */
+
+// Streaming output: write the finished page and drop its content stream
+static int finish_page(RenderContext *ctx, HPDF_Page page, int row_index) {
+    if (ctx->streaming) {
+        STATS_START(start);
+        HPDF_STATUS ret = HPDF_FlushPage(ctx->pdf, page);
+        STATS_STOP(STAT_SAVE, start);
+        if (ret != HPDF_OK) {
+            log_message(LOG_ERROR, "Error writing page for row %d\n", row_index);
+            return 0;
+        }
+    }
+
+    progress_add(1);
+    if (log_level >= LOG_VERBOSE) {
+        log_message(LOG_VERBOSE, "Generated label for row %d\n", row_index);
+    }
+    return 1;
+}
+
+// Finished pages wait in a ring, in page order, while workers deflate their
+// content streams. The document thread stores the results and finishes the
+// pages in the same order, so the save does no compression work for them.
+typedef struct {
+    HPDF_Page page;
+    int row_index;
+    HPDF_BYTE *buf;             // NULL: left for the save to compress
+    HPDF_UINT len;
+    HPDF_UINT raw_len;          // content size before deflating, for --stats
+    int state;                  // 1 queued, 2 deflated, -1 failed
+} PageCompressJob;
+
+struct PageCompressor {
+    PageCompressJob *jobs;
+    int job_count;
+    int head;                   // oldest page not finished yet
+    int tail;                   // pages submitted
+    int next_work;              // next page for a worker
+    int stop;
+    int failed;                 // pages that could not be finished
+    CompressionConfig compression;
+    pthread_t *workers;
+    int started;
+    pthread_mutex_t lock;
+    pthread_cond_t has_work;
+    pthread_cond_t job_done;
+};
+
+static void* compress_worker(void *arg) {
+    PageCompressor *c = (PageCompressor*)arg;
+
+    for (;;) {
+        pthread_mutex_lock(&c->lock);
+        while (!c->stop && c->next_work == c->tail) {
+            pthread_cond_wait(&c->has_work, &c->lock);
+        }
+        if (c->next_work == c->tail) {
+            pthread_mutex_unlock(&c->lock);
+            break;
+        }
+        PageCompressJob *job = &c->jobs[c->next_work++ % c->job_count];
+        pthread_mutex_unlock(&c->lock);
+
+        // Only the page's own content stream is read, never the document
+        STATS_START(start);
+        int ok = job->buf && HPDF_Page_DeflateContents(job->page, c->compression.level,
+                                                       c->compression.strategy,
+                                                       job->buf, &job->len) == HPDF_OK;
+        if (ok && stats_enabled) {
+            stats_add_time(STAT_DEFLATE, start);
+            stats_add(STAT_DEFLATE_IN, job->raw_len);
+            stats_add(STAT_DEFLATE_OUT, job->len);
+        }
+
+        pthread_mutex_lock(&c->lock);
+        job->state = ok ? 2 : -1;
+        pthread_cond_broadcast(&c->job_done);
+        pthread_mutex_unlock(&c->lock);
+    }
+
+    return NULL;
+}
+
+// Store the oldest page's compressed stream and finish the page. Returns 1
+// if a page was finished, 0 if it is not ready and wait is not set.
+static int finish_oldest_page(RenderContext *ctx, int wait) {
+    PageCompressor *c = ctx->compressor;
+    if (c->head == c->tail) return 0;
+
+    PageCompressJob *job = &c->jobs[c->head % c->job_count];
+    pthread_mutex_lock(&c->lock);
+    while (wait && job->state == 1) {
+        pthread_cond_wait(&c->job_done, &c->lock);
+    }
+    int state = job->state;
+    pthread_mutex_unlock(&c->lock);
+    if (state == 1) return 0;
+
+    // A page that was not deflated keeps its stream for the save to compress
+    if (state == 2 && HPDF_Page_SetDeflatedContents(job->page, job->buf, job->len) != HPDF_OK) {
+        log_message(LOG_WARNING, "Warning: Could not store compressed page for row %d\n", job->row_index);
+    }
+    free(job->buf);
+    job->buf = NULL;
+
+    if (!finish_page(ctx, job->page, job->row_index)) c->failed++;
+    c->head++;
+    return 1;
+}
+
+static void submit_page(RenderContext *ctx, HPDF_Page page, int row_index) {
+    PageCompressor *c = ctx->compressor;
+
+    while (c->tail - c->head >= c->job_count) {
+        finish_oldest_page(ctx, 1);
+    }
+
+    PageCompressJob *job = &c->jobs[c->tail % c->job_count];
+    HPDF_UINT bound = HPDF_Page_GetDeflateBound(page);
+    job->page = page;
+    job->row_index = row_index;
+    job->buf = bound > 0 ? malloc(bound) : NULL;
+    job->len = bound;
+    job->raw_len = stats_enabled ? HPDF_Page_GetContentsSize(page) : 0;
+    job->state = 1;
+
+    pthread_mutex_lock(&c->lock);
+    c->tail++;
+    pthread_cond_signal(&c->has_work);
+    pthread_mutex_unlock(&c->lock);
+
+    while (finish_oldest_page(ctx, 0)) {
+    }
+}
+
+// Deflate finished pages on `threads` workers until finish_page_compression
+int start_page_compression(RenderContext *ctx, int threads) {
+    if (!ctx || threads < 1 || ctx->compressor) return -1;
+
+    PageCompressor *c = calloc(1, sizeof(PageCompressor));
+    if (!c) return -1;
+    c->job_count = threads * RENDER_QUEUE_PER_THREAD;
+    c->jobs = calloc(c->job_count, sizeof(PageCompressJob));
+    c->workers = calloc(threads, sizeof(pthread_t));
+    c->compression = ctx->compression;
+    if (!c->jobs || !c->workers) {
+        free(c->jobs);
+        free(c->workers);
+        free(c);
+        return -1;
+    }
+
+    pthread_mutex_init(&c->lock, NULL);
+    pthread_cond_init(&c->has_work, NULL);
+    pthread_cond_init(&c->job_done, NULL);
+
+    for (int i = 0; i < threads; i++) {
+        if (pthread_create(&c->workers[i], NULL, compress_worker, c) != 0) break;
+        c->started++;
+    }
+
+    ctx->compressor = c;
+    if (c->started == 0) {
+        finish_page_compression(ctx);
+        return -1;
+    }
+    return 0;
+}
+
+// Finish every submitted page and stop the workers. Returns the number of
+// pages that could not be finished.
+int finish_page_compression(RenderContext *ctx) {
+    if (!ctx || !ctx->compressor) return 0;
+    PageCompressor *c = ctx->compressor;
+
+    if (c->started == 0) {
+        // Nobody to deflate: pages keep their streams for the save
+        for (int i = c->head; i < c->tail; i++) c->jobs[i % c->job_count].state = -1;
+    }
+    while (finish_oldest_page(ctx, 1)) {
+    }
+
+    pthread_mutex_lock(&c->lock);
+    c->stop = 1;
+    pthread_cond_broadcast(&c->has_work);
+    pthread_mutex_unlock(&c->lock);
+    for (int i = 0; i < c->started; i++) {
+        pthread_join(c->workers[i], NULL);
+    }
+
+    pthread_cond_destroy(&c->job_done);
+    pthread_cond_destroy(&c->has_work);
+    pthread_mutex_destroy(&c->lock);
+
+    int failed = c->failed;
+    free(c->jobs);
+    free(c->workers);
+    free(c);
+    ctx->compressor = NULL;
+    return failed;
+}
+
+/* ---------- Row Rendering ---------- */
+
+// Add a page for a finished layout, keeping the CSV order
+static int emit_page(RenderContext *ctx, const LabelLayout *layout) {
+    HPDF_Page page = HPDF_AddPage(ctx->pdf);
+    if (!page) {
+        log_message(LOG_ERROR, "Error creating PDF page\n");
+        return 0;
+    }
+
+    STATS_START(start);
+    emit_label(ctx, page, layout);
+    if (stats_enabled) {
+        uint64_t emit_ns = stats_add_time(STAT_EMIT, start);
+        stats_label(layout, emit_ns, HPDF_Page_GetOperatorCount(page),
+                    HPDF_Page_GetContentsSize(page));
+    }
+
+    // Pages being compressed are finished later, still in order
+    if (ctx->compressor) {
+        submit_page(ctx, page, layout->row_index);
+        return 1;
+    }
+    return finish_page(ctx, page, layout->row_index);
+}
+
+// Workers lay out labels into a ring of slots; the calling thread is the
+// only writer and appends pages strictly in row order. Rows come either
+// from a loaded CSVData or, one at a time, from a CSV stream.
+typedef struct {
+    const RenderContext *ctx;
+    const CSVData *csv;
+    CSVData *stream;
+    int start_row;
+    int total;                  // rows to render, lowered when a stream ends
+    LabelLayout *slots;
+    uint64_t *hex_state;        // the context's generator, drawn under lock
+    CSVRowBuffer *rows;         // per-slot streamed or columnar rows
+    int *slot_state;            // 0 free, 1 claimed, 2 ready, -1 failed
+    int slot_count;
+    int next_claim;
+    int next_emit;
+    int read_error;
+    pthread_mutex_t lock;
+    pthread_mutex_t read_lock;  // streamed rows are read in claim order
+    pthread_cond_t can_claim;
+    pthread_cond_t slot_done;
+} RenderPipeline;
+
+static void* render_worker(void *arg) {
+    RenderPipeline *p = (RenderPipeline*)arg;
+    QRSymbolCache qr_cache;
+    qr_cache.key = NULL;
+
+    for (;;) {
+        if (p->stream) pthread_mutex_lock(&p->read_lock);
+
+        pthread_mutex_lock(&p->lock);
+        while (p->next_claim < p->total && p->next_claim >= p->next_emit + p->slot_count) {
+            pthread_cond_wait(&p->can_claim, &p->lock);
+        }
+        if (p->next_claim >= p->total) {
+            pthread_mutex_unlock(&p->lock);
+            if (p->stream) pthread_mutex_unlock(&p->read_lock);
+            break;
+        }
+        int seq = p->next_claim++;
+        int slot = seq % p->slot_count;
+        p->slot_state[slot] = 1;
+
+        // Hex codes are drawn in claim order, which is row order
+        char hex_code[HEX_LENGTH + 1] = "";
+        if (p->ctx->tpl->uses_hex) {
+            generate_hex_code(p->hex_state, hex_code, HEX_LENGTH);
+        }
+        pthread_mutex_unlock(&p->lock);
+
+        int row_index = p->start_row + seq;
+        const CSVRow *row;
+        if (p->stream) {
+            const CSVRow *next = NULL;
+            int rc = read_csv_row(p->stream, &next);
+            if (rc == 1 && copy_csv_row(&p->rows[slot], next) != 0) rc = -1;
+            pthread_mutex_unlock(&p->read_lock);
+
+            if (rc != 1) {
+                // End of input: nothing at or after this sequence number
+                pthread_mutex_lock(&p->lock);
+                if (rc < 0) p->read_error = 1;
+                if (seq < p->total) p->total = seq;
+                p->slot_state[slot] = 0;
+                pthread_cond_broadcast(&p->slot_done);
+                pthread_cond_broadcast(&p->can_claim);
+                pthread_mutex_unlock(&p->lock);
+                break;
+            }
+            row = &p->rows[slot].row;
+        } else {
+            row = get_csv_row(p->csv, row_index, p->rows ? &p->rows[slot] : NULL);
+        }
+
+        // Labels are numbered by the row of the file they come from
+        p->slots[slot].row_index = row ? row->source_row : row_index;
+        int rc = row ? layout_label(p->ctx, row, row->source_row, hex_code, &qr_cache, &p->slots[slot]) : -1;
+
+        pthread_mutex_lock(&p->lock);
+        p->slot_state[slot] = rc == 0 ? 2 : -1;
+        pthread_cond_broadcast(&p->slot_done);
+        pthread_mutex_unlock(&p->lock);
+    }
+
+    return NULL;
+}
+
+static int render_rows_threaded(RenderContext *ctx, const CSVData *csv, CSVData *stream,
+                                int start_row, int total, int threads, int *read_failed) {
+    RenderPipeline p;
+    memset(&p, 0, sizeof(p));
+    p.ctx = ctx;
+    p.csv = csv;
+    p.stream = stream;
+    p.hex_state = &ctx->hex_state;
+    p.start_row = start_row;
+    p.total = total;
+    p.slot_count = threads * RENDER_QUEUE_PER_THREAD;
+    p.slots = calloc(p.slot_count, sizeof(LabelLayout));
+    int row_buffers = stream || csv->columns;
+    p.rows = row_buffers ? calloc(p.slot_count, sizeof(CSVRowBuffer)) : NULL;
+    p.slot_state = calloc(p.slot_count, sizeof(int));
+    pthread_t *workers = calloc(threads, sizeof(pthread_t));
+
+    if (!p.slots || !p.slot_state || !workers || (row_buffers && !p.rows)) {
+        log_message(LOG_ERROR, "Memory allocation error starting render threads\n");
+        free(p.slots);
+        free(p.rows);
+        free(p.slot_state);
+        free(workers);
+        return -1;
+    }
+
+    pthread_mutex_init(&p.lock, NULL);
+    pthread_mutex_init(&p.read_lock, NULL);
+    pthread_cond_init(&p.can_claim, NULL);
+    pthread_cond_init(&p.slot_done, NULL);
+
+    int started = 0;
+    for (int i = 0; i < threads; i++) {
+        if (pthread_create(&workers[i], NULL, render_worker, &p) != 0) break;
+        started++;
+    }
+    if (started < threads) {
+        log_message(LOG_WARNING, "Warning: Could only start %d of %d render threads\n", started, threads);
+    }
+
+    int generated = 0;
+    for (int seq = 0; started > 0; seq++) {
+        int slot = seq % p.slot_count;
+
+        pthread_mutex_lock(&p.lock);
+        while (seq < p.total && p.slot_state[slot] != 2 && p.slot_state[slot] != -1) {
+            pthread_cond_wait(&p.slot_done, &p.lock);
+        }
+        if (seq >= p.total) {
+            pthread_mutex_unlock(&p.lock);
+            break;
+        }
+        int state = p.slot_state[slot];
+        pthread_mutex_unlock(&p.lock);
+
+        if (state == 2) {
+            generated += emit_page(ctx, &p.slots[slot]);
+        } else {
+            log_message(LOG_ERROR, "Memory allocation error laying out row %d\n", p.slots[slot].row_index);
+        }
+
+        pthread_mutex_lock(&p.lock);
+        p.slot_state[slot] = 0;
+        p.next_emit++;
+        pthread_cond_broadcast(&p.can_claim);
+        pthread_mutex_unlock(&p.lock);
+    }
+
+    for (int i = 0; i < started; i++) {
+        pthread_join(workers[i], NULL);
+    }
+
+    if (p.read_error) {
+        log_message(LOG_ERROR, "Error reading CSV input\n");
+        if (read_failed) *read_failed = 1;
+    }
+
+    pthread_cond_destroy(&p.slot_done);
+    pthread_cond_destroy(&p.can_claim);
+    pthread_mutex_destroy(&p.read_lock);
+    pthread_mutex_destroy(&p.lock);
+
+    for (int i = 0; i < p.slot_count; i++) {
+        layout_free(&p.slots[i]);
+        if (p.rows) free_csv_row_buffer(&p.rows[i]);
+    }
+    free(p.slots);
+    free(p.rows);
+    free(p.slot_state);
+    free(workers);
+    return started > 0 ? generated : -1;
+}
+
+// Render rows [start_row, end_row] into ctx->pdf, one page per row in CSV order.
+// Returns the number of pages added.
+int render_rows(RenderContext *ctx, const CSVData *csv, int start_row, int end_row, int threads) {
+    if (!ctx || !csv || start_row < 0 || end_row < start_row) return 0;
+
+    if (threads > 1 && end_row > start_row) {
+        int generated = render_rows_threaded(ctx, csv, NULL, start_row, end_row - start_row + 1, threads, NULL);
+        if (generated >= 0) return generated;
+        // No worker could be started, render on this thread instead
+    }
+
+    LabelLayout layout;
+    CSVRowBuffer row_buffer;
+    QRSymbolCache qr_cache;
+    memset(&layout, 0, sizeof(layout));
+    memset(&row_buffer, 0, sizeof(row_buffer));
+    qr_cache.key = NULL;
+
+    int generated = 0;
+    for (int row_index = start_row; row_index <= end_row; row_index++) {
+        char hex_code[HEX_LENGTH + 1] = "";
+        if (ctx->tpl->uses_hex) {
+            generate_hex_code(&ctx->hex_state, hex_code, HEX_LENGTH);
+        }
+
+        const CSVRow *row = get_csv_row(csv, row_index, &row_buffer);
+        if (!row || layout_label(ctx, row, row->source_row, hex_code, &qr_cache, &layout) != 0) {
+            log_message(LOG_ERROR, "Memory allocation error laying out row %d\n",
+                        row ? row->source_row : row_index);
+            continue;
+        }
+        generated += emit_page(ctx, &layout);
+    }
+
+    layout_free(&layout);
+    free_csv_row_buffer(&row_buffer);
+    return generated;
+}
+
+// Render every row of a CSV stream as soon as it is read, until the end of
+// the input. Returns the number of pages added; *read_failed is set when a
+// row could not be read or copied, so the input ended early.
+int render_csv_stream(RenderContext *ctx, CSVData *csv, int threads, int *read_failed) {
+    if (!ctx || !csv || !csv->stream) return 0;
+
+    if (threads > 1) {
+        int generated = render_rows_threaded(ctx, NULL, csv, 0, INT_MAX, threads, read_failed);
+        if (generated >= 0) return generated;
+    }
+
+    LabelLayout layout;
+    memset(&layout, 0, sizeof(layout));
+
+    int generated = 0;
+    const CSVRow *row;
+    int rc;
+    while ((rc = read_csv_row(csv, &row)) == 1) {
+        int row_index = row->source_row;
+        char hex_code[HEX_LENGTH + 1] = "";
+        if (ctx->tpl->uses_hex) {
+            generate_hex_code(&ctx->hex_state, hex_code, HEX_LENGTH);
+        }
+
+        if (layout_label(ctx, row, row_index, hex_code, NULL, &layout) != 0) {
+            log_message(LOG_ERROR, "Memory allocation error laying out row %d\n", row_index);
+            continue;
+        }
+        generated += emit_page(ctx, &layout);
+    }
+    if (rc < 0) {
+        log_message(LOG_ERROR, "Error reading CSV input\n");
+        if (read_failed) *read_failed = 1;
+    }
+
+    layout_free(&layout);
+    return generated;
+}
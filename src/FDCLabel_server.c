@@ -0,0 +1,452 @@
+/* FDCLabel_server.c Fast Dynamic C Label Generator
+ *
+ * Copyright (C) Ivan Rolero
+ *
+ * This file is part of FDCLabel.
+ *
+ * FDCLabel is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FDCLabel is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+typedef SOCKET server_socket;
+#define close_socket closesocket
+#else
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+typedef int server_socket;
+#define INVALID_SOCKET (-1)
+#define close_socket close
+#endif
+#include "cJSON.h"
+#include "hpdf.h"
+#include "utils.h"
+
+// A write to a client that has gone away must fail, not raise SIGPIPE
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+// Label server: a local HTTP endpoint that renders the CSV of each request
+// with a configuration loaded once. The parsed config, the compiled
+// template, and the document with its loaded fonts and encoders stay in
+// memory between jobs, so a request only pays for its own rows.
+//
+//   POST /labels    body: CSV header line and rows -> application/pdf
+//   GET  /health    -> "ok"
+//
+// Requests are served one at a time and every connection is closed after
+// its response.
+
+typedef struct {
+    cJSON *root;
+    FontConfig font_config;
+    HPDF_Doc pdf;
+    int doc_used;               // the document holds a previous job
+    LabelTemplate tpl;
+    char *template_header;      // CSV header tpl was compiled for, NULL if none
+    CSVDialect dialect;         // of the posted CSV
+    uint64_t hex_state;         // HEX_CODE generator, continued from job to job
+} LabelServer;
+
+typedef struct {
+    char method[16];
+    char path[256];
+    char *body;                 // malloc'd, one spare byte after body_size
+    size_t body_size;
+} ServerRequest;
+
+/* ---------- Jobs ---------- */
+
+// The header names joined by newlines, which tells whether a request has
+// the columns the current template was compiled for
+static char* header_key(const CSVData *csv) {
+    size_t size = 1;
+    for (int i = 0; i < csv->field_count; i++) {
+        size += strlen(csv->field_names[i]) + 1;
+    }
+
+    char *key = malloc(size);
+    if (!key) return NULL;
+
+    char *p = key;
+    for (int i = 0; i < csv->field_count; i++) {
+        size_t len = strlen(csv->field_names[i]);
+        memcpy(p, csv->field_names[i], len);
+        p += len;
+        *p++ = '\n';
+    }
+    *p = '\0';
+    return key;
+}
+
+// Column positions are bound when the template is compiled, so it is only
+// compiled again when a request brings a different header
+static int prepare_template(LabelServer *server, const CSVData *csv) {
+    char *key = header_key(csv);
+    if (!key) return -1;
+
+    if (server->template_header && strcmp(key, server->template_header) == 0) {
+        free(key);
+        return 0;
+    }
+
+    if (server->template_header) {
+        free_template(&server->tpl);
+        free(server->template_header);
+        server->template_header = NULL;
+    }
+
+    if (compile_template(server->root, csv, &server->font_config, &server->tpl) != 0) {
+        free(key);
+        return -1;
+    }
+    server->template_header = key;
+    return 0;
+}
+
+// Render every row of the request into the server's document and return
+// the PDF in a malloc'd buffer. Returns the HTTP status for the response.
+static int render_job(LabelServer *server, const CSVData *csv, char **out, size_t *out_size) {
+    *out = NULL;
+    *out_size = 0;
+
+    if (csv->row_count == 0) {
+        log_message(LOG_WARNING, "Warning: Request has no rows\n");
+        return 400;
+    }
+    if (prepare_template(server, csv) != 0) {
+        log_message(LOG_ERROR, "Invalid template for the request's CSV header\n");
+        return 400;
+    }
+
+    // The document is reset in place; Libharu keeps font definitions and
+    // encoders across HPDF_NewDoc, so fonts are not loaded again
+    if (server->doc_used && HPDF_NewDoc(server->pdf) != HPDF_OK) {
+        log_message(LOG_ERROR, "Error creating PDF\n");
+        return 500;
+    }
+    server->doc_used = 1;
+
+    RenderContext ctx;
+    if (render_context_init(&ctx, server->pdf, &server->tpl) != 0) {
+        log_message(LOG_ERROR, "Memory allocation error\n");
+        return 500;
+    }
+    ctx.hex_state = server->hex_state;
+    int generated = render_rows(&ctx, csv, 0, csv->row_count - 1, 1);
+    server->hex_state = ctx.hex_state;
+    render_context_free(&ctx);
+
+    if (generated <= 0 || HPDF_SaveToStream(server->pdf) != HPDF_OK) {
+        log_message(LOG_ERROR, "Error saving PDF\n");
+        return 500;
+    }
+
+    HPDF_UINT32 size = HPDF_GetStreamSize(server->pdf);
+    char *data = size > 0 ? malloc(size) : NULL;
+    if (!data) {
+        log_message(LOG_ERROR, "Memory allocation error\n");
+        return 500;
+    }
+
+    HPDF_UINT32 read_size = size;
+    if (HPDF_ResetStream(server->pdf) != HPDF_OK ||
+        HPDF_ReadFromStream(server->pdf, (HPDF_BYTE*)data, &read_size) != HPDF_OK ||
+        read_size != size) {
+        log_message(LOG_ERROR, "Error reading PDF stream\n");
+        free(data);
+        return 500;
+    }
+
+    *out = data;
+    *out_size = size;
+    return 200;
+}
+
+/* ---------- HTTP ---------- */
+
+static const char* status_text(int status) {
+    switch (status) {
+        case 100: return "Continue";
+        case 200: return "OK";
+        case 400: return "Bad Request";
+        case 404: return "Not Found";
+        case 405: return "Method Not Allowed";
+        case 411: return "Length Required";
+        case 413: return "Payload Too Large";
+        case 431: return "Request Header Fields Too Large";
+        default:  return "Internal Server Error";
+    }
+}
+
+static int send_all(server_socket client, const char *data, size_t size) {
+    while (size > 0) {
+        int chunk = size > INT_MAX ? INT_MAX : (int)size;
+        int n = send(client, data, chunk, MSG_NOSIGNAL);
+        if (n <= 0) return -1;
+        data += n;
+        size -= (size_t)n;
+    }
+    return 0;
+}
+
+static int send_response(server_socket client, int status, const char *content_type,
+                         const char *body, size_t size) {
+    char head[256];
+    int n = snprintf(head, sizeof(head),
+                     "HTTP/1.1 %d %s\r\n"
+                     "Content-Type: %s\r\n"
+                     "Content-Length: %lu\r\n"
+                     "Connection: close\r\n\r\n",
+                     status, status_text(status), content_type, (unsigned long)size);
+    if (n < 0 || (size_t)n >= sizeof(head)) return -1;
+
+    if (send_all(client, head, (size_t)n) != 0) return -1;
+    return send_all(client, body, size);
+}
+
+static int send_error(server_socket client, int status) {
+    char body[64];
+    int n = snprintf(body, sizeof(body), "%d %s\n", status, status_text(status));
+    return send_response(client, status, "text/plain", body, (size_t)n);
+}
+
+// Value of header `name` when line is that header, NULL otherwise
+static const char* header_value(const char *line, const char *name) {
+    while (*name) {
+        if (tolower((unsigned char)*line) != tolower((unsigned char)*name)) return NULL;
+        line++;
+        name++;
+    }
+    if (*line != ':') return NULL;
+    line++;
+    while (*line == ' ' || *line == '\t') line++;
+    return line;
+}
+
+// Read the request line, the headers and a Content-Length body. Returns 0
+// when the request is complete, the HTTP status to answer with when it is
+// not acceptable, or -1 when the client went away.
+static int read_request(server_socket client, ServerRequest *req) {
+    char head[MAX_REQUEST_HEADER + 1];
+    size_t got = 0;
+    char *head_end = NULL;
+
+    memset(req, 0, sizeof(*req));
+
+    while (!head_end) {
+        if (got >= MAX_REQUEST_HEADER) return 431;
+        int n = recv(client, head + got, (int)(MAX_REQUEST_HEADER - got), 0);
+        if (n <= 0) return -1;
+        got += (size_t)n;
+        head[got] = '\0';
+        head_end = strstr(head, "\r\n\r\n");
+    }
+    *head_end = '\0';
+    char *body_start = head_end + 4;
+
+    if (sscanf(head, "%15s %255s", req->method, req->path) != 2) return 400;
+    char *query = strchr(req->path, '?');
+    if (query) *query = '\0';
+
+    long long content_length = -1;
+    int expect_continue = 0;
+    for (char *line = strstr(head, "\r\n"); line; line = strstr(line, "\r\n")) {
+        line += 2;
+        const char *value;
+        if ((value = header_value(line, "Content-Length")) != NULL) {
+            content_length = strtoll(value, NULL, 10);
+        } else if ((value = header_value(line, "Expect")) != NULL) {
+            expect_continue = strncmp(value, "100", 3) == 0;
+        }
+    }
+
+    if (strcmp(req->method, "POST") != 0) return 0;
+    if (content_length < 0) return 411;
+    if (content_length > MAX_REQUEST_BODY) return 413;
+
+    req->body = malloc((size_t)content_length + 1);
+    if (!req->body) return 500;
+    req->body_size = (size_t)content_length;
+
+    size_t have = got - (size_t)(body_start - head);
+    if (have > req->body_size) have = req->body_size;
+    memcpy(req->body, body_start, have);
+
+    // Clients that announced the body wait for this before sending it
+    if (have < req->body_size && expect_continue) {
+        const char *cont = "HTTP/1.1 100 Continue\r\n\r\n";
+        if (send_all(client, cont, strlen(cont)) != 0) return -1;
+    }
+
+    while (have < req->body_size) {
+        size_t want = req->body_size - have;
+        int n = recv(client, req->body + have, want > INT_MAX ? INT_MAX : (int)want, 0);
+        if (n <= 0) return -1;
+        have += (size_t)n;
+    }
+    return 0;
+}
+
+static void handle_client(LabelServer *server, server_socket client) {
+    ServerRequest req;
+    int status = read_request(client, &req);
+
+    if (status < 0) {
+        free(req.body);
+        return;
+    }
+    if (status == 0) {
+        if (strcmp(req.path, "/health") == 0) {
+            status = strcmp(req.method, "GET") == 0 ? 200 : 405;
+            if (status == 200) send_response(client, 200, "text/plain", "ok\n", 3);
+        } else if (strcmp(req.path, "/labels") != 0) {
+            status = 404;
+        } else if (strcmp(req.method, "POST") != 0) {
+            status = 405;
+        } else {
+            clock_t start = clock();
+            // The body is handed over to the CSV data and freed with it
+            CSVData *csv = parse_csv_buffer(req.body, req.body_size, &server->dialect);
+            req.body = NULL;
+
+            char *pdf_data = NULL;
+            size_t pdf_size = 0;
+            status = csv ? render_job(server, csv, &pdf_data, &pdf_size) : 400;
+            if (status == 200) {
+                send_response(client, 200, "application/pdf", pdf_data, pdf_size);
+                log_message(LOG_INFO, "Served %d labels (%lu bytes) in %.1f ms\n", csv->row_count,
+                            (unsigned long)pdf_size, (double)(clock() - start) * 1000.0 / CLOCKS_PER_SEC);
+            }
+            free(pdf_data);
+            free_csv_data(csv);
+        }
+    }
+
+    if (status != 200) send_error(client, status);
+    free(req.body);
+}
+
+/* ---------- Server ---------- */
+
+static void set_socket_options(server_socket client) {
+    int one = 1;
+    // Responses are sent as header and body; do not hold back the tail
+    setsockopt(client, IPPROTO_TCP, TCP_NODELAY, (const char*)&one, sizeof(one));
+
+    // A client that stops sending must not stall the jobs behind it
+#ifdef _WIN32
+    DWORD timeout = SERVER_TIMEOUT_MS;
+#else
+    struct timeval timeout;
+    timeout.tv_sec = SERVER_TIMEOUT_MS / 1000;
+    timeout.tv_usec = (SERVER_TIMEOUT_MS % 1000) * 1000;
+#endif
+    setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, (const char*)&timeout, sizeof(timeout));
+    setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, (const char*)&timeout, sizeof(timeout));
+}
+
+// Listen on 127.0.0.1:port; only local clients can reach the server
+static server_socket open_listener(int port) {
+    server_socket listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (listener == INVALID_SOCKET) return INVALID_SOCKET;
+
+#ifndef _WIN32
+    // Restarting the server must not wait for old connections to time out
+    int one = 1;
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+#endif
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((unsigned short)port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    if (bind(listener, (struct sockaddr*)&addr, sizeof(addr)) != 0 ||
+        listen(listener, SOMAXCONN) != 0) {
+        close_socket(listener);
+        return INVALID_SOCKET;
+    }
+    return listener;
+}
+
+// Load the config once and serve label requests until the process is
+// stopped. Returns only on startup errors.
+int run_label_server(const char *config_filename, int port, const CompressionConfig *compression,
+                     const CSVDialect *dialect) {
+    LabelServer server;
+    memset(&server, 0, sizeof(server));
+    server.dialect = *dialect;
+
+    server.root = load_json_config(config_filename);
+    if (!server.root) return 1;
+
+    server.pdf = create_label_doc(server.root, &server.font_config, compression);
+    if (!server.pdf) {
+        log_message(LOG_ERROR, "Error creating PDF\n");
+        cJSON_Delete(server.root);
+        return 1;
+    }
+
+#ifdef _WIN32
+    WSADATA wsa;
+    if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) {
+        log_message(LOG_ERROR, "Error initializing sockets\n");
+        HPDF_Free(server.pdf);
+        free_font_config(&server.font_config);
+        cJSON_Delete(server.root);
+        return 1;
+    }
+#endif
+
+    server_socket listener = open_listener(port);
+    if (listener == INVALID_SOCKET) {
+        log_message(LOG_ERROR, "Error: Cannot listen on 127.0.0.1:%d\n", port);
+#ifdef _WIN32
+        WSACleanup();
+#endif
+        HPDF_Free(server.pdf);
+        free_font_config(&server.font_config);
+        cJSON_Delete(server.root);
+        return 1;
+    }
+
+    server.hex_state = hex_code_seed((uint64_t)time(NULL));
+    log_message(LOG_INFO, "Using config: %s\n", config_filename);
+    log_message(LOG_INFO, "Serving labels on http://127.0.0.1:%d/labels\n", port);
+    log_flush();
+
+    for (;;) {
+        server_socket client = accept(listener, NULL, NULL);
+        if (client == INVALID_SOCKET) continue;
+
+        set_socket_options(client);
+        handle_client(&server, client);
+        close_socket(client);
+        log_flush();
+    }
+}
@@ -0,0 +1,340 @@
+/* FDCLabel_shard.c Fast Dynamic C Label Generator
+ *
+ * Copyright (C) Ivan Rolero
+ *
+ * This file is part of FDCLabel.
+ *
+ * FDCLabel is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FDCLabel is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <pthread.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+#include "cJSON.h"
+#include "hpdf.h"
+#include "utils.h"
+
+/* ---------- Documents ---------- */
+
+// New PDF document with the encodings and fonts of the config
+HPDF_Doc create_label_doc(cJSON *root, FontConfig *font_config, const CompressionConfig *compression) {
+    // Libharu objects come from a memory pool that recycles freed blocks,
+    // so pages released by streaming saves are reused by the next ones
+    STATS_START(start);
+    HPDF_Doc pdf = stats_enabled
+        ? HPDF_NewEx(error_handler, stats_pdf_alloc, stats_pdf_free, PDF_MEM_POOL_SIZE, NULL)
+        : HPDF_NewEx(error_handler, NULL, NULL, PDF_MEM_POOL_SIZE, NULL);
+    if (!pdf) return NULL;
+
+    HPDF_UseUTFEncodings(pdf);
+    if (compression && compression->level == COMPRESSION_NONE) {
+        HPDF_SetCompressionMode(pdf, HPDF_COMP_NONE);
+    } else {
+        HPDF_SetCompressionMode(pdf, HPDF_COMP_ALL);
+        if (compression) {
+            HPDF_SetCompressionLevel(pdf, compression->level, compression->strategy);
+        }
+    }
+
+    if (load_fonts_from_json(root, font_config, pdf) != 0) {
+        log_message(LOG_WARNING, "Warning: Could not load font configuration, using defaults\n");
+        safe_strncpy(font_config->default_font, "Helvetica-Bold", sizeof(font_config->default_font));
+        font_config->custom_fonts = NULL;
+        font_config->custom_font_count = 0;
+    }
+
+    STATS_STOP(STAT_DOCUMENT, start);
+    return pdf;
+}
+
+void free_font_config(FontConfig *font_config) {
+    if (!font_config) return;
+    free(font_config->custom_fonts);
+    font_config->custom_fonts = NULL;
+    font_config->custom_font_count = 0;
+}
+
+int default_thread_count(void) {
+    int count;
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    count = (int)info.dwNumberOfProcessors;
+#else
+    count = (int)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+    if (count < 1) count = 1;
+    if (count > MAX_RENDER_THREADS) count = MAX_RENDER_THREADS;
+    return count;
+}
+
+/* ---------- Shard Planning ---------- */
+
+// Output name without a trailing ".pdf", the stem for shard and manifest files
+static void output_stem(const char *output_filename, char *stem, size_t stem_size) {
+    safe_strncpy(stem, output_filename, stem_size);
+
+    size_t len = strlen(stem);
+    if (len > 4 && stem[len - 4] == '.' &&
+        tolower((unsigned char)stem[len - 3]) == 'p' &&
+        tolower((unsigned char)stem[len - 2]) == 'd' &&
+        tolower((unsigned char)stem[len - 1]) == 'f') {
+        stem[len - 4] = '\0';
+    }
+}
+
+// Split rows [start_row, end_row] into consecutive shards of shard_size rows,
+// or into shard_count shards of (nearly) equal size when shard_size is 0.
+// Returns the number of shards, or -1 on error.
+int plan_shards(const char *output_filename, int start_row, int end_row,
+                int shard_size, int shard_count, ShardJob **out_jobs) {
+    if (!output_filename || !out_jobs || end_row < start_row) return -1;
+    *out_jobs = NULL;
+
+    int total = end_row - start_row + 1;
+    if (shard_size <= 0) {
+        if (shard_count <= 0) return -1;
+        if (shard_count > total) shard_count = total;
+        shard_size = (total + shard_count - 1) / shard_count;
+    }
+
+    int count = (total + shard_size - 1) / shard_size;
+    if (count > MAX_SHARDS) {
+        log_message(LOG_ERROR, "Error: Too many shards (%d), max is %d\n", count, MAX_SHARDS);
+        return -1;
+    }
+
+    ShardJob *jobs = calloc(count, sizeof(ShardJob));
+    if (!jobs) return -1;
+
+    char stem[MAX_OUTPUT_PATH];
+    output_stem(output_filename, stem, sizeof(stem));
+
+    for (int i = 0; i < count; i++) {
+        ShardJob *job = &jobs[i];
+        job->number = i + 1;
+        job->start_row = start_row + i * shard_size;
+        job->end_row = job->start_row + shard_size - 1;
+        if (job->end_row > end_row) job->end_row = end_row;
+        job->generated = 0;
+
+        int n = snprintf(job->filename, sizeof(job->filename), "%s_%04d.pdf", stem, job->number);
+        if (n < 0 || (size_t)n >= sizeof(job->filename)) {
+            log_message(LOG_ERROR, "Error: Output filename too long: %s\n", output_filename);
+            free(jobs);
+            return -1;
+        }
+    }
+
+    *out_jobs = jobs;
+    return count;
+}
+
+/* ---------- Shard Rendering ---------- */
+
+typedef struct {
+    cJSON *root;
+    const LabelTemplate *tpl;
+    const CSVData *csv;
+    ShardJob *jobs;
+    int job_count;
+    int streaming;
+    const CompressionConfig *compression;
+    uint64_t hex_seed;
+    int next_job;
+    pthread_mutex_t lock;
+} ShardQueue;
+
+// Give a finished shard its name, replacing the file of an earlier run
+static int publish_shard(const char *part, const char *filename) {
+#ifdef _WIN32
+    return MoveFileExA(part, filename, MOVEFILE_REPLACE_EXISTING) ? 0 : -1;
+#else
+    return rename(part, filename);
+#endif
+}
+
+// Render one shard into its own document and file. The file is written as
+// <name>.part and renamed when complete, so a spooler picking up shards
+// while the run goes on never sees one that is still being written.
+static int render_shard(ShardQueue *q, ShardJob *job) {
+    char part[MAX_OUTPUT_PATH + 8];
+    snprintf(part, sizeof(part), "%s.part", job->filename);
+
+    FontConfig font_config;
+    HPDF_Doc pdf = create_label_doc(q->root, &font_config, q->compression);
+    if (!pdf) {
+        log_message(LOG_ERROR, "Error creating PDF for shard %d\n", job->number);
+        return -1;
+    }
+
+    RenderContext ctx;
+    if (render_context_init(&ctx, pdf, q->tpl) != 0) {
+        log_message(LOG_ERROR, "Memory allocation error in shard %d\n", job->number);
+        HPDF_Free(pdf);
+        free_font_config(&font_config);
+        return -1;
+    }
+    // Every shard draws its own hex codes, from a seed of the run and its number
+    ctx.hex_state = hex_code_seed(q->hex_seed + (uint64_t)job->number);
+
+    int generated = -1;
+    if (q->streaming) {
+        if (HPDF_BeginStreamingSave(pdf, part) == HPDF_OK) {
+            ctx.streaming = 1;
+            generated = render_rows(&ctx, q->csv, job->start_row, job->end_row, 1);
+            STATS_START(save_start);
+            if (HPDF_EndStreamingSave(pdf) != HPDF_OK) generated = -1;
+            STATS_STOP(STAT_SAVE, save_start);
+        }
+    } else {
+        generated = render_rows(&ctx, q->csv, job->start_row, job->end_row, 1);
+        STATS_START(save_start);
+        if (HPDF_SaveToFile(pdf, part) != HPDF_OK) generated = -1;
+        STATS_STOP(STAT_SAVE, save_start);
+    }
+    if (stats_enabled) stats_doc_saved(pdf);
+    HPDF_Free(pdf);
+
+    if (generated >= 0 && publish_shard(part, job->filename) != 0) generated = -1;
+    if (generated < 0) {
+        remove(part);
+        log_message(LOG_ERROR, "Error saving PDF to: %s\n", job->filename);
+    } else {
+        log_message(LOG_INFO, "Finished shard %d: %s (rows %d-%d, %d labels)\n",
+                    job->number, job->filename, csv_source_row(q->csv, job->start_row),
+                    csv_source_row(q->csv, job->end_row), generated);
+    }
+
+    render_context_free(&ctx);
+    free_font_config(&font_config);
+    return generated;
+}
+
+// Shards are claimed in order, so the first files are finished first
+static void* shard_worker(void *arg) {
+    ShardQueue *q = (ShardQueue*)arg;
+
+    for (;;) {
+        pthread_mutex_lock(&q->lock);
+        int index = q->next_job < q->job_count ? q->next_job++ : -1;
+        pthread_mutex_unlock(&q->lock);
+
+        if (index < 0) break;
+        ShardJob *job = &q->jobs[index];
+        job->generated = render_shard(q, job);
+        // A failed shard leaves no file under its name: one from an earlier
+        // run would look finished
+        if (job->generated < 0) remove(job->filename);
+    }
+
+    return NULL;
+}
+
+// Render every shard with its own document, up to `threads` at a time.
+// Returns the total number of labels written.
+int render_shards(cJSON *root, const LabelTemplate *tpl, const CSVData *csv,
+                  ShardJob *jobs, int job_count, int threads, int streaming,
+                  const CompressionConfig *compression, uint64_t hex_seed) {
+    if (!root || !tpl || !csv || !jobs || job_count <= 0) return 0;
+
+    ShardQueue q;
+    memset(&q, 0, sizeof(q));
+    q.root = root;
+    q.tpl = tpl;
+    q.csv = csv;
+    q.jobs = jobs;
+    q.job_count = job_count;
+    q.streaming = streaming;
+    q.compression = compression;
+    q.hex_seed = hex_seed;
+    pthread_mutex_init(&q.lock, NULL);
+
+    if (threads > job_count) threads = job_count;
+    if (threads < 1) threads = 1;
+
+    pthread_t *workers = calloc(threads, sizeof(pthread_t));
+    int started = 0;
+    for (int i = 0; workers && i < threads; i++) {
+        if (pthread_create(&workers[i], NULL, shard_worker, &q) != 0) break;
+        started++;
+    }
+    if (started < threads) {
+        log_message(LOG_WARNING, "Warning: Could only start %d of %d shard threads\n", started, threads);
+    }
+
+    // Without any worker the remaining shards run on this thread
+    if (started == 0) {
+        shard_worker(&q);
+    }
+    for (int i = 0; i < started; i++) {
+        pthread_join(workers[i], NULL);
+    }
+
+    pthread_mutex_destroy(&q.lock);
+    free(workers);
+
+    int total = 0;
+    for (int i = 0; i < job_count; i++) {
+        if (jobs[i].generated > 0) total += jobs[i].generated;
+    }
+    return total;
+}
+
+/* ---------- Manifest ---------- */
+
+// <output stem>_manifest.csv: one line per shard with its file and the
+// rows of the CSV file its first and last label come from
+int write_shard_manifest(const char *output_filename, const CSVData *csv,
+                         const ShardJob *jobs, int job_count) {
+    char stem[MAX_OUTPUT_PATH];
+    char manifest[MAX_OUTPUT_PATH];
+
+    output_stem(output_filename, stem, sizeof(stem));
+    int n = snprintf(manifest, sizeof(manifest), "%s_manifest.csv", stem);
+    if (n < 0 || (size_t)n >= sizeof(manifest)) {
+        log_message(LOG_ERROR, "Error: Output filename too long: %s\n", output_filename);
+        return -1;
+    }
+
+    FILE *f = fopen(manifest, "w");
+    if (!f) {
+        log_message(LOG_ERROR, "Cannot write manifest file: %s\n", manifest);
+        return -1;
+    }
+
+    fprintf(f, "shard,file,first_row,last_row,labels,status\n");
+    for (int i = 0; i < job_count; i++) {
+        const ShardJob *job = &jobs[i];
+        fprintf(f, "%d,%s,%d,%d,%d,%s\n", job->number, job->filename,
+                csv_source_row(csv, job->start_row), csv_source_row(csv, job->end_row),
+                job->generated > 0 ? job->generated : 0,
+                job->generated >= 0 ? "ok" : "failed");
+    }
+
+    if (fclose(f) != 0) {
+        log_message(LOG_ERROR, "Error writing manifest file: %s\n", manifest);
+        return -1;
+    }
+
+    log_message(LOG_INFO, "Shard manifest: %s\n", manifest);
+    return 0;
+}
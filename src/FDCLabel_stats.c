@@ -0,0 +1,194 @@
+/* FDCLabel_stats.c Fast Dynamic C Label Generator
+ *
+ * Copyright (C) Ivan Rolero
+ *
+ * This file is part of FDCLabel.
+ *
+ * FDCLabel is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FDCLabel is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+#include "hpdf.h"
+#include "utils.h"
+
+/* ---------- Instrumentation ---------- */
+
+// Per-stage timers and counters of --stats. Every call site checks
+// stats_enabled first, so a run without --stats pays one branch per site.
+// Workers add to the same totals, so stage times are summed over threads.
+
+int stats_enabled = 0;
+
+typedef struct {
+    const char *name;
+    int depth;                  // 1: part of the stage above
+} StatStageInfo;
+
+static const StatStageInfo stage_info[STAT_STAGE_COUNT] = {
+    { "config", 0 },
+    { "csv", 0 },
+    { "document", 0 },
+    { "template", 0 },
+    { "layout", 0 },
+    { "text", 1 },
+    { "qr", 1 },
+    { "emit", 0 },
+    { "text", 1 },
+    { "qr", 1 },
+    { "barcodes", 1 },
+    { "deflate", 0 },
+    { "save", 0 },
+};
+
+static const char *counter_names[STAT_COUNTER_COUNT] = {
+    "rows",
+    "labels",
+    "bytes read",
+    "glyphs measured",
+    "operators",
+    "content bytes",
+    "libharu allocations",
+    "libharu allocated bytes",
+    "deflate input bytes",
+    "deflate output bytes",
+};
+
+static uint64_t stage_ns[STAT_STAGE_COUNT];
+static uint64_t stage_calls[STAT_STAGE_COUNT];
+static uint64_t counters[STAT_COUNTER_COUNT];
+static uint64_t start_ns;
+static FILE *rows_file = NULL;
+static pthread_mutex_t rows_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// Monotonic clock in nanoseconds
+uint64_t stats_clock(void) {
+#ifdef _WIN32
+    static LARGE_INTEGER freq;
+    LARGE_INTEGER counter;
+    if (freq.QuadPart == 0) QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&counter);
+    return (uint64_t)((double)counter.QuadPart * 1e9 / (double)freq.QuadPart);
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+// Add the time since start to a stage; returns it
+uint64_t stats_add_time(StatStage stage, uint64_t start) {
+    uint64_t elapsed = stats_clock() - start;
+    __atomic_fetch_add(&stage_ns[stage], elapsed, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&stage_calls[stage], 1, __ATOMIC_RELAXED);
+    return elapsed;
+}
+
+void stats_add(StatCounter counter, uint64_t value) {
+    __atomic_fetch_add(&counters[counter], value, __ATOMIC_RELAXED);
+}
+
+// Enable the instrumentation; with rows_filename, one JSON line per label
+int stats_start(const char *rows_filename) {
+    if (rows_filename) {
+        rows_file = fopen(rows_filename, "w");
+        if (!rows_file) {
+            fprintf(stderr, "Cannot write stats file: %s\n", rows_filename);
+            return -1;
+        }
+    }
+    stats_enabled = 1;
+    start_ns = stats_clock();
+    return 0;
+}
+
+// A finished page: its label's layout measurements and what was emitted
+void stats_label(const LabelLayout *layout, uint64_t emit_ns, HPDF_UINT operators,
+                 HPDF_UINT content_bytes) {
+    stats_add(STAT_LABELS, 1);
+    stats_add(STAT_OPERATORS, operators);
+    stats_add(STAT_CONTENT_BYTES, content_bytes);
+
+    if (!rows_file) return;
+    pthread_mutex_lock(&rows_lock);
+    fprintf(rows_file,
+            "{\"row\":%d,\"layout_us\":%.1f,\"emit_us\":%.1f,\"glyphs\":%u,"
+            "\"operators\":%u,\"content_bytes\":%u}\n",
+            layout->row_index, (double)layout->stats.layout_ns / 1000.0,
+            (double)emit_ns / 1000.0, (unsigned int)layout->stats.glyphs,
+            (unsigned int)operators, (unsigned int)content_bytes);
+    pthread_mutex_unlock(&rows_lock);
+}
+
+// Streams the save deflated, after it finished
+void stats_doc_saved(HPDF_Doc pdf) {
+    HPDF_UINT64 in_size = 0, out_size = 0;
+    if (HPDF_GetDeflateTotals(pdf, &in_size, &out_size) != HPDF_OK) return;
+    stats_add(STAT_DEFLATE_IN, in_size);
+    stats_add(STAT_DEFLATE_OUT, out_size);
+}
+
+// Allocation functions of documents created while --stats is on; Libharu
+// asks for memory in pool blocks and for objects larger than a block
+void* stats_pdf_alloc(HPDF_UINT size) {
+    stats_add(STAT_PDF_ALLOCS, 1);
+    stats_add(STAT_PDF_ALLOC_BYTES, size);
+    return malloc(size);
+}
+
+void stats_pdf_free(void *ptr) {
+    free(ptr);
+}
+
+void stats_print_summary(void) {
+    if (!stats_enabled) return;
+    double wall_ms = (double)(stats_clock() - start_ns) / 1e6;
+
+    printf("\nStage timings (summed over threads):\n");
+    printf("  %-16s %10s %12s %10s\n", "stage", "calls", "total ms", "avg us");
+    for (int i = 0; i < STAT_STAGE_COUNT; i++) {
+        if (stage_calls[i] == 0) continue;
+        double ms = (double)stage_ns[i] / 1e6;
+        printf("  %*s%-*s %10llu %12.3f %10.2f\n", stage_info[i].depth * 2, "",
+               16 - stage_info[i].depth * 2, stage_info[i].name,
+               (unsigned long long)stage_calls[i], ms, ms * 1000.0 / (double)stage_calls[i]);
+    }
+
+    printf("\nCounters:\n");
+    for (int i = 0; i < STAT_COUNTER_COUNT; i++) {
+        printf("  %-24s %14llu\n", counter_names[i], (unsigned long long)counters[i]);
+    }
+    if (counters[STAT_DEFLATE_IN] > 0) {
+        printf("  %-24s %13.1f%%\n", "deflate ratio",
+               100.0 * (double)counters[STAT_DEFLATE_OUT] / (double)counters[STAT_DEFLATE_IN]);
+    }
+    printf("  %-24s %14.3f\n", "wall time ms", wall_ms);
+    if (wall_ms > 0) {
+        printf("  %-24s %14.1f\n", "labels/s", (double)counters[STAT_LABELS] * 1000.0 / wall_ms);
+    }
+}
+
+void stats_finish(void) {
+    if (rows_file) {
+        fclose(rows_file);
+        rows_file = NULL;
+    }
+}
@@ -0,0 +1,432 @@
+/* FDCLabel_template.c Fast Dynamic C Label Generator
+ *
+ * Copyright (C) Ivan Rolero
+ *
+ * This file is part of FDCLabel.
+ *
+ * FDCLabel is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FDCLabel is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cJSON.h"
+#include "hpdf.h"
+#include "barcodes.h"
+#include "utils.h"
+
+/* ---------- Header Index ---------- */
+
+// Open-addressing map from CSV header name to column index, built once per
+// template so that binding a placeholder does not scan every header name
+typedef struct {
+    const CSVData *csv;
+    int *slots;                 // column index, -1 for an empty slot
+    unsigned mask;
+} HeaderIndex;
+
+static unsigned hash_name(const char *name) {
+    unsigned h = 2166136261u;   // FNV-1a
+    while (*name) {
+        h ^= (unsigned char)*name++;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static int build_header_index(HeaderIndex *index, const CSVData *csv) {
+    memset(index, 0, sizeof(*index));
+    if (!csv) return 0;
+
+    unsigned size = 16;
+    while (size < (unsigned)csv->field_count * 2) size *= 2;
+
+    index->slots = malloc(size * sizeof(int));
+    if (!index->slots) return -1;
+    for (unsigned i = 0; i < size; i++) index->slots[i] = -1;
+    index->csv = csv;
+    index->mask = size - 1;
+
+    for (int c = 0; c < csv->field_count; c++) {
+        unsigned i = hash_name(csv->field_names[c]) & index->mask;
+        while (index->slots[i] >= 0) {
+            // Duplicate header names bind to their first column
+            if (strcmp(csv->field_names[index->slots[i]], csv->field_names[c]) == 0) break;
+            i = (i + 1) & index->mask;
+        }
+        if (index->slots[i] < 0) index->slots[i] = c;
+    }
+
+    return 0;
+}
+
+static int find_column(const HeaderIndex *index, const char *name) {
+    if (!index->slots) return -1;
+
+    unsigned i = hash_name(name) & index->mask;
+    while (index->slots[i] >= 0) {
+        if (strcmp(index->csv->field_names[index->slots[i]], name) == 0) return index->slots[i];
+        i = (i + 1) & index->mask;
+    }
+    return -1;
+}
+
+static void free_header_index(HeaderIndex *index) {
+    free(index->slots);
+    index->slots = NULL;
+}
+
+/* ---------- Template Compilation ---------- */
+
+// Decide once where an element's text comes from: a CSV column, the
+// per-label hex code or the literal text itself
+static void compile_text(TemplateText *out, const char *txt, const HeaderIndex *header, int *uses_hex) {
+    out->source = TEXT_STATIC;
+    out->column = -1;
+
+    if (txt[0] == '$') {
+        out->column = find_column(header, txt + 1);
+        if (out->column >= 0) out->source = TEXT_COLUMN;
+    }
+    else if (!strcmp(txt, "HEX_CODE") || !strcmp(txt, "RANDOM_HEX")) {
+        out->source = TEXT_HEX;
+        *uses_hex = 1;
+    }
+
+    safe_strncpy(out->text, txt, sizeof(out->text));
+    out->text_len = strlen(out->text);
+}
+
+static int compile_fields(cJSON *root, const HeaderIndex *header, const FontConfig *font_config, LabelTemplate *tpl) {
+    cJSON *jfields = cJSON_GetObjectItem(root, "fields");
+    if (!jfields || !cJSON_IsArray(jfields)) return -1;
+
+    int count = cJSON_GetArraySize(jfields);
+    if (count > MAX_FIELD_COUNT) {
+        log_message(LOG_WARNING, "Warning: Too many fields (%d), limiting to %d\n", count, MAX_FIELD_COUNT);
+        count = MAX_FIELD_COUNT;
+    }
+
+    tpl->fields = (TemplateField*)calloc(count > 0 ? count : 1, sizeof(TemplateField));
+    tpl->font_names = calloc(count > 0 ? count : 1, sizeof(*tpl->font_names));
+    if (!tpl->fields || !tpl->font_names) return -2;
+
+    int i = 0;
+    cJSON *it;
+    cJSON_ArrayForEach(it, jfields) {
+        if (i >= count) break;
+        int index = i++;
+        if (!cJSON_IsObject(it))
+            continue;
+
+        // Required numeric fields
+        cJSON *x_start    = cJSON_GetObjectItem(it, "x_start");
+        cJSON *x_end      = cJSON_GetObjectItem(it, "x_end");
+        cJSON *y_start    = cJSON_GetObjectItem(it, "y_start");
+        cJSON *y_end      = cJSON_GetObjectItem(it, "y_end");
+        cJSON *font_size  = cJSON_GetObjectItem(it, "font_size");
+
+        if (!cJSON_IsNumber(x_start) ||
+            !cJSON_IsNumber(x_end)   ||
+            !cJSON_IsNumber(y_start) ||
+            !cJSON_IsNumber(y_end)   ||
+            !cJSON_IsNumber(font_size))
+        {
+            log_message(LOG_WARNING, "Warning: Field %d: missing/wrong type in required numeric field. Skipping.\n", index);
+            continue;
+        }
+
+        TemplateField *tmp = &tpl->fields[tpl->field_count];
+        tmp->x_start   = (float)x_start->valuedouble;
+        tmp->x_end     = (float)x_end->valuedouble;
+        tmp->y_start   = (float)y_start->valuedouble;
+        tmp->y_end     = (float)y_end->valuedouble;
+        tmp->font_size = (float)font_size->valuedouble;
+
+        // Boxes with no area are never drawn, drop them here
+        if (tmp->x_end <= tmp->x_start || tmp->y_end <= tmp->y_start) continue;
+
+        cJSON *jwrap = cJSON_GetObjectItem(it, "wrap");
+        if (cJSON_IsBool(jwrap))
+            tmp->wrap = cJSON_IsTrue(jwrap);
+        else if (cJSON_IsNumber(jwrap))
+            tmp->wrap = jwrap->valueint != 0;
+        else
+            tmp->wrap = 0;
+
+        cJSON *jalign = cJSON_GetObjectItem(it, "align");
+        tmp->align = parse_align(cJSON_IsString(jalign) ? jalign->valuestring : "left");
+
+        // font name, falling back to the template default
+        cJSON *jfont = cJSON_GetObjectItem(it, "font_name");
+        if (cJSON_IsString(jfont) && jfont->valuestring[0])
+            safe_strncpy(tmp->font_name, jfont->valuestring, sizeof(tmp->font_name));
+        else
+            safe_strncpy(tmp->font_name, font_config->default_font, sizeof(tmp->font_name));
+
+        // Fields sharing a font share one document font handle
+        tmp->font = 0;
+        while (tmp->font < tpl->font_count && strcmp(tpl->font_names[tmp->font], tmp->font_name) != 0)
+            tmp->font++;
+        if (tmp->font == tpl->font_count)
+            safe_strncpy(tpl->font_names[tpl->font_count++], tmp->font_name, sizeof(tpl->font_names[0]));
+
+        //max length field truncate function
+        cJSON *jmax_len = cJSON_GetObjectItem(it, "max_length");
+        if (cJSON_IsNumber(jmax_len)) {
+            tmp->max_length = jmax_len->valueint;
+            if (tmp->max_length < 0) tmp->max_length = 0;
+            if (tmp->max_length > MAX_FIELD_LEN) tmp->max_length = MAX_FIELD_LEN;
+        } else {
+            tmp->max_length = 0;
+        }
+
+        cJSON *jtext = cJSON_GetObjectItem(it, "text");
+        compile_text(&tmp->text, cJSON_IsString(jtext) ? jtext->valuestring : "", header, &tpl->uses_hex);
+
+        tpl->field_count++;
+    }
+
+    return 0;
+}
+
+static int compile_qr(cJSON *root, const HeaderIndex *header, LabelTemplate *tpl) {
+    TemplateQR *qr = &tpl->qr;
+
+    cJSON *jqr = cJSON_GetObjectItem(root, "qr_code");
+    if (!jqr) {
+        // No QR code configuration found, disable it
+        qr->enabled = 0;
+        return 0;
+    }
+
+    // Set defaults
+    qr->x = 192.0f;
+    qr->y = 1.0f;
+    qr->size = 113.4f;
+    qr->enabled = 1;  // Enable by default if config exists
+    qr->image = 1;
+
+    cJSON *jx = cJSON_GetObjectItem(jqr, "x");
+    cJSON *jy = cJSON_GetObjectItem(jqr, "y");
+    cJSON *jsize = cJSON_GetObjectItem(jqr, "size");
+    cJSON *jenabled = cJSON_GetObjectItem(jqr, "enabled");
+    cJSON *jtext = cJSON_GetObjectItem(jqr, "text");
+    cJSON *jmode = cJSON_GetObjectItem(jqr, "mode");
+
+    if (jx) qr->x = (float)jx->valuedouble;
+    if (jy) qr->y = (float)jy->valuedouble;
+    if (jsize) qr->size = (float)jsize->valuedouble;
+    if (jenabled) qr->enabled = cJSON_IsTrue(jenabled) ? 1 : 0;
+    if (jmode && cJSON_IsString(jmode)) {
+        if (strcmp(jmode->valuestring, "path") == 0) {
+            qr->image = 0;
+        } else if (strcmp(jmode->valuestring, "image") != 0) {
+            log_message(LOG_WARNING, "Warning: Unknown QR code mode '%s', using image\n", jmode->valuestring);
+        }
+    }
+
+    compile_text(&qr->text, jtext && jtext->valuestring ? jtext->valuestring : "", header, &tpl->uses_hex);
+
+    // Static empty text never produces a code
+    if (qr->text.source == TEXT_STATIC && qr->text.text[0] == '\0')
+        qr->enabled = 0;
+
+    return 0;
+}
+
+static int compile_barcodes(cJSON *root, const HeaderIndex *header, LabelTemplate *tpl) {
+    cJSON *jbarcodes = cJSON_GetObjectItem(root, "barcodes");
+    if (!jbarcodes || !cJSON_IsArray(jbarcodes)) return 0;
+
+    int count = cJSON_GetArraySize(jbarcodes);
+    if (count > MAX_FIELD_COUNT) {
+        log_message(LOG_WARNING, "Warning: Too many barcodes (%d), limiting to %d\n", count, MAX_FIELD_COUNT);
+        count = MAX_FIELD_COUNT;
+    }
+
+    tpl->barcodes = (TemplateBarcode*)calloc(count > 0 ? count : 1, sizeof(TemplateBarcode));
+    if (!tpl->barcodes) return -2;
+
+    int i = 0;
+    cJSON *it;
+    cJSON_ArrayForEach(it, jbarcodes) {
+        if (i >= count) break;
+        int index = i++;
+
+        // Get required fields
+        cJSON *jx = cJSON_GetObjectItem(it, "x");
+        cJSON *jy = cJSON_GetObjectItem(it, "y");
+        cJSON *jwidth = cJSON_GetObjectItem(it, "width");
+        cJSON *jheight = cJSON_GetObjectItem(it, "height");
+        cJSON *jtype = cJSON_GetObjectItem(it, "type");
+        cJSON *jtext = cJSON_GetObjectItem(it, "text");
+        cJSON *jmode = cJSON_GetObjectItem(it, "mode");
+
+        if (!jx || !jy || !jwidth || !jheight || !jtype) {
+            log_message(LOG_WARNING, "Warning: Missing required barcode field in barcode %d, skipping\n", index);
+            continue;
+        }
+
+        TemplateBarcode *bc = &tpl->barcodes[tpl->barcode_count];
+        safe_strncpy(bc->type_name, jtype->valuestring ? jtype->valuestring : "", sizeof(bc->type_name));
+
+        if (strcmp(bc->type_name, "code128") == 0) {
+            bc->type = BARCODE_CODE128;
+        } else if (strcmp(bc->type_name, "ean13") == 0) {
+            bc->type = BARCODE_EAN13;
+        } else if (strcmp(bc->type_name, "upca") == 0) {
+            bc->type = BARCODE_UPCA;
+        } else {
+            log_message(LOG_WARNING, "Warning: Unknown barcode type: %s\n", bc->type_name);
+            continue;
+        }
+
+        bc->x = (float)jx->valuedouble;
+        bc->y = (float)jy->valuedouble;
+        bc->width = (float)jwidth->valuedouble;
+        bc->height = (float)jheight->valuedouble;
+        bc->image = 0;
+        if (jmode && cJSON_IsString(jmode)) {
+            if (strcmp(jmode->valuestring, "image") == 0) {
+                bc->image = 1;
+            } else if (strcmp(jmode->valuestring, "path") != 0) {
+                log_message(LOG_WARNING, "Warning: Unknown barcode mode '%s', using path\n", jmode->valuestring);
+            }
+        }
+
+        compile_text(&bc->text, jtext && jtext->valuestring ? jtext->valuestring : "", header, &tpl->uses_hex);
+
+        tpl->barcode_count++;
+    }
+
+    return 0;
+}
+
+int compile_template(cJSON *root, const CSVData *csv, const FontConfig *font_config, LabelTemplate *tpl) {
+    if (!root || !font_config || !tpl) return -1;
+
+    memset(tpl, 0, sizeof(*tpl));
+    safe_strncpy(tpl->default_font, font_config->default_font, sizeof(tpl->default_font));
+
+    if (load_page_config_from_json(root, &tpl->page) != 0) {
+        log_message(LOG_ERROR, "Error loading page config from JSON, using defaults\n");
+        tpl->page.size = HPDF_PAGE_SIZE_A4;
+        tpl->page.orientation = HPDF_PAGE_LANDSCAPE;
+        tpl->page.line_width = 3.0f;
+    }
+
+    HeaderIndex header;
+    if (build_header_index(&header, csv) != 0) {
+        log_message(LOG_ERROR, "Memory allocation error indexing CSV header\n");
+        return -1;
+    }
+
+    if (compile_fields(root, &header, font_config, tpl) != 0) {
+        log_message(LOG_ERROR, "Error loading fields from JSON\n");
+        free_header_index(&header);
+        free_template(tpl);
+        return -1;
+    }
+
+    if (load_lines_from_json(root, &tpl->lines, &tpl->line_count) != 0) {
+        log_message(LOG_ERROR, "Error loading lines from JSON\n");
+        free_header_index(&header);
+        free_template(tpl);
+        return -1;
+    }
+
+    if (compile_qr(root, &header, tpl) != 0) {
+        log_message(LOG_ERROR, "Error loading QR code configuration\n");
+        tpl->qr.enabled = 0;
+    }
+
+    if (compile_barcodes(root, &header, tpl) != 0) {
+        log_message(LOG_ERROR, "Error loading barcodes from JSON\n");
+        free_header_index(&header);
+        free_template(tpl);
+        return -1;
+    }
+
+    free_header_index(&header);
+    return 0;
+}
+
+void free_template(LabelTemplate *tpl) {
+    if (!tpl) return;
+
+    free(tpl->fields);
+    free(tpl->lines);
+    free(tpl->barcodes);
+    free(tpl->font_names);
+    tpl->font_names = NULL;
+    tpl->font_count = 0;
+    tpl->fields = NULL;
+    tpl->lines = NULL;
+    tpl->barcodes = NULL;
+    tpl->field_count = tpl->line_count = tpl->barcode_count = 0;
+}
+
+/* ---------- Row Binding ---------- */
+
+// Resolve template text against one CSV row. Column values are returned in
+// place and only copied to dest when they have to be cut to max_length or
+// to dest_size. The length of the result is stored in *out_len.
+const char* bind_template_text(const TemplateText *t, const CSVRow *row, const char *hex_code,
+                               int max_length, char *dest, size_t dest_size, int *truncated,
+                               size_t *out_len) {
+    size_t len;
+    const char *result;
+
+    if (truncated) *truncated = 0;
+
+    switch (t->source) {
+        case TEXT_COLUMN:
+            if (row && t->column < row->count) {
+                result = row->fields[t->column];
+                len = (size_t)row->lengths[t->column];
+
+                size_t limit = dest_size - 1;
+                if (max_length > 0 && len > (size_t)max_length) {
+                    if ((size_t)max_length < limit) limit = (size_t)max_length;
+                    if (truncated) *truncated = 1;
+                }
+                if (len > limit) {
+                    memcpy(dest, result, limit);
+                    dest[limit] = '\0';
+                    result = dest;
+                    len = limit;
+                }
+                break;
+            }
+            // Row without this column keeps the placeholder text
+            result = t->text;
+            len = t->text_len;
+            break;
+
+        case TEXT_HEX:
+            result = hex_code ? hex_code : "";
+            len = strlen(result);
+            break;
+
+        case TEXT_STATIC:
+        default:
+            result = t->text;
+            len = t->text_len;
+            break;
+    }
+
+    if (out_len) *out_len = len;
+    return result;
+}
@@ -69,317 +69,34 @@ int safe_atoi(const char *str, int default_val)
 //Helpers
 void error_handler(HPDF_STATUS error_no, HPDF_STATUS detail_no, void *user_data) {
     (void)user_data;
-    fprintf(stderr, "PDF Error: error_no=%04X, detail_no=%d\n", (unsigned int)error_no, (int)detail_no);
+    log_message(LOG_ERROR, "PDF Error: error_no=%04X, detail_no=%d\n", (unsigned int)error_no, (int)detail_no);
 }
 //Remove or modify random number generator here
-void generate_hex_code(char *hex, int length) {
-    if (!hex || length <= 0) return;
-    
-    const char hex_chars[] = "0123456789ABCDEF";
-    for (int i = 0; i < length && i < HEX_LENGTH; ++i) {
-        hex[i] = hex_chars[rand() % 16];
-    }
-    hex[length] = '\0';
+// Hex codes come from a xorshift generator owned by the caller instead of
+// rand(), whose state is per thread on MSVCRT: every document draws one
+// sequence, in row order, whatever the number of threads
+uint64_t hex_code_seed(uint64_t value) {
+    // splitmix64, so that close seeds give unrelated sequences
+    uint64_t z = value + 0x9E3779B97F4A7C15ull;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    z ^= z >> 31;
+    return z ? z : 1;
 }
 
-// CSV parsing
-void free_csv_data(CSVData *csv) {
-    if (!csv) return;
-    
-    for (int i = 0; i < csv->row_count; i++) {
-        if (csv->rows[i].fields) {
-            for (int j = 0; j < csv->rows[i].count; j++) {
-                free(csv->rows[i].fields[j]);
-            }
-            free(csv->rows[i].fields);
-        }
-    }
-    
-    if (csv->field_names) {
-        for (int i = 0; i < csv->field_count; i++) {
-            free(csv->field_names[i]);
-        }
-        free(csv->field_names);
-    }
-    
-    free(csv->rows);
-    free(csv);
-}
+void generate_hex_code(uint64_t *state, char *hex, int length) {
+    if (!state || !hex || length <= 0) return;
 
-CSVData* parse_csv(const char *filename) {
-    if (!filename) {
-        fprintf(stderr, "NULL filename provided\n");
-        return NULL;
-    }
-    
-    FILE *f = fopen(filename, "r");
-    if (!f) {
-        fprintf(stderr, "Cannot open CSV file: %s\n", filename);
-        return NULL;
-    }
-    
-    CSVData *csv = calloc(1, sizeof(CSVData));
-    if (!csv) {
-        fclose(f);
-        return NULL;
-    }
-    
-    char line[MAX_CSV_LINE_LEN];
-    int capacity = 100;
-    
-    // Read header line
-    if (!fgets(line, sizeof(line), f)) {
-        free(csv);
-        fclose(f);
-        fprintf(stderr, "CSV file is empty\n");
-        return NULL;
-    }
-    
-    // Parse header with quoted field support
-    csv->field_names = NULL;
-    csv->field_count = 0;
-    int field_capacity = 50;
-    csv->field_names = malloc(field_capacity * sizeof(char*));
-    if (!csv->field_names) {
-        free(csv);
-        fclose(f);
-        return NULL;
-    }
-    
-    char *ptr = line;
-    while (*ptr && csv->field_count < MAX_CSV_FIELDS) {
-        // Skip leading whitespace
-        while (*ptr && isspace((unsigned char)*ptr)) ptr++;
-        if (!*ptr) break;
-        
-        // Check for quoted field
-        int quoted = 0;
-        char *field_start = ptr;
-        
-        if (*ptr == '"') {
-            quoted = 1;
-            field_start = ++ptr; // Skip opening quote
-        }
-        
-        // Find end of field
-        while (*ptr) {
-            if (quoted) {
-                if (*ptr == '"') {
-                    // Check if it's an escaped quote
-                    if (*(ptr+1) == '"') {
-                        ptr += 2; // Skip escaped quote
-                        continue;
-                    }
-                    break; // Closing quote found
-                }
-            } else {
-                if (*ptr == ',' || *ptr == '\n' || *ptr == '\r') break;
-            }
-            ptr++;
-        }
-        
-        // Extract field
-        char *end = ptr;
-        if (quoted && *ptr == '"') {
-            end = ptr; // Point to closing quote
-            ptr++; // Move past closing quote
-        }
-        
-        // Allocate and copy field
-        int field_len = end - field_start;
-        if (field_len < 0) {
-            field_len = 0;
-        }
-        
-        char *field = malloc(field_len + 1);
-        if (!field) {
-            fprintf(stderr, "Memory allocation error parsing CSV header\n");
-            free_csv_data(csv);
-            fclose(f);
-            return NULL;
-        }
-        
-        // Copy field content, handling escaped quotes
-        char *dest = field;
-        char *src = field_start;
-        int copied = 0;
-        while (src < end && copied < field_len) {
-            if (quoted && *src == '"' && *(src+1) == '"') {
-                *dest++ = '"';
-                src += 2;
-                copied++;
-            } else {
-                *dest++ = *src++;
-                copied++;
-            }
-        }
-        *dest = '\0';
-        
-        // Trim trailing whitespace from unquoted fields
-        if (!quoted) {
-            char *trim = field + strlen(field) - 1;
-            while (trim > field && isspace((unsigned char)*trim)) {
-                *trim-- = '\0';
-            }
-        }
-        
-        // Store field name
-        if (csv->field_count >= field_capacity) {
-            if (field_capacity >= MAX_CSV_FIELDS) break;
-            field_capacity *= 2;
-            if (field_capacity > MAX_CSV_FIELDS) field_capacity = MAX_CSV_FIELDS;
-            
-            char **new_fields = realloc(csv->field_names, field_capacity * sizeof(char*));
-            if (!new_fields) {
-                free(field);
-                break;
-            }
-            csv->field_names = new_fields;
-        }
-        csv->field_names[csv->field_count++] = field;
-        
-        // Move to next field
-        while (*ptr && (*ptr == ',' || isspace((unsigned char)*ptr))) ptr++;
-    }
-    
-    // Parse data rows
-    csv->rows = malloc(capacity * sizeof(CSVRow));
-    if (!csv->rows) {
-        free_csv_data(csv);
-        fclose(f);
-        return NULL;
-    }
-    csv->row_count = 0;
-    
-    while (fgets(line, sizeof(line), f) && csv->row_count < MAX_CSV_ROWS) {
-        // Skip empty lines
-        int empty = 1;
-        for (char *p = line; *p; p++) {
-            if (!isspace((unsigned char)*p) && *p != ',') {
-                empty = 0;
-                break;
-            }
-        }
-        if (empty) continue;
-        
-        if (csv->row_count >= capacity) {
-            if (capacity >= MAX_CSV_ROWS) break;
-            capacity *= 2;
-            if (capacity > MAX_CSV_ROWS) capacity = MAX_CSV_ROWS;
-            
-            CSVRow *new_rows = realloc(csv->rows, capacity * sizeof(CSVRow));
-            if (!new_rows) break;
-            csv->rows = new_rows;
-        }
-        
-        CSVRow *row = &csv->rows[csv->row_count];
-        row->fields = malloc(csv->field_count * sizeof(char*));
-        if (!row->fields) {
-            fprintf(stderr, "Memory allocation error for CSV row\n");
-            break;
-        }
-        row->count = 0;
-        
-        ptr = line;
-        int field_index = 0;
-        
-        while (*ptr && field_index < csv->field_count) {
-            // Skip leading whitespace
-            while (*ptr && isspace((unsigned char)*ptr)) ptr++;
-            if (!*ptr) break;
-            
-            // Check for quoted field
-            int quoted = 0;
-            char *field_start = ptr;
-            
-            if (*ptr == '"') {
-                quoted = 1;
-                field_start = ++ptr; // Skip opening quote
-            }
-            
-            // Find end of field
-            while (*ptr) {
-                if (quoted) {
-                    if (*ptr == '"') {
-                        // Check if it's an escaped quote
-                        if (*(ptr+1) == '"') {
-                            ptr += 2; // Skip escaped quote
-                            continue;
-                        }
-                        break; // Closing quote found
-                    }
-                } else {
-                    if (*ptr == ',' || *ptr == '\n' || *ptr == '\r') break;
-                }
-                ptr++;
-            }
-            
-            // Extract field
-            char *end = ptr;
-            if (quoted && *ptr == '"') {
-                end = ptr; // Point to closing quote
-                ptr++; // Move past closing quote
-            }
-            
-            // Allocate and copy field
-            int field_len = end - field_start;
-            if (field_len < 0) field_len = 0;
-            
-            char *field_val = malloc(field_len + 1);
-            if (!field_val) {
-                fprintf(stderr, "Memory allocation error parsing CSV data\n");
-                // Clean up partial row
-                for (int i = 0; i < row->count; i++) free(row->fields[i]);
-                free(row->fields);
-                break;
-            }
-            
-            // Copy field content, handling escaped quotes
-            char *dest = field_val;
-            char *src = field_start;
-            int copied = 0;
-            while (src < end && copied < field_len) {
-                if (quoted && *src == '"' && *(src+1) == '"') {
-                    *dest++ = '"';
-                    src += 2;
-                    copied++;
-                } else {
-                    *dest++ = *src++;
-                    copied++;
-                }
-            }
-            *dest = '\0';
-            
-            // Trim trailing whitespace from unquoted fields
-            if (!quoted) {
-                char *trim = field_val + strlen(field_val) - 1;
-                while (trim > field_val && isspace((unsigned char)*trim)) {
-                    *trim-- = '\0';
-                }
-            }
-            
-            row->fields[field_index++] = field_val;
-            row->count++;
-            
-            // Move to next field
-            while (*ptr && (*ptr == ',' || isspace((unsigned char)*ptr))) ptr++;
-        }
-        
-        // Fill missing fields with empty strings
-        while (field_index < csv->field_count) {
-            row->fields[field_index] = strdup("");
-            if (!row->fields[field_index]) {
-                break;
-            }
-            row->count++;
-            field_index++;
-        }
-        
-        csv->row_count++;
+    const char hex_chars[] = "0123456789ABCDEF";
+    uint64_t x = *state;
+    for (int i = 0; i < length && i < HEX_LENGTH; ++i) {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        hex[i] = hex_chars[x >> 60];
     }
-    
-    fclose(f);
-    return csv;
+    *state = x;
+    hex[length] = '\0';
 }
 
 // Drawing functions
@@ -395,6 +112,13 @@ void draw_qr_code(HPDF_Page page, float x, float y, float size, const char *text
         return;
     }
 
+    draw_qr_modules(page, x, y, size, qrcode);
+}
+
+// Draw an already encoded QR symbol, one rectangle per horizontal run of modules
+void draw_qr_modules(HPDF_Page page, float x, float y, float size, const uint8_t *qrcode) {
+    if (!page || !qrcode || size <= 0) return;
+
     int qr_size = qrcodegen_getSize(qrcode);
     if (qr_size <= 0) return;
     
@@ -404,10 +128,15 @@ void draw_qr_code(HPDF_Page page, float x, float y, float size, const char *text
     HPDF_Page_Concat(page, scale, 0, 0, scale, x, y);
 
     for (int iy = 0; iy < qr_size; iy++) {
-        for (int ix = 0; ix < qr_size; ix++) {
-            if (qrcodegen_getModule(qrcode, ix, iy)) {
-                HPDF_Page_Rectangle(page, ix, qr_size - 1 - iy, 1, 1);
+        int ix = 0;
+        while (ix < qr_size) {
+            if (!qrcodegen_getModule(qrcode, ix, iy)) {
+                ix++;
+                continue;
             }
+            int run_start = ix;
+            while (ix < qr_size && qrcodegen_getModule(qrcode, ix, iy)) ix++;
+            HPDF_Page_Rectangle(page, run_start, qr_size - 1 - iy, ix - run_start, 1);
         }
     }
 
@@ -415,115 +144,219 @@ void draw_qr_code(HPDF_Page page, float x, float y, float size, const char *text
     HPDF_Page_GRestore(page);
 }
 
-void draw_text_in_box(HPDF_Page page, HPDF_Font font,
-                      float x_start, float x_end, float y_start, float y_end,
-                      const char *text, float font_size, int align) {
-    if (!page || !font || !text || font_size <= 0) return;
-    if (x_end <= x_start || y_end <= y_start) return;
+// The symbol as a stencil mask of one bit per module, painted in the fill color
+HPDF_Image create_qr_image(HPDF_Doc pdf, const uint8_t *qrcode) {
+    if (!pdf || !qrcode) return NULL;
 
-    const float padding = 5.0f;
-    const float box_width = (x_end - x_start) - 2 * padding;
-    const float box_height = (y_end - y_start) - 2 * padding;
-    if (box_width <= 0 || box_height <= 0) return;
+    int qr_size = qrcodegen_getSize(qrcode);
+    if (qr_size <= 0) return NULL;
 
-    char *buf = strdup(text);
-    if (!buf) return;
+    int stride = (qr_size + 7) / 8;
+    uint8_t bits[((qrcodegen_VERSION_MAX * 4 + 17) + 7) / 8 * (qrcodegen_VERSION_MAX * 4 + 17)];
 
-    // Split words
-    char *words[1024];
-    int wc = 0;
-    char *tok, *saveptr = NULL;
-    for (tok = strtok_r(buf, " ", &saveptr);
-         tok && wc < 1023;
-         tok = strtok_r(NULL, " ", &saveptr))
-        words[wc++] = tok;
-    words[wc] = NULL;
-
-
-    float test_size = font_size;
-    int fits = 0;// lines_used = 0;
-
-    while (!fits && test_size >= 6.0f) {
-        HPDF_Page_SetFontAndSize(page, font, test_size);
-        float line_height = test_size * 1.2f;
-        int lines = 1;
-        float line_width = 0.0f;
-
-        for (int i = 0; i < wc; i++) {
-            float word_width = HPDF_Page_TextWidth(page, words[i]);
-            float space_width = HPDF_Page_TextWidth(page, " ");
-
-            if (line_width == 0)
-                line_width = word_width;
-            else if (line_width + space_width + word_width > box_width) {
-                lines++;
-                line_width = word_width;
-            } else {
-                line_width += space_width + word_width;
+    // Image rows run top to bottom; a clear bit is a dark module
+    memset(bits, 0xFF, (size_t)stride * qr_size);
+    for (int iy = 0; iy < qr_size; iy++) {
+        uint8_t *line = bits + iy * stride;
+        for (int ix = 0; ix < qr_size; ix++) {
+            if (qrcodegen_getModule(qrcode, ix, iy)) {
+                line[ix >> 3] &= (uint8_t)~(0x80 >> (ix & 7));
             }
         }
+    }
 
-        if (lines * line_height <= box_height) {
-            fits = 1;
-            //lines_used = lines;
-        } else {
-            test_size -= 1.0f;
-        }
+    return HPDF_LoadImageMaskFromMem(pdf, bits, qr_size, qr_size);
+}
+
+// Same result as HPDF_Page_TextWidth with the font selected, without needing a page
+float text_width(HPDF_Font font, float font_size, const char *text) {
+    HPDF_UINT len = (HPDF_UINT)strlen(text);
+    if (len == 0) return 0;
+
+    HPDF_TextWidth tw = HPDF_Font_TextWidth(font, (const HPDF_BYTE*)text, len);
+    return tw.width * font_size / 1000;
+}
+
+// Measure every code once; later measurements only sum table entries
+void font_metrics_init(FontMetrics *metrics, HPDF_Font font) {
+    memset(metrics, 0, sizeof(*metrics));
+    metrics->font = font;
+    if (!font) return;
+
+    for (int c = 1; c < 256; c++) {
+        HPDF_BYTE code = (HPDF_BYTE)c;
+        metrics->advance[c] = (uint16_t)HPDF_Font_TextWidth(font, &code, 1).width;
     }
+}
 
-    HPDF_Page_SetFontAndSize(page, font, test_size);
-    const float line_height = test_size * 1.2f;
+// Same total as HPDF_Font_TextWidth, which adds up the same per-code widths
+uint32_t metrics_text_units(const FontMetrics *metrics, const char *text, size_t len) {
+    const unsigned char *p = (const unsigned char*)text;
+    const uint16_t *advance = metrics->advance;
+    uint32_t w0 = 0, w1 = 0, w2 = 0, w3 = 0;
+    size_t i = 0;
+
+    for (; i + 4 <= len; i += 4) {
+        w0 += advance[p[i]];
+        w1 += advance[p[i + 1]];
+        w2 += advance[p[i + 2]];
+        w3 += advance[p[i + 3]];
+    }
+    for (; i < len; i++) {
+        w0 += advance[p[i]];
+    }
+    return w0 + w1 + w2 + w3;
+}
 
+float metrics_text_width(const FontMetrics *metrics, float font_size, const char *text, size_t len) {
+    return (float)metrics_text_units(metrics, text, len) * font_size / 1000;
+}
+
+void draw_text_in_box(HPDF_Page page, HPDF_Font font,
+                      float x_start, float x_end, float y_start, float y_end,
+                      const char *text, float font_size, int align) {
+    if (!page || !font || !text || font_size <= 0) return;
 
-    HPDF_Page_BeginText(page);
+    LabelLayout layout;
+    memset(&layout, 0, sizeof(layout));
 
-    //float total_height = lines_used * line_height;
-    float y_cursor = y_end - padding - test_size; // top-down baseline
+    FontMetrics metrics;
+    font_metrics_init(&metrics, font);
 
-    char line[2048] = "";
-    for (int i = 0; i < wc; i++) {
-        char candidate[2048];
-        snprintf(candidate, sizeof(candidate), "%s%s%s",
-                 line, (strlen(line) > 0 ? " " : ""), words[i]);
+    float size = layout_text_in_box(&layout, &metrics, x_start, x_end, y_start, y_end, text, font_size, align);
+    if (size > 0) {
+        HPDF_Page_BeginText(page);
+        HPDF_Page_SetFontAndSize(page, font, size);
+        for (int i = 0; i < layout.run_count; i++) {
+            TextRun *run = &layout.runs[i];
+            HPDF_Page_TextOut(page, run->x, run->y, layout.strings + run->text);
+        }
+        HPDF_Page_EndText(page);
+    }
 
-        float candidate_width = HPDF_Page_TextWidth(page, candidate);
+    layout_free(&layout);
+}
 
-        if (candidate_width > box_width && strlen(line) > 0) {
-            // Draw current line
-            float lw = HPDF_Page_TextWidth(page, line);
-            float x_offset = x_start + padding;
+typedef struct {
+    const char *text;
+    size_t len;
+    float width;                // glyph space units
+} WrapWord;
+
+// Greedy line breaking: a word starts a new line when it would make the line
+// wider than limit (in glyph space units). Stores the first word of every
+// line in starts when given and returns the number of lines.
+static int wrap_words(const WrapWord *words, int count, float space, float limit, int *starts) {
+    int lines = 1;
+    float line_width = 0.0f;
+
+    if (starts) starts[0] = 0;
+    for (int i = 0; i < count; i++) {
+        if (i > 0 && line_width + space + words[i].width > limit) {
+            if (starts) starts[lines] = i;
+            lines++;
+            line_width = words[i].width;
+        } else {
+            line_width += (i > 0 ? space : 0) + words[i].width;
+        }
+    }
+    return lines;
+}
 
-            if (align == 1) // center
-                x_offset = x_start + (box_width - lw) / 2.0f + padding;
-            else if (align == 2) // right
-                x_offset = x_end - lw - padding;
+static int wrap_fits(const WrapWord *words, int count, float space,
+                     float box_width, float box_height, float size) {
+    int lines = wrap_words(words, count, space, box_width * 1000 / size, NULL);
+    return lines * (size * 1.2f) <= box_height;
+}
 
-            HPDF_Page_TextOut(page, x_offset, y_cursor, line);
+// Wrap text into the box, appending one run per line; returns the font size used or 0.
+// Tries sizes from font_size down in steps of 1 (not below 6) and keeps the
+// largest that fits; every word is measured once.
+float layout_text_in_box(LabelLayout *layout, const FontMetrics *metrics,
+                         float x_start, float x_end, float y_start, float y_end,
+                         const char *text, float font_size, int align) {
+    if (!layout || !metrics || !metrics->font || !text || font_size <= 0) return 0;
+    if (x_end <= x_start || y_end <= y_start) return 0;
 
-            y_cursor -= line_height;
-            if (y_cursor < y_start + padding) break;
+    const float padding = 5.0f;
+    const float box_width = (x_end - x_start) - 2 * padding;
+    const float box_height = (y_end - y_start) - 2 * padding;
+    if (box_width <= 0 || box_height <= 0) return 0;
 
-            snprintf(line, sizeof(line), "%s", words[i]);
+    // Split words on spaces
+    WrapWord words[1023];
+    int wc = 0;
+    const char *p = text;
+    while (wc < 1023) {
+        while (*p == ' ') p++;
+        if (*p == '\0') break;
+
+        const char *end = p;
+        while (*end != '\0' && *end != ' ') end++;
+
+        words[wc].text = p;
+        words[wc].len = (size_t)(end - p);
+        words[wc].width = (float)metrics_text_units(metrics, p, words[wc].len);
+        layout->stats.glyphs += (uint32_t)words[wc].len;
+        wc++;
+        p = end;
+    }
+    const float space = metrics->advance[' '];
+
+    // Fitting is monotonic in the size: find the first step that fits
+    int steps = font_size >= 6.0f ? (int)(font_size - 6.0f) + 1 : 0;
+    int lo = 0, hi = steps;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (wrap_fits(words, wc, space, box_width, box_height, font_size - mid)) {
+            hi = mid;
         } else {
-            snprintf(line, sizeof(line), "%s", candidate);
+            lo = mid + 1;
         }
     }
+    const float test_size = font_size - lo;
+    const float line_height = test_size * 1.2f;
 
-    // Draw last line if any
-    if (strlen(line) > 0 && y_cursor >= y_start + padding) {
-        float lw = HPDF_Page_TextWidth(page, line);
+    int starts[1024];
+    int lines = wc > 0 ? wrap_words(words, wc, space, box_width * 1000 / test_size, starts) : 0;
+
+    float y_cursor = y_end - padding - test_size; // top-down baseline
+    char line[2048];
+
+    for (int l = 0; l < lines && y_cursor >= y_start + padding; l++) {
+        int first = starts[l];
+        int last = l + 1 < lines ? starts[l + 1] : wc;
+
+        size_t len = 0;
+        float units = 0;
+        for (int i = first; i < last; i++) {
+            size_t n = words[i].len;
+            if (i > first) {
+                if (len + 1 >= sizeof(line)) break;
+                line[len++] = ' ';
+                units += space;
+            }
+            if (len + n >= sizeof(line)) n = sizeof(line) - 1 - len;
+            memcpy(line + len, words[i].text, n);
+            len += n;
+            units += words[i].width;
+        }
+        line[len] = '\0';
+
+        float lw = units * test_size / 1000;
         float x_offset = x_start + padding;
 
-        if (align == 1)
+        if (align == 1) // center
             x_offset = x_start + (box_width - lw) / 2.0f + padding;
-        else if (align == 2)
+        else if (align == 2) // right
             x_offset = x_end - lw - padding;
 
-        HPDF_Page_TextOut(page, x_offset, y_cursor, line);
+        layout_add_run(layout, x_offset, y_cursor, layout_add_string(layout, line, len));
+
+        y_cursor -= line_height;
     }
 
-    HPDF_Page_EndText(page);
-    free(buf);
+    return test_size;
 }
 
 
@@ -535,6 +368,109 @@ int parse_align(const char *s) {
     return 0;
 }
 
+// "none", "fast", "default", "best" or a level 0-9, optionally followed by
+// ",filtered", ",huffman" or ",rle" for the deflate strategy
+int parse_compression(const char *s, CompressionConfig *config) {
+    if (!s || !config) return -1;
+
+    char level[16];
+    const char *comma = strchr(s, ',');
+    size_t len = comma ? (size_t)(comma - s) : strlen(s);
+    if (len == 0 || len >= sizeof(level)) return -1;
+    memcpy(level, s, len);
+    level[len] = '\0';
+
+    if (strcmp(level, "none") == 0) config->level = COMPRESSION_NONE;
+    else if (strcmp(level, "fast") == 0) config->level = HPDF_COMP_LEVEL_BEST_SPEED;
+    else if (strcmp(level, "default") == 0) config->level = HPDF_COMP_LEVEL_DEFAULT;
+    else if (strcmp(level, "best") == 0) config->level = HPDF_COMP_LEVEL_BEST;
+    else if (len == 1 && isdigit((unsigned char)level[0])) config->level = level[0] - '0';
+    else return -1;
+
+    config->strategy = HPDF_COMP_STRATEGY_DEFAULT;
+    if (comma) {
+        const char *strategy = comma + 1;
+        if (strcmp(strategy, "filtered") == 0) config->strategy = HPDF_COMP_STRATEGY_FILTERED;
+        else if (strcmp(strategy, "huffman") == 0) config->strategy = HPDF_COMP_STRATEGY_HUFFMAN;
+        else if (strcmp(strategy, "rle") == 0) config->strategy = HPDF_COMP_STRATEGY_RLE;
+        else if (strcmp(strategy, "default") != 0) return -1;
+    }
+    return 0;
+}
+
+// A CSV separator from the command line: the character itself, "tab" or
+// "\t", or "none" (stored as '\0') for no quote or escape character
+int parse_csv_char(const char *s, char *out) {
+    if (!s || !out) return -1;
+    if (strcmp(s, "tab") == 0 || strcmp(s, "\\t") == 0) *out = '\t';
+    else if (strcmp(s, "none") == 0) *out = '\0';
+    else if (strlen(s) == 1 && s[0] != '\n' && s[0] != '\r') *out = s[0];
+    else return -1;
+    return 0;
+}
+
+// Row number at *p, which is moved past it; -1 when there is none
+static int parse_row_number(const char **p) {
+    if (**p < '0' || **p > '9') return -1;
+    long n = 0;
+    while (**p >= '0' && **p <= '9') {
+        n = n * 10 + (**p - '0');
+        if (n >= INT_MAX) return -1;
+        (*p)++;
+    }
+    return (int)n;
+}
+
+// --rows: a comma separated list of data rows (12), ranges (5000-5999),
+// open ranges (5000-) and ranges with a step (0-999:10), counted from 0
+int parse_row_ranges(const char *s, CSVSelection *selection) {
+    if (!s || !selection || *s == '\0') return -1;
+    const char *p = s;
+
+    for (;;) {
+        if (selection->range_count >= MAX_ROW_RANGES) return -1;
+        CSVRowRange range;
+        range.start = parse_row_number(&p);
+        if (range.start < 0) return -1;
+        range.end = range.start;
+        range.step = 1;
+
+        if (*p == '-') {
+            p++;
+            range.end = *p >= '0' && *p <= '9' ? parse_row_number(&p) : INT_MAX;
+            if (range.end < range.start) return -1;
+        }
+        if (*p == ':') {
+            p++;
+            range.step = parse_row_number(&p);
+            if (range.step < 1) return -1;
+        }
+        selection->ranges[selection->range_count++] = range;
+
+        if (*p == '\0') return 0;
+        if (*p++ != ',') return -1;
+    }
+}
+
+// --where: field=value or field!=value, compared with the whole value
+int parse_row_condition(const char *s, CSVSelection *selection) {
+    if (!s || !selection || selection->condition_count >= MAX_ROW_CONDITIONS) return -1;
+    const char *eq = strchr(s, '=');
+    if (!eq) return -1;
+
+    CSVRowCondition *c = &selection->conditions[selection->condition_count];
+    c->negate = eq > s && eq[-1] == '!';
+    c->field = s;
+    c->field_length = (int)(eq - s) - c->negate;
+    c->value = eq + 1;
+    c->value_length = (int)strlen(c->value);
+    c->column = -1;
+    if (c->field_length <= 0) return -1;
+
+    selection->condition_count++;
+    return 0;
+}
+
 HPDF_PageSizes parse_page_size(const char *s) {
     if (!s) return HPDF_PAGE_SIZE_A4;
     if (strcmp(s, "A3") == 0) return HPDF_PAGE_SIZE_A3;
@@ -568,7 +504,7 @@ int load_page_config_from_json(cJSON *root, PageConfig *config) {
     config->line_width = (float)(cJSON_GetObjectItem(jpage, "line_width") ? cJSON_GetObjectItem(jpage, "line_width")->valuedouble : 3.0f);
 
     if (config->line_width <= 0.0f) {
-        fprintf(stderr, "Warning: line_width must be positive, using default 3.0\n");
+        log_message(LOG_WARNING, "Warning: line_width must be positive, using default 3.0\n");
         config->line_width = 3.0f;
     }
 
@@ -597,7 +533,7 @@ int load_fonts_from_json(cJSON *root, FontConfig *font_config, HPDF_Doc pdf) {
     if (jcustom && cJSON_IsArray(jcustom)) {
         int count = cJSON_GetArraySize(jcustom);
         if (count > MAX_CUSTOM_FONTS) {
-            fprintf(stderr, "Warning: Too many custom fonts (%d), limiting to %d\n", count, MAX_CUSTOM_FONTS);
+            log_message(LOG_WARNING, "Warning: Too many custom fonts (%d), limiting to %d\n", count, MAX_CUSTOM_FONTS);
             count = MAX_CUSTOM_FONTS;
         }
         
@@ -628,9 +564,9 @@ int load_fonts_from_json(cJSON *root, FontConfig *font_config, HPDF_Doc pdf) {
                 
                 const char *loaded_font_name = HPDF_LoadTTFontFromFile(pdf, font->file, HPDF_TRUE);
                 if (!loaded_font_name) {
-                    fprintf(stderr, "Warning: Could not load font file: %s\n", font->file);
+                    log_message(LOG_WARNING, "Warning: Could not load font file: %s\n", font->file);
                 } else {
-                    printf("Loaded font: %s from %s\n", font->name, font->file);
+                    log_message(LOG_INFO, "Loaded font: %s from %s\n", font->name, font->file);
                 }
                 
                 font_config->custom_font_count++;
@@ -641,132 +577,6 @@ int load_fonts_from_json(cJSON *root, FontConfig *font_config, HPDF_Doc pdf) {
     return 0;
 }
 
-int load_fields_from_json(cJSON *root, Field **out_fields, int *out_count, 
-                         const char *hex_code, CSVData *csv, int csv_row_index)
-{
-    if (!root || !out_fields || !out_count || !hex_code) return -1;
-
-    cJSON *jfields = cJSON_GetObjectItem(root, "fields");
-    if (!jfields || !cJSON_IsArray(jfields)) return -1;
-
-    int count = cJSON_GetArraySize(jfields);
-    if (count > MAX_FIELD_COUNT) {
-        fprintf(stderr, "Warning: Too many fields (%d), limiting to %d\n", count, MAX_FIELD_COUNT);
-        count = MAX_FIELD_COUNT;
-    }
-    
-    Field *arr = (Field*)calloc(count, sizeof(Field));
-    if (!arr) return -2;
-
-    int valid_count = 0;
-
-    for (int i = 0; i < count; ++i) {
-        cJSON *it = cJSON_GetArrayItem(jfields, i);
-        if (!it || !cJSON_IsObject(it))
-            continue;
-
-        Field tmp;
-        memset(&tmp, 0, sizeof(tmp));
-
-        // Required numeric fields
-        cJSON *x_start    = cJSON_GetObjectItem(it, "x_start");
-        cJSON *x_end      = cJSON_GetObjectItem(it, "x_end");
-        cJSON *y_start    = cJSON_GetObjectItem(it, "y_start");
-        cJSON *y_end      = cJSON_GetObjectItem(it, "y_end");
-        cJSON *font_size  = cJSON_GetObjectItem(it, "font_size");
-
-        if (!cJSON_IsNumber(x_start) ||
-            !cJSON_IsNumber(x_end)   ||
-            !cJSON_IsNumber(y_start) ||
-            !cJSON_IsNumber(y_end)   ||
-            !cJSON_IsNumber(font_size))
-        {
-            fprintf(stderr, "Warning: Field %d: missing/wrong type in required numeric field. Skipping.\n", i);
-            continue;
-        }
-
-        tmp.x_start   = (float)x_start->valuedouble;
-        tmp.x_end     = (float)x_end->valuedouble;
-        tmp.y_start   = (float)y_start->valuedouble;
-        tmp.y_end     = (float)y_end->valuedouble;
-        tmp.font_size = (float)font_size->valuedouble;
-
-
-        cJSON *jwrap = cJSON_GetObjectItem(it, "wrap");
-        if (cJSON_IsBool(jwrap))
-            tmp.wrap = cJSON_IsTrue(jwrap);
-        else if (cJSON_IsNumber(jwrap))
-            tmp.wrap = jwrap->valueint != 0;
-        else
-            tmp.wrap = 0;
-
-
-        cJSON *jalign = cJSON_GetObjectItem(it, "align");
-        const char *align_s = (cJSON_IsString(jalign) ? jalign->valuestring : "left");
-        tmp.align = parse_align(align_s);
-
-        // font name
-        cJSON *jfont = cJSON_GetObjectItem(it, "font_name");
-        if (cJSON_IsString(jfont))
-            safe_strncpy(tmp.font_name, jfont->valuestring, sizeof(tmp.font_name));
-        else
-            tmp.font_name[0] = '\0';
-
-        //max length field truncate function
-        cJSON *jmax_len = cJSON_GetObjectItem(it, "max_length");
-        if (cJSON_IsNumber(jmax_len)) {
-            tmp.max_length = jmax_len->valueint;
-            if (tmp.max_length < 0) tmp.max_length = 0;
-            if (tmp.max_length > MAX_FIELD_LEN) tmp.max_length = MAX_FIELD_LEN;
-        } else {
-            tmp.max_length = 0;
-        }
-
-
-        cJSON *jtext = cJSON_GetObjectItem(it, "text");
-        const char *txt = (cJSON_IsString(jtext) ? jtext->valuestring : "");
-
-        // set CSV field substitution character
-        if (txt[0] == '$' && csv && csv_row_index >= 0 && csv_row_index < csv->row_count) {
-
-            char field_name[256];
-            safe_strncpy(field_name, txt + 1, sizeof(field_name));
-
-            int found = 0;
-            for (int c = 0; c < csv->field_count; c++) {
-                if (strcmp(csv->field_names[c], field_name) == 0) {
-                    const char *val = csv->rows[csv_row_index].fields[c];
-
-                    size_t len = strlen(val);
-                    if (tmp.max_length > 0 && len > (size_t)tmp.max_length) {
-                        safe_strncpy(tmp.text, val, tmp.max_length + 1);
-                        printf("Notice: Truncated field '%s'\n", field_name);
-                    } else {
-                        safe_strncpy(tmp.text, val, sizeof(tmp.text));
-                    }
-                    found = 1;
-                    break;
-                }
-            }
-            if (!found)
-                safe_strncpy(tmp.text, txt, sizeof(tmp.text));
-        }
-        else if (!strcmp(txt, "HEX_CODE") || !strcmp(txt, "RANDOM_HEX")) {
-            safe_strncpy(tmp.text, hex_code, sizeof(tmp.text));
-        }
-        else {
-            safe_strncpy(tmp.text, txt, sizeof(tmp.text));
-        }
-
-        // Add validated item to list
-        arr[valid_count++] = tmp;
-    }
-
-    *out_fields = arr;
-    *out_count = valid_count;
-    return 0;
-}
-
 int load_lines_from_json(cJSON *root, LineEntry **out_lines, int *out_count) {
     if (!root || !out_lines || !out_count) return -1;
     
@@ -779,7 +589,7 @@ int load_lines_from_json(cJSON *root, LineEntry **out_lines, int *out_count) {
     
     int count = cJSON_GetArraySize(jlines);
     if (count > MAX_LINE_COUNT) {
-        fprintf(stderr, "Warning: Too many lines (%d), limiting to %d\n", count, MAX_LINE_COUNT);
+        log_message(LOG_WARNING, "Warning: Too many lines (%d), limiting to %d\n", count, MAX_LINE_COUNT);
         count = MAX_LINE_COUNT;
     }
     
@@ -798,7 +608,7 @@ int load_lines_from_json(cJSON *root, LineEntry **out_lines, int *out_count) {
             arr[i].type = LINE_H_TRANSFORM;
             cJSON *jy = cJSON_GetObjectItem(it, "y");
             if (!jy) {
-                fprintf(stderr, "Warning: Missing 'y' for horizontal_transform line, using default\n");
+                log_message(LOG_WARNING, "Warning: Missing 'y' for horizontal_transform line, using default\n");
                 arr[i].y = 0.0f;
             } else {
                 arr[i].y = (float)jy->valuedouble;
@@ -824,7 +634,7 @@ int load_lines_from_json(cJSON *root, LineEntry **out_lines, int *out_count) {
         if (jwidth && cJSON_IsNumber(jwidth)) {
             arr[i].width = (float)jwidth->valuedouble;
             if (arr[i].width <= 0.0f) {
-                fprintf(stderr, "Warning: Line %d width must be positive, using 1.0\n", i);
+                log_message(LOG_WARNING, "Warning: Line %d width must be positive, using 1.0\n", i);
                 arr[i].width = 1.0f;
             }
         }
@@ -836,143 +646,6 @@ int load_lines_from_json(cJSON *root, LineEntry **out_lines, int *out_count) {
 
 
 
-int load_qr_from_json(cJSON *root, QRCodeEntry *qr_entry, const char *hex_code, CSVData *csv, int csv_row_index) {
-    if (!root || !qr_entry) return -1;
-    
-    cJSON *jqr = cJSON_GetObjectItem(root, "qr_code");
-    if (!jqr) {
-        // No QR code configuration found, disable it
-        qr_entry->enabled = 0;
-        return 0;
-    }
-    
-    // Set defaults
-    qr_entry->x = 192.0f;
-    qr_entry->y = 1.0f;
-    qr_entry->size = 113.4f;
-    qr_entry->text[0] = '\0';
-    qr_entry->enabled = 1;  // Enable by default if config exists
-    
-    // Safely get values with null checks
-    cJSON *jx = cJSON_GetObjectItem(jqr, "x");
-    cJSON *jy = cJSON_GetObjectItem(jqr, "y");
-    cJSON *jsize = cJSON_GetObjectItem(jqr, "size");
-    cJSON *jenabled = cJSON_GetObjectItem(jqr, "enabled");
-    
-    if (jx) qr_entry->x = (float)jx->valuedouble;
-    if (jy) qr_entry->y = (float)jy->valuedouble;
-    if (jsize) qr_entry->size = (float)jsize->valuedouble;
-    if (jenabled) qr_entry->enabled = cJSON_IsTrue(jenabled) ? 1 : 0;
-    
-    const char *t = cJSON_GetObjectItem(jqr, "text") && cJSON_GetObjectItem(jqr, "text")->valuestring
-                    ? cJSON_GetObjectItem(jqr, "text")->valuestring : "";
-    
-    // Process text (same logic as fields and barcodes)
-    if (t[0] == '$' && csv && csv_row_index >= 0 && csv_row_index < csv->row_count) {
-        char field_name[256];
-        safe_strncpy(field_name, t + 1, sizeof(field_name));
-        
-        int found = 0;
-        for (int j = 0; j < csv->field_count; j++) {
-            if (strcmp(csv->field_names[j], field_name) == 0) {
-                if (j < csv->rows[csv_row_index].count) {
-                    safe_strncpy(qr_entry->text, csv->rows[csv_row_index].fields[j], sizeof(qr_entry->text));
-                    found = 1;
-                }
-                break;
-            }
-        }
-        if (!found) {
-            safe_strncpy(qr_entry->text, t, sizeof(qr_entry->text));
-        }
-    }
-    else if (strcmp(t, "HEX_CODE") == 0 || strcmp(t, "RANDOM_HEX") == 0) {
-        safe_strncpy(qr_entry->text, hex_code, sizeof(qr_entry->text));
-    } else {
-        safe_strncpy(qr_entry->text, t, sizeof(qr_entry->text));
-    }
-    
-    return 0;
-}
-
-
-int load_barcodes_from_json(cJSON *root, BarcodeEntry **out_barcodes, int *out_count, 
-                           const char *hex_code, CSVData *csv, int csv_row_index) {
-    if (!root || !out_barcodes || !out_count || !hex_code) return -1;
-
-    cJSON *jbarcodes = cJSON_GetObjectItem(root, "barcodes");
-    if (!jbarcodes || !cJSON_IsArray(jbarcodes)) {
-        *out_barcodes = NULL;
-        *out_count = 0;
-        return 0;
-    }
-
-    int count = cJSON_GetArraySize(jbarcodes);
-    if (count > MAX_FIELD_COUNT) {
-        fprintf(stderr, "Warning: Too many barcodes (%d), limiting to %d\n", count, MAX_FIELD_COUNT);
-        count = MAX_FIELD_COUNT;
-    }
-    
-    BarcodeEntry *arr = (BarcodeEntry*)calloc(count, sizeof(BarcodeEntry));
-    if (!arr) return -2;
-
-    for (int i = 0; i < count; ++i) {
-        cJSON *it = cJSON_GetArrayItem(jbarcodes, i);
-        if (!it) continue;
-
-        // Get required fields
-        cJSON *jx = cJSON_GetObjectItem(it, "x");
-        cJSON *jy = cJSON_GetObjectItem(it, "y");
-        cJSON *jwidth = cJSON_GetObjectItem(it, "width");
-        cJSON *jheight = cJSON_GetObjectItem(it, "height");
-        cJSON *jtype = cJSON_GetObjectItem(it, "type");
-        
-        if (!jx || !jy || !jwidth || !jheight || !jtype) {
-            fprintf(stderr, "Warning: Missing required barcode field in barcode %d, skipping\n", i);
-            continue;
-        }
-
-        arr[i].x = (float)jx->valuedouble;
-        arr[i].y = (float)jy->valuedouble;
-        arr[i].width = (float)jwidth->valuedouble;
-        arr[i].height = (float)jheight->valuedouble;
-        
-        safe_strncpy(arr[i].type, jtype->valuestring, sizeof(arr[i].type));
-
-        const char *txt = cJSON_GetObjectItem(it, "text") && cJSON_GetObjectItem(it, "text")->valuestring
-                          ? cJSON_GetObjectItem(it, "text")->valuestring : "";
-        
-        // Process text (same logic as fields)
-        if (txt[0] == '$' && csv && csv_row_index >= 0 && csv_row_index < csv->row_count) {
-            char field_name[256];
-            safe_strncpy(field_name, txt + 1, sizeof(field_name));
-            
-            int found = 0;
-            for (int j = 0; j < csv->field_count; j++) {
-                if (strcmp(csv->field_names[j], field_name) == 0) {
-                    if (j < csv->rows[csv_row_index].count) {
-                        safe_strncpy(arr[i].text, csv->rows[csv_row_index].fields[j], sizeof(arr[i].text));
-                        found = 1;
-                    }
-                    break;
-                }
-            }
-            if (!found) {
-                safe_strncpy(arr[i].text, txt, sizeof(arr[i].text));
-            }
-        }
-        else if (strcmp(txt, "HEX_CODE") == 0 || strcmp(txt, "RANDOM_HEX") == 0) {
-            safe_strncpy(arr[i].text, hex_code, sizeof(arr[i].text));
-        } else {
-            safe_strncpy(arr[i].text, txt, sizeof(arr[i].text));
-        }
-    }
-
-    *out_barcodes = arr;
-    *out_count = count;
-    return 0;
-}
-
 void draw_barcode_entry(HPDF_Page page, BarcodeEntry *barcode) {
     if (!page || !barcode) return;
     
@@ -984,13 +657,13 @@ void draw_barcode_entry(HPDF_Page page, BarcodeEntry *barcode) {
     } else if (strcmp(barcode->type, "upca") == 0) {
         type = BARCODE_UPCA;
     } else {
-        fprintf(stderr, "Warning: Unknown barcode type: %s\n", barcode->type);
+        log_message(LOG_WARNING, "Warning: Unknown barcode type: %s\n", barcode->type);
         return;
     }
     
     // Validate barcode data before drawing
     if (!validate_barcode_data(type, barcode->text)) {
-        fprintf(stderr, "Warning: Invalid barcode data for type %s: %s\n", barcode->type, barcode->text);
+        log_message(LOG_WARNING, "Warning: Invalid barcode data for type %s: %s\n", barcode->type, barcode->text);
         return;
     }
     
@@ -1002,19 +675,75 @@ int validate_json_config(cJSON *root) {
     
     cJSON *jpage = cJSON_GetObjectItem(root, "page");
     if (!jpage) {
-        fprintf(stderr, "Error: Missing 'page' section in config\n");
+        log_message(LOG_ERROR, "Error: Missing 'page' section in config\n");
         return -1;
     }
     
     cJSON *jfields = cJSON_GetObjectItem(root, "fields");
     if (!jfields || !cJSON_IsArray(jfields)) {
-        fprintf(stderr, "Error: Missing or invalid 'fields' array in config\n");
+        log_message(LOG_ERROR, "Error: Missing or invalid 'fields' array in config\n");
         return -1;
     }
     
     return 0;
 }
 
+// Read, parse and validate the config file; NULL (with the reason printed)
+// if any step fails
+cJSON* load_json_config(const char *config_filename) {
+    FILE *f = fopen(config_filename, "rb");
+    if (!f) {
+        log_message(LOG_ERROR, "Cannot open config file: %s\n", config_filename);
+        return NULL;
+    }
+    
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    if (size > MAX_CONFIG_SIZE) {
+        log_message(LOG_ERROR, "Error: Config file too large: %ld bytes (max: %d)\n", size, MAX_CONFIG_SIZE);
+        fclose(f);
+        return NULL;
+    }
+    rewind(f);
+    
+    char *data = (char*)malloc(size + 1);
+    if (!data) {
+        log_message(LOG_ERROR, "Memory allocation error\n");
+        fclose(f);
+        return NULL;
+    }
+    
+    size_t read_size = fread(data, 1, size, f);
+    if (read_size != (size_t)size) {
+        log_message(LOG_ERROR, "Error reading config file\n");
+        free(data);
+        fclose(f);
+        return NULL;
+    }
+    
+    data[size] = '\0';
+    fclose(f);
+
+    cJSON *root = cJSON_Parse(data);
+    free(data);
+    
+    if (!root) {
+        const char *error_ptr = cJSON_GetErrorPtr();
+        if (error_ptr) {
+            log_message(LOG_ERROR, "Error parsing JSON config file '%s' before: %s\n", config_filename, error_ptr);
+        }
+        return NULL;
+    }
+
+    if (validate_json_config(root) != 0) {
+        log_message(LOG_ERROR, "Invalid JSON configuration in '%s'\n", config_filename);
+        cJSON_Delete(root);
+        return NULL;
+    }
+
+    return root;
+}
+
 // Command Line Help
 void print_version() {
     printf("FDCLabel - Fast Dynamic C Label Generator\n");
@@ -1026,11 +755,41 @@ void print_version() {
 void print_help(const char *program_name) {
     printf("Usage: %s <csv_file> [options]\n", program_name);
     printf("\nRequired:\n");
-    printf("  csv_file              Path to CSV data file\n");
+    printf("  csv_file              Path to CSV data file, - to read from stdin\n");
     printf("\nOptions:\n");
     printf("  -c, --config FILE     JSON configuration file (default: config.json)\n");
     printf("  -o, --output FILE     Output PDF filename (default: labels.pdf)\n");
     printf("  -r, --row INDEX       Process specific row only (default: all rows)\n");
+    printf("  --rows LIST           Process rows and ranges, e.g. 12,40-49,1000-:10\n");
+    printf("  --where FIELD=VALUE   Process rows where FIELD is VALUE (or FIELD!=VALUE);\n");
+    printf("                        repeat for more conditions, all must hold\n");
+    printf("  -t, --threads N       Lay out labels on N threads (default: 1)\n");
+    printf("  -s, --stream          Render rows as they are read and write each page\n");
+    printf("                        to the output as soon as it is done\n");
+    printf("  --columnar            Keep CSV values per column, storing repeated values\n");
+    printf("                        once, and release the file after loading\n");
+    printf("  --shard-size N        Split the output into files of N labels each\n");
+    printf("  --shards N            Split the output into N files of equal size\n");
+    printf("  --compression MODE    none, fast, default, best or a level 0-9, with an\n");
+    printf("                        optional ,filtered ,huffman or ,rle strategy\n");
+    printf("                        (default: default)\n");
+    printf("  --delimiter C         Value separator: a character such as ; or |, or tab\n");
+    printf("                        (default: ,)\n");
+    printf("  --quote C             Quote character, none to read quotes as text\n");
+    printf("                        (default: \")\n");
+    printf("  --escape C            Escape character inside quotes, e.g. \\ (default:\n");
+    printf("                        a doubled quote)\n");
+    printf("  --serve PORT          Keep the config loaded and render the CSV posted to\n");
+    printf("                        http://127.0.0.1:PORT/labels, answering with the PDF\n");
+    printf("  -q, --quiet           Only print errors\n");
+    printf("  --verbose             Also print a line for every label\n");
+    printf("  --log-level LEVEL     silent, error, warning, info or verbose (default: info)\n");
+    printf("  --progress            Always report progress on stderr (default: only\n");
+    printf("                        when stderr is a terminal)\n");
+    printf("  --no-progress         Never report progress on stderr\n");
+    printf("  --progress-fd N       Write progress as JSON lines to file descriptor N\n");
+    printf("  --stats               Print time spent per stage and counters at the end\n");
+    printf("  --stats-rows FILE     Also write one JSON line per label to FILE\n");
     printf("  --validate            Validate configuration without generating PDF\n");
     printf("  -v, --version         Show version information\n");
     printf("  -h, --help            Show this help message\n");
@@ -1039,6 +798,13 @@ void print_help(const char *program_name) {
     printf("  %s data.csv -c config1.json     # Custom config\n", program_name);
     printf("  %s data.csv -o output.pdf -r 5  # Specific output and row\n", program_name);
     printf("  %s data.csv --validate          # Validate config only\n", program_name);
+    printf("  %s data.csv -t 8                # Render on 8 threads\n", program_name);
+    printf("  %s data.csv -s -t 8             # Stream a large batch to disk\n", program_name);
+    printf("  export_orders | %s - -s         # Render rows piped on stdin\n", program_name);
+    printf("  %s data.csv --shard-size 5000   # labels_0001.pdf, labels_0002.pdf, ...\n", program_name);
+    printf("  %s data.csv --compression fast  # Quicker saves, larger files\n", program_name);
+    printf("  %s --serve 8080 -c config.json  # Label server for one-off labels\n", program_name);
+    printf("  %s data.csv --stats -t 8        # Where the time goes\n", program_name);
 }
 
 /* ---------- Configuration Validation ---------- */
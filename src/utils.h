@@ -16,13 +16,29 @@
 #define HEX_LENGTH          10
 #define MAX_TEXT_LEN        1024
 #define MAX_FIELD_LEN       1024
-#define MAX_CSV_LINE_LEN    8192
 #define MAX_CSV_FIELDS      256
-#define MAX_CSV_ROWS        100000
+#define MAX_CSV_ROWS        100000  // rows of a load without --columnar
+#define CSV_DICT_MAX_VALUES 65535   // distinct values of a dictionary column
+#define CSV_DICT_SAMPLE_ROWS 1024   // rows before a column may give up its dictionary
+#define CSV_RELEASE_BYTES   (16 * 1024 * 1024)  // columnar loads give back the file in steps of this
+#define MAX_ROW_RANGES      256
+#define MAX_ROW_CONDITIONS  16
 #define MAX_CONFIG_SIZE     (10 * 1024 * 1024)
 #define MAX_FIELD_COUNT     1000
 #define MAX_LINE_COUNT      1000
 #define MAX_CUSTOM_FONTS    100
+#define MAX_RENDER_THREADS  256
+#define RENDER_QUEUE_PER_THREAD 8
+#define MAX_SHARDS          10000
+#define MAX_OUTPUT_PATH     1024
+#define IMAGE_CACHE_SIZE    256
+#define PDF_MEM_POOL_SIZE   (256 * 1024)
+#define MAX_REQUEST_HEADER  (16 * 1024)
+#define MAX_REQUEST_BODY    (16 * 1024 * 1024)
+#define SERVER_TIMEOUT_MS   10000
+#define LOG_BUFFER_SIZE     (64 * 1024)
+#define PROGRESS_INTERVAL_MS 250
+#define PROGRESS_LOG_INTERVAL_MS 5000  // progress lines when stderr is not a terminal
 
 /* ---------- Types ---------- */
 typedef struct {
@@ -76,19 +92,318 @@ typedef struct {
     int enabled;  // Add this to make QR codes optional
 } QRCodeEntry;
 
+/* ---------- Compiled Template Types ---------- */
+// Where the text of a template element comes from once a row is bound
+typedef enum { TEXT_STATIC, TEXT_COLUMN, TEXT_HEX } TextSource;
+
+typedef struct {
+    TextSource source;
+    int column;                 // CSV column index for TEXT_COLUMN
+    char text[MAX_TEXT_LEN];    // literal template text, e.g. "$toname"
+    size_t text_len;
+} TemplateText;
+
+typedef struct {
+    float x_start, x_end, y_start, y_end;
+    float font_size;
+    char font_name[64];         // resolved font name (default font if unset)
+    int font;                   // index of font_name in LabelTemplate.font_names
+    int wrap;
+    int align;
+    int max_length;
+    TemplateText text;
+} TemplateField;
+
+typedef struct {
+    float x, y, width, height;
+    BarcodeType type;
+    char type_name[16];
+    int image;                  // draw as a one row image mask, otherwise as paths
+    TemplateText text;
+} TemplateBarcode;
+
+typedef struct {
+    float x, y, size;
+    int enabled;
+    int image;                  // draw as a 1-bit image mask, otherwise as paths
+    TemplateText text;
+} TemplateQR;
+
+// Immutable render plan compiled once from the JSON config
+typedef struct {
+    PageConfig page;
+    LineEntry *lines;
+    int line_count;
+    TemplateField *fields;
+    int field_count;
+    TemplateBarcode *barcodes;
+    int barcode_count;
+    TemplateQR qr;
+    char (*font_names)[64];     // distinct field fonts, resolved once per document
+    int font_count;
+    char default_font[64];
+    int uses_hex;               // any element needs a per-label hex code
+} LabelTemplate;
+
+/* ---------- Render Types ---------- */
+// One line of text positioned by the layout stage
+typedef struct {
+    float x, y;
+    size_t text;                // offset of the string in LabelLayout.strings
+} TextRun;
+
+typedef struct {
+    HPDF_Font font;
+    float font_size;
+    int first_run;
+    int run_count;
+    int field;                  // template field index
+    int truncated;              // bound value was cut to max_length
+} TextBlock;
+
+typedef struct {
+    int barcode;                // template barcode index
+    int valid;
+    size_t text;                // offset of the bound data in LabelLayout.strings
+} BarcodeRun;
+
+// Measurements of one label for --stats
+typedef struct {
+    uint64_t layout_ns;         // only with --stats
+    uint32_t glyphs;            // characters measured by the layout
+} LayoutStats;
+
+// Everything needed to draw one label, computed without touching the document
+typedef struct {
+    int row_index;
+    char hex_code[HEX_LENGTH + 1];
+    int has_qr;
+    uint8_t qr[qrcodegen_BUFFER_LEN_MAX];
+    BarcodeRun *barcodes;
+    int barcode_count;
+    TextBlock *blocks;
+    int block_count;
+    int block_capacity;
+    TextRun *runs;
+    int run_count;
+    int run_capacity;
+    char *strings;
+    size_t strings_len;
+    size_t strings_cap;
+    LayoutStats stats;
+} LabelLayout;
+
+// Last QR symbol a render loop or worker encoded from an interned value
+// (see CSVRow.interned), reused while the following rows repeat it
+typedef struct {
+    const char *key;
+    int encoded;
+    uint8_t qr[qrcodegen_BUFFER_LEN_MAX];
+} QRSymbolCache;
+
+// Advance widths of the 256 codes of a single byte font in glyph space units
+// (1/1000 of the font size), read once from Libharu
+typedef struct {
+    HPDF_Font font;
+    uint16_t advance[256];
+} FontMetrics;
+
+// An image already in the document, reused by drawings with the same key
+typedef struct {
+    uint8_t *key;
+    size_t key_len;
+    HPDF_Image image;
+} ImageCacheEntry;
+
+// Stream compression of the output, from --compression
+#define COMPRESSION_NONE    -2  // no Flate filter, streams are stored as is
+
+typedef struct {
+    int level;                  // COMPRESSION_NONE, HPDF_COMP_LEVEL_DEFAULT or 0-9
+    int strategy;               // HPDF_COMP_STRATEGY_*
+} CompressionConfig;
+
+typedef struct PageCompressor PageCompressor;
+
+// Per-document state shared read-only by the layout workers
+typedef struct {
+    HPDF_Doc pdf;
+    const LabelTemplate *tpl;
+    FontMetrics *fonts;         // every distinct font used by the fields
+    int font_count;
+    const FontMetrics **field_fonts; // resolved font per template field, NULL to skip
+    int streaming;              // flush every page to the output once emitted
+    int use_background;         // lines and static fields go to a shared background
+    LabelLayout background_layout; // static fields, laid out once
+    HPDF_XObject background;    // Form XObject drawn on every page, built on the first one
+    ImageCacheEntry *qr_images; // IMAGE_CACHE_SIZE recent QR codes, by hash
+    ImageCacheEntry *barcode_images; // recent barcode module patterns
+    CompressionConfig compression;
+    PageCompressor *compressor; // deflates finished pages on worker threads
+    uint64_t hex_state;         // HEX_CODE generator, see generate_hex_code
+} RenderContext;
+
+// One output file of a sharded run, covering rows [start_row, end_row]
+typedef struct {
+    int number;                 // 1-based, used in the file name
+    int start_row;
+    int end_row;
+    char filename[MAX_OUTPUT_PATH];
+    int generated;              // labels written, -1 if the shard failed
+} ShardJob;
+
+/* ---------- Instrumentation Types ---------- */
+// Timed stages of --stats; the ones after layout and emit are parts of them
+typedef enum {
+    STAT_CONFIG,
+    STAT_CSV,
+    STAT_DOCUMENT,
+    STAT_TEMPLATE,
+    STAT_LAYOUT,
+    STAT_LAYOUT_TEXT,
+    STAT_LAYOUT_QR,
+    STAT_EMIT,
+    STAT_EMIT_TEXT,
+    STAT_EMIT_QR,
+    STAT_EMIT_BARCODES,
+    STAT_DEFLATE,
+    STAT_SAVE,
+    STAT_STAGE_COUNT
+} StatStage;
+
+typedef enum {
+    STAT_ROWS,
+    STAT_LABELS,
+    STAT_BYTES_READ,
+    STAT_GLYPHS,
+    STAT_OPERATORS,
+    STAT_CONTENT_BYTES,
+    STAT_PDF_ALLOCS,
+    STAT_PDF_ALLOC_BYTES,
+    STAT_DEFLATE_IN,
+    STAT_DEFLATE_OUT,
+    STAT_COUNTER_COUNT
+} StatCounter;
+
+extern int stats_enabled;
+
+// Timers and counters that cost a single branch without --stats
+#define STATS_START(t)          uint64_t t = stats_enabled ? stats_clock() : 0
+#define STATS_STOP(stage, t)    do { if (stats_enabled) stats_add_time((stage), (t)); } while (0)
+#define STATS_ADD(counter, n)   do { if (stats_enabled) stats_add((counter), (uint64_t)(n)); } while (0)
+
+/* ---------- Logging Types ---------- */
+// Messages up to --log-level are shown: errors and warnings on stderr,
+// the rest on stdout through one buffer
+typedef enum {
+    LOG_SILENT,
+    LOG_ERROR,
+    LOG_WARNING,
+    LOG_INFO,
+    LOG_VERBOSE                 // one line per label
+} LogLevel;
+
+#define PROGRESS_AUTO       -1  // progress bar when stderr is a terminal
+
+extern LogLevel log_level;
+extern int progress_bar;
+
 /* ---------- CSV Types ---------- */
 typedef struct {
-    char **fields;
+    char **fields;              // NUL-terminated values inside CSVData.data
+    int *lengths;               // byte length of every value
     int count;
+    int source_row;             // data row of the file, counted from 0
+    int interned;               // columnar: values never move, equal pointers are equal values
 } CSVRow;
 
+typedef struct CSVStream CSVStream;
+
+// Rows picked with -r, --rows and --where. They are applied while the CSV
+// is read: rows outside the ranges are skipped without being tokenized and
+// reading stops after the last row a range can pick.
+typedef struct {
+    int start;                  // data row, counted from 0 in the file
+    int end;                    // INT_MAX for an open range
+    int step;
+} CSVRowRange;
+
+typedef struct {
+    const char *field;          // not terminated, field_length bytes
+    int field_length;
+    const char *value;
+    int value_length;
+    int negate;                 // field!=value
+    int column;                 // the field's column, once the header is read
+} CSVRowCondition;
+
+typedef struct {
+    CSVRowRange ranges[MAX_ROW_RANGES];     // none: every row
+    int range_count;
+    CSVRowCondition conditions[MAX_ROW_CONDITIONS];  // all of them must hold
+    int condition_count;
+    int last_row;               // no row after this one can be picked
+} CSVSelection;
+
+// A column of the columnar layout (--columnar). Plain columns keep every
+// value back to back; dictionary columns keep each distinct value once and
+// a code per row, so rows with the same value get the same pointer.
+typedef struct {
+    char *bytes;                // NUL-terminated values
+    size_t bytes_len;
+    size_t bytes_cap;
+    uint32_t *offsets;          // start of value i in bytes, plus one entry for the end
+    int offset_count;
+    int offset_cap;
+    uint16_t *codes;            // dictionary columns: the value of every row, else NULL
+    int code_cap;
+    uint32_t *slots;            // hash table of the distinct values while loading
+    uint32_t slot_count;
+} CSVColumn;
+
+// How the input separates its values, from --delimiter, --quote and --escape
+typedef struct {
+    char delimiter;             // ',' by default
+    char quote;                 // '"' by default, '\0' when values are never quoted
+    char escape;                // makes the next character literal inside quotes;
+                                // the quote itself (doubled quotes) by default
+} CSVDialect;
+
 typedef struct {
     CSVRow *rows;
     char **field_names;
     int field_count;
     int row_count;
+    // Storage: the file contents tokenized in place, and the value tables
+    // of all rows (field_count entries per row)
+    char *data;
+    size_t data_size;
+    int mapped;
+    char **values;
+    int *lengths;
+    CSVStream *stream;          // set when rows are read one at a time
+    CSVDialect dialect;
+    // Columnar layout: values are kept per column and read with
+    // get_csv_row; rows, values, lengths and data are not used
+    CSVColumn *columns;
+    char *field_name_data;      // the header names, once data is released
+    // Rows picked while reading, see CSVSelection
+    int selecting;
+    CSVSelection selection;
+    int scanned_rows;           // data rows of the file read so far
+    int *source_rows;           // columnar rows picked by a selection: their data row
 } CSVData;
 
+// Caller-owned copy of a row
+typedef struct {
+    CSVRow row;
+    char *data;
+    size_t data_capacity;
+    char **values;
+    int *lengths;
+    int value_capacity;
+} CSVRowBuffer;
+
 /* ---------- Function Declarations ---------- */
 // Safe string functions
 size_t safe_strncpy(char *dest, const char *src, size_t dest_size);
@@ -96,34 +411,115 @@ int safe_atoi(const char *str, int default_val);
 
 // Helpers
 void error_handler(HPDF_STATUS error_no, HPDF_STATUS detail_no, void *user_data);
-void generate_hex_code(char *hex, int length);
+uint64_t hex_code_seed(uint64_t value);
+void generate_hex_code(uint64_t *state, char *hex, int length);
 
 // CSV functions
-CSVData* parse_csv(const char *filename);
+CSVData* parse_csv(const char *filename, const CSVDialect *dialect, int columnar,
+                   const CSVSelection *selection);
+CSVData* parse_csv_buffer(char *data, size_t size, const CSVDialect *dialect);
 void free_csv_data(CSVData *csv);
+CSVData* open_csv_stream(const char *filename, const CSVDialect *dialect,
+                         const CSVSelection *selection);
+int read_csv_row(CSVData *csv, const CSVRow **row);
+const CSVRow* get_csv_row(const CSVData *csv, int index, CSVRowBuffer *buffer);
+int csv_source_row(const CSVData *csv, int index);
+int copy_csv_row(CSVRowBuffer *dst, const CSVRow *src);
+void free_csv_row_buffer(CSVRowBuffer *buffer);
 
-
-int load_barcodes_from_json(cJSON *root, BarcodeEntry **out_barcodes, int *out_count, 
-                           const char *hex_code, CSVData *csv, int csv_row_index);
 void draw_barcode_entry(HPDF_Page page, BarcodeEntry *barcode);
 
 // Drawing functions
 void draw_qr_code(HPDF_Page page, float x, float y, float size, const char *text);
+void draw_qr_modules(HPDF_Page page, float x, float y, float size, const uint8_t *qrcode);
+HPDF_Image create_qr_image(HPDF_Doc pdf, const uint8_t *qrcode);
 void draw_text_in_box(HPDF_Page page, HPDF_Font font,
                     float x_start, float x_end, float y_start, float y_end,
                     const char *text, float font_size, int align);
+float text_width(HPDF_Font font, float font_size, const char *text);
+void font_metrics_init(FontMetrics *metrics, HPDF_Font font);
+uint32_t metrics_text_units(const FontMetrics *metrics, const char *text, size_t len);
+float metrics_text_width(const FontMetrics *metrics, float font_size, const char *text, size_t len);
+float layout_text_in_box(LabelLayout *layout, const FontMetrics *metrics,
+                         float x_start, float x_end, float y_start, float y_end,
+                         const char *text, float font_size, int align);
 
 // JSON loading functions
 int parse_align(const char *s);
+int parse_compression(const char *s, CompressionConfig *config);
+int parse_csv_char(const char *s, char *out);
+int parse_row_ranges(const char *s, CSVSelection *selection);
+int parse_row_condition(const char *s, CSVSelection *selection);
 HPDF_PageSizes parse_page_size(const char *s);
 HPDF_PageDirection parse_orientation(const char *s);
 int load_page_config_from_json(cJSON *root, PageConfig *config);
 int load_fonts_from_json(cJSON *root, FontConfig *font_config, HPDF_Doc pdf);
-int load_fields_from_json(cJSON *root, Field **out_fields, int *out_count, 
-                         const char *hex_code, CSVData *csv, int csv_row_index);
 int load_lines_from_json(cJSON *root, LineEntry **out_lines, int *out_count);
-int load_qr_from_json(cJSON *root, QRCodeEntry *qr_entry, const char *hex_code, CSVData *csv, int csv_row_index);
 int validate_json_config(cJSON *root);
+cJSON* load_json_config(const char *config_filename);
+
+// Template compilation and rendering
+int compile_template(cJSON *root, const CSVData *csv, const FontConfig *font_config, LabelTemplate *tpl);
+void free_template(LabelTemplate *tpl);
+const char* bind_template_text(const TemplateText *t, const CSVRow *row, const char *hex_code,
+                               int max_length, char *dest, size_t dest_size, int *truncated,
+                               size_t *out_len);
+
+// Layout and page emission
+int render_context_init(RenderContext *ctx, HPDF_Doc pdf, const LabelTemplate *tpl);
+void render_context_free(RenderContext *ctx);
+void layout_reset(LabelLayout *layout);
+void layout_free(LabelLayout *layout);
+size_t layout_add_string(LabelLayout *layout, const char *text, size_t len);
+int layout_add_run(LabelLayout *layout, float x, float y, size_t text);
+int layout_label(const RenderContext *ctx, const CSVRow *row, int row_index,
+                 const char *hex_code, QRSymbolCache *qr_cache, LabelLayout *layout);
+void emit_label(RenderContext *ctx, HPDF_Page page, const LabelLayout *layout);
+void render_label(RenderContext *ctx, HPDF_Page page, const CSVRow *row,
+                  int row_index, const char *hex_code);
+int render_rows(RenderContext *ctx, const CSVData *csv, int start_row, int end_row, int threads);
+int render_csv_stream(RenderContext *ctx, CSVData *csv, int threads, int *read_failed);
+int start_page_compression(RenderContext *ctx, int threads);
+int finish_page_compression(RenderContext *ctx);
+
+// Documents and sharded output
+HPDF_Doc create_label_doc(cJSON *root, FontConfig *font_config, const CompressionConfig *compression);
+void free_font_config(FontConfig *font_config);
+int default_thread_count(void);
+int plan_shards(const char *output_filename, int start_row, int end_row,
+                int shard_size, int shard_count, ShardJob **out_jobs);
+int render_shards(cJSON *root, const LabelTemplate *tpl, const CSVData *csv,
+                  ShardJob *jobs, int job_count, int threads, int streaming,
+                  const CompressionConfig *compression, uint64_t hex_seed);
+int write_shard_manifest(const char *output_filename, const CSVData *csv,
+                         const ShardJob *jobs, int job_count);
+
+// Instrumentation
+int stats_start(const char *rows_filename);
+uint64_t stats_clock(void);
+uint64_t stats_add_time(StatStage stage, uint64_t start);
+void stats_add(StatCounter counter, uint64_t value);
+void stats_label(const LabelLayout *layout, uint64_t emit_ns, HPDF_UINT operators,
+                 HPDF_UINT content_bytes);
+void stats_doc_saved(HPDF_Doc pdf);
+void* stats_pdf_alloc(HPDF_UINT size);
+void stats_pdf_free(void *ptr);
+void stats_print_summary(void);
+void stats_finish(void);
+
+// Logging and progress
+int parse_log_level(const char *s);
+void log_message(LogLevel level, const char *fmt, ...);
+void log_flush(void);
+void log_truncated_field(const char *field, int row_index);
+int progress_open_fd(int fd);
+void progress_start(int total);
+void progress_add(int labels);
+void log_finish(void);
+
+// Label server
+int run_label_server(const char *config_filename, int port, const CompressionConfig *compression,
+                     const CSVDialect *dialect);
 
 // Command line and validation
 void print_version();
@@ -0,0 +1,265 @@
+/* FDCLabel_csv_test.c Fast Dynamic C Label Generator
+ *
+ * Copyright (C) Ivan Rolero
+ *
+ * This file is part of FDCLabel.
+ *
+ * FDCLabel is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FDCLabel is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Tokenizer checks: known inputs against their expected records, then
+// random inputs read by the three readers (rows, --columnar and the
+// stream of -s and stdin), which must agree byte for byte. Fields are
+// long enough to cross the 16 and 32 byte chunks of the vector scans.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "utils.h"
+
+#define TEST_FILE           "FDCLabel_csv_test.tmp"
+#define RANDOM_INPUTS       2000
+#define MAX_RANDOM_LENGTH   400
+
+typedef struct {
+    char *data;
+    size_t len;
+    size_t cap;
+} TestBuffer;
+
+typedef struct {
+    const char *name;
+    const char *input;
+    int columns;                // 0: the input has no header
+    const char *cells[16];      // header then rows, columns per record
+} TestCase;
+
+static const CSVDialect default_dialect = { ',', '"', '"' };
+
+enum { READ_ROWS, READ_COLUMNAR, READ_STREAM };
+static const char *reader_names[] = { "rows", "columnar", "stream" };
+
+static const TestCase cases[] = {
+    { "BOM before a quoted header with a line break",
+      "\xEF\xBB\xBF\"to\nname\",b\n1,2\n", 2, { "to\nname", "b", "1", "2" } },
+    { "BOM before a blank line",
+      "\xEF\xBB\xBF\na,b\n1,2\n", 2, { "a", "b", "1", "2" } },
+    { "BOM only", "\xEF\xBB\xBF", 0, { NULL } },
+    { "unterminated quote at a final newline",
+      "a,b\n1,\"x\n", 2, { "a", "b", "1", "x" } },
+    { "unterminated quote without a newline",
+      "a,b\n1,\"x", 2, { "a", "b", "1", "x" } },
+    { "no final newline", "a,b\n1,2", 2, { "a", "b", "1", "2" } },
+    { "CRLF line ends", "a,b\r\n1, 2 \r\n", 2, { "a", "b", "1", "2" } },
+    { "doubled quotes and delimiters inside quotes",
+      "a\n\"x,\"\"y\"\"\"\n", 1, { "a", "x,\"y\"" } },
+    { "missing fields", "a,b,c\n1\n", 3, { "a", "b", "c", "1", "", "" } },
+    { "blank lines", "a\n\n1\n \n2\n", 1, { "a", "1", "2" } },
+    { "fields across vector chunks",
+      "a,b\n"
+      "0123456789012345678901234567890123456789,\"0123456789012345,\n6789012345678901234,\"\"56789\"\n",
+      2, { "a", "b", "0123456789012345678901234567890123456789",
+           "0123456789012345,\n6789012345678901234,\"56789" } },
+};
+
+static void append(TestBuffer *b, const void *p, size_t n) {
+    if (b->len + n > b->cap) {
+        b->cap = (b->len + n) * 2 + 64;
+        b->data = realloc(b->data, b->cap);
+        if (!b->data) {
+            fprintf(stderr, "Out of memory\n");
+            exit(1);
+        }
+    }
+    memcpy(b->data + b->len, p, n);
+    b->len += n;
+}
+
+// One value as "<length>:<bytes>", so that records compare with memcmp
+static void append_value(TestBuffer *b, const char *value, int len) {
+    char prefix[16];
+    int n = snprintf(prefix, sizeof(prefix), "%d:", len);
+    append(b, prefix, (size_t)n);
+    append(b, value, (size_t)len);
+}
+
+static void append_row(TestBuffer *b, const CSVRow *row) {
+    for (int i = 0; i < row->count; i++) append_value(b, row->fields[i], row->lengths[i]);
+    append(b, "\n", 1);
+}
+
+static int write_test_file(const char *data, size_t len) {
+    FILE *fp = fopen(TEST_FILE, "wb");
+    if (!fp) return -1;
+    size_t written = fwrite(data, 1, len, fp);
+    if (fclose(fp) != 0 || written != len) return -1;
+    return 0;
+}
+
+// The records of TEST_FILE as one reader sees them: the header, then the
+// rows. Returns -1 when the reader rejects the input.
+static int read_records(int reader, const CSVDialect *d, TestBuffer *out) {
+    out->len = 0;
+    CSVData *csv = reader == READ_STREAM ? open_csv_stream(TEST_FILE, d, NULL)
+                                         : parse_csv(TEST_FILE, d, reader == READ_COLUMNAR, NULL);
+    if (!csv) return -1;
+
+    for (int i = 0; i < csv->field_count; i++) {
+        append_value(out, csv->field_names[i], (int)strlen(csv->field_names[i]));
+    }
+    append(out, "\n", 1);
+
+    if (reader == READ_STREAM) {
+        const CSVRow *row;
+        int rc;
+        while ((rc = read_csv_row(csv, &row)) == 1) append_row(out, row);
+        if (rc < 0) {
+            free_csv_data(csv);
+            return -1;
+        }
+    } else {
+        CSVRowBuffer buffer = {0};
+        for (int r = 0; r < csv->row_count; r++) append_row(out, get_csv_row(csv, r, &buffer));
+        free_csv_row_buffer(&buffer);
+    }
+    free_csv_data(csv);
+    return 0;
+}
+
+static void print_input(const char *data, size_t len) {
+    fprintf(stderr, "  input (%zu bytes): \"", len);
+    for (size_t i = 0; i < len; i++) {
+        unsigned char c = (unsigned char)data[i];
+        if (c == '\n') fprintf(stderr, "\\n");
+        else if (c == '\r') fprintf(stderr, "\\r");
+        else if (c == '"' || c == '\\') fprintf(stderr, "\\%c", c);
+        else if (c < 0x20 || c >= 0x7F) fprintf(stderr, "\\x%02X", c);
+        else fputc(c, stderr);
+    }
+    fprintf(stderr, "\"\n");
+}
+
+static int check_case(const TestCase *tc) {
+    TestBuffer expected = {0};
+    TestBuffer got = {0};
+    int failed = 0;
+
+    int cells = 0;
+    while (tc->columns > 0 && tc->cells[cells]) {
+        append_value(&expected, tc->cells[cells], (int)strlen(tc->cells[cells]));
+        if (++cells % tc->columns == 0) append(&expected, "\n", 1);
+    }
+
+    size_t len = strlen(tc->input);
+    if (write_test_file(tc->input, len) != 0) {
+        fprintf(stderr, "Cannot write %s\n", TEST_FILE);
+        return 1;
+    }
+    for (int reader = READ_ROWS; reader <= READ_STREAM; reader++) {
+        int rc = read_records(reader, &default_dialect, &got);
+        int ok = tc->columns == 0 ? rc < 0
+                                  : rc == 0 && got.len == expected.len &&
+                                    memcmp(got.data, expected.data, got.len) == 0;
+        if (!ok) {
+            fprintf(stderr, "FAIL %s (%s reader)\n", tc->name, reader_names[reader]);
+            print_input(tc->input, len);
+            failed = 1;
+        }
+    }
+    free(expected.data);
+    free(got.data);
+    return failed;
+}
+
+// xorshift32: the same inputs on every platform (rand_r is not on Windows)
+static unsigned int next_random(unsigned int *state) {
+    unsigned int x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *state = x;
+}
+
+// Inputs made mostly of the bytes the tokenizer stops at, with runs of
+// plain text long enough for the vector scans
+static size_t random_input(char *buf, const CSVDialect *d, unsigned int *seed) {
+    const char specials[] = { d->delimiter, d->quote ? d->quote : 'q', d->escape ? d->escape : 'e',
+                              '\n', '\r', ' ', '\t' };
+    size_t len = (size_t)(next_random(seed) % MAX_RANDOM_LENGTH);
+    size_t i = 0;
+    if (len >= 3 && next_random(seed) % 8 == 0) {
+        memcpy(buf, "\xEF\xBB\xBF", 3);
+        i = 3;
+    }
+    while (i < len) {
+        unsigned int pick = next_random(seed) % 10;
+        if (pick < 6) {
+            buf[i++] = specials[next_random(seed) % sizeof(specials)];
+        } else {
+            size_t run = next_random(seed) % 48;
+            for (; run > 0 && i < len; run--) buf[i++] = (char)('a' + next_random(seed) % 26);
+        }
+    }
+    return len;
+}
+
+static int check_random(const CSVDialect *d, const char *name, unsigned int seed) {
+    char input[MAX_RANDOM_LENGTH];
+    TestBuffer first = {0};
+    TestBuffer got = {0};
+    int failed = 0;
+
+    for (int n = 0; n < RANDOM_INPUTS && !failed; n++) {
+        size_t len = random_input(input, d, &seed);
+        if (write_test_file(input, len) != 0) {
+            fprintf(stderr, "Cannot write %s\n", TEST_FILE);
+            failed = 1;
+            break;
+        }
+        int first_rc = read_records(READ_ROWS, d, &first);
+        for (int reader = READ_COLUMNAR; reader <= READ_STREAM; reader++) {
+            int rc = read_records(reader, d, &got);
+            if (rc != first_rc ||
+                (rc == 0 && (got.len != first.len || memcmp(got.data, first.data, got.len) != 0))) {
+                fprintf(stderr, "FAIL %s dialect, input %d: %s reader differs from rows\n",
+                        name, n, reader_names[reader]);
+                print_input(input, len);
+                failed = 1;
+            }
+        }
+    }
+    free(first.data);
+    free(got.data);
+    return failed;
+}
+
+int main(void) {
+    // Rejected inputs are part of the checks, their errors are expected
+    log_level = LOG_SILENT;
+
+    int failures = 0;
+    int count = (int)(sizeof(cases) / sizeof(cases[0]));
+    for (int i = 0; i < count; i++) failures += check_case(&cases[i]);
+
+    const CSVDialect escaped = { ';', '\'', '\\' };
+    const CSVDialect unquoted = { '\t', '\0', '\0' };
+    failures += check_random(&default_dialect, "default", 1);
+    failures += check_random(&escaped, "escaped", 2);
+    failures += check_random(&unquoted, "unquoted", 3);
+    count += 3;
+
+    remove(TEST_FILE);
+    printf("%d of %d CSV checks passed\n", count - failures, count);
+    return failures ? 1 : 0;
+}